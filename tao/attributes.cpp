@@ -86,7 +86,7 @@ void LineColor::Draw(Layout *where)
 //   Remember the color in the layout
 // ----------------------------------------------------------------------------
 {
-    where->lineColor = color;
+    where->ColorState().lineColor = color;
 }
 
 
@@ -95,7 +95,7 @@ void FillColor::Draw(Layout *where)
 //   Remember the color in the layout
 // ----------------------------------------------------------------------------
 {
-    where->fillColor = color;
+    where->ColorState().fillColor = color;
 }
 
 
@@ -115,6 +115,15 @@ void FillTexture::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 {
     (void) where;
+    Apply(glName, glType);
+}
+
+
+void FillTexture::Apply(uint glName, GLenum glType)
+// ----------------------------------------------------------------------------
+//   Bind a texture, also used when replaying compiled layouts
+// ----------------------------------------------------------------------------
+{
     GL.Enable(glType);
     CachedTexture *cached = NULL;
     QSharedPointer<TextureCache> cache = TextureCache::instance();
@@ -239,6 +248,15 @@ void LineWidth::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //   Replay a line width change
 // ----------------------------------------------------------------------------
+{
+    Apply(where, width);
+}
+
+
+void LineWidth::Apply(Layout *where, float width)
+// ----------------------------------------------------------------------------
+//   Set the line width, also used when replaying compiled layouts
+// ----------------------------------------------------------------------------
 {
     where->lineWidth = width;
     if (width > 0.0)
@@ -264,12 +282,27 @@ void LineStipple::Draw(Layout *where)
 }
 
 
+FontChange::FontChange(QFont font)
+// ----------------------------------------------------------------------------
+//   Record a font and compute its fingerprint once
+// ----------------------------------------------------------------------------
+    : Attribute(), font(font), key(LayoutTextState::FontKey(font))
+{}
+
+
 void FontChange::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //   Replay a font change
 // ----------------------------------------------------------------------------
 {
-    where->font = font;
+    // Don't copy the text state shared with the parent for the same font
+    if (where->Font() == font)
+        return;
+
+    LayoutTextState &state = where->TextState();
+    state.font = font;
+    state.keyedFont = font;
+    state.fontKey = key;
 }
 
 
@@ -284,9 +317,9 @@ static inline Justification &layoutJustification(Layout *where,
     default:
         std::cerr << "layoutJustification: Invalid axis " << a << "\n";
 
-    case JustificationChange::AlongX:   return where->alongX;
-    case JustificationChange::AlongY:   return where->alongY;
-    case JustificationChange::AlongZ:   return where->alongZ;
+    case JustificationChange::AlongX:   return where->TextState().alongX;
+    case JustificationChange::AlongY:   return where->TextState().alongY;
+    case JustificationChange::AlongZ:   return where->TextState().alongZ;
     }
 }
 
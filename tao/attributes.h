@@ -112,6 +112,7 @@ struct FillTexture : Attribute
         : Attribute(), glName(glName), glType(glType) {}
     virtual void Draw(Layout *where);
     virtual void Evaluate(Layout *) { GL.Enable(glType); GL.BindTexture(glType, glName); }
+    static void Apply(uint glName, GLenum glType);
     uint   glName;
     GLenum glType;
 };
@@ -241,6 +242,7 @@ struct LineWidth : Attribute
 {
     LineWidth(float w) : Attribute(), width(w) {}
     virtual void Draw(Layout *where);
+    static void Apply(Layout *where, float width);
     float width;
 };
 
@@ -263,9 +265,10 @@ struct FontChange : Attribute
 //   Change a font attribute
 // ----------------------------------------------------------------------------
 {
-    FontChange(QFont font): Attribute(), font(font) {}
+    FontChange(QFont font);
     virtual void Draw(Layout *where);
     QFont font;
+    uint64 key;
     virtual void        Evaluate(Layout *l)     { Draw(l); }
 };
 
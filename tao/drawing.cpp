@@ -21,6 +21,7 @@
 // ****************************************************************************
 
 #include "drawing.h"
+#include "drawing_arena.h"
 #include "shapes3d.h"
 #include "layout.h"
 #include "widget.h"
@@ -58,6 +59,25 @@ Drawing::~Drawing()
 }
 
 
+void *Drawing::operator new(size_t size)
+// ----------------------------------------------------------------------------
+//   Allocate drawings from the drawing arena
+// ----------------------------------------------------------------------------
+{
+    return DrawingArena::Allocate(size);
+}
+
+
+void Drawing::operator delete(void *ptr, size_t size)
+// ----------------------------------------------------------------------------
+//   Return the memory for a drawing to the drawing arena
+// ----------------------------------------------------------------------------
+//   The destructor is virtual, so 'size' is the size of the dynamic type
+{
+    DrawingArena::Free(ptr, size);
+}
+
+
 void Drawing::Draw(Layout *)
 // ----------------------------------------------------------------------------
 //   Draw a shape for rendering purpose
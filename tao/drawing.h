@@ -64,6 +64,10 @@ struct Drawing
     virtual bool        IsAttribute();
     virtual bool        IsRTL() { return false; }
 
+    // Drawings are recycled through the drawing arena
+    static void *       operator new(size_t size);
+    static void         operator delete(void *ptr, size_t size);
+
     static uint count;
 };
 
@@ -0,0 +1,125 @@
+// ****************************************************************************
+//  drawing_arena.cpp                                               Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Slab allocator for the Drawing objects created during evaluation
+//
+//
+//
+//
+//
+//
+//
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "drawing_arena.h"
+#include <new>
+
+
+TAO_BEGIN
+
+DrawingArena::FreeBlock *       DrawingArena::freeList[CLASSES] = { NULL };
+std::vector<char *>             DrawingArena::slabs;
+char *                          DrawingArena::slabCurrent = NULL;
+char *                          DrawingArena::slabEnd = NULL;
+DrawingArena::Stats             DrawingArena::thisFrame;
+DrawingArena::Stats             DrawingArena::lastFrame;
+ulong                           DrawingArena::live = 0;
+ulong                           DrawingArena::liveBytes = 0;
+
+
+void *DrawingArena::Allocate(size_t size)
+// ----------------------------------------------------------------------------
+//   Return a block from the free list for the size class of 'size'
+// ----------------------------------------------------------------------------
+{
+    thisFrame.objects++;
+    thisFrame.bytes += size;
+    live++;
+    liveBytes += size;
+
+    if (size == 0 || size > MAX_SIZE)
+    {
+        thisFrame.large++;
+        return ::operator new(size);
+    }
+
+    uint sizeClass = (size - 1) / GRANULE;
+    if (!freeList[sizeClass])
+        Refill(sizeClass);
+
+    FreeBlock *block = freeList[sizeClass];
+    freeList[sizeClass] = block->next;
+    return (void *) block;
+}
+
+
+void DrawingArena::Free(void *ptr, size_t size)
+// ----------------------------------------------------------------------------
+//   Put a block back on the free list for its size class
+// ----------------------------------------------------------------------------
+{
+    if (!ptr)
+        return;
+
+    thisFrame.freed++;
+    live--;
+    liveBytes -= size;
+
+    if (size == 0 || size > MAX_SIZE)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    uint sizeClass = (size - 1) / GRANULE;
+    FreeBlock *block = (FreeBlock *) ptr;
+    block->next = freeList[sizeClass];
+    freeList[sizeClass] = block;
+}
+
+
+void DrawingArena::Refill(uint sizeClass)
+// ----------------------------------------------------------------------------
+//   Carve a batch of blocks for the given size class out of the current slab
+// ----------------------------------------------------------------------------
+//   Slabs are never returned to the system: their number is bounded by
+//   the peak number of drawings, and they are reused at each refresh.
+{
+    size_t blockSize = (sizeClass + 1) * GRANULE;
+    uint   count     = 32;
+
+    for (uint i = 0; i < count; i++)
+    {
+        if (slabCurrent + blockSize > slabEnd)
+        {
+            // Whatever is left in the current slab is too small: drop it
+            slabCurrent = new char[SLAB_SIZE];
+            slabEnd = slabCurrent + SLAB_SIZE;
+            slabs.push_back(slabCurrent);
+        }
+        FreeBlock *block = (FreeBlock *) slabCurrent;
+        slabCurrent += blockSize;
+        block->next = freeList[sizeClass];
+        freeList[sizeClass] = block;
+    }
+}
+
+
+void DrawingArena::NewFrame()
+// ----------------------------------------------------------------------------
+//   Record the counters for the frame that just ended and restart them
+// ----------------------------------------------------------------------------
+{
+    lastFrame = thisFrame;
+    thisFrame = Stats();
+}
+
+TAO_END
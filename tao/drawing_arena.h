@@ -0,0 +1,78 @@
+#ifndef DRAWING_ARENA_H
+#define DRAWING_ARENA_H
+// ****************************************************************************
+//  drawing_arena.h                                                 Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Slab allocator for the Drawing objects created during evaluation
+//
+//     Layouts are cleared and rebuilt at each refresh, which creates and
+//     deletes large numbers of small Drawing objects. The arena recycles
+//     their memory through per-size free lists carved out of large slabs,
+//     so that a refresh does not go back to the system allocator.
+//
+//
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tao.h"
+#include "base.h"
+#include <vector>
+
+
+TAO_BEGIN
+
+struct DrawingArena
+// ----------------------------------------------------------------------------
+//   Size-class slab allocator used by Drawing::operator new / delete
+// ----------------------------------------------------------------------------
+//   Only used from the GUI thread, where layouts are built and destroyed.
+//   Objects larger than MAX_SIZE go directly to the system allocator.
+{
+    enum { GRANULE = 16, MAX_SIZE = 512, SLAB_SIZE = 32 * 1024,
+           CLASSES = MAX_SIZE / GRANULE };
+
+    struct Stats
+    // ------------------------------------------------------------------------
+    //   Allocation counters, either cumulative or for the last frame
+    // ------------------------------------------------------------------------
+    {
+        Stats(): objects(0), bytes(0), freed(0), large(0) {}
+        ulong   objects;        // Objects allocated
+        ulong   bytes;          // Bytes allocated
+        ulong   freed;          // Objects released
+        ulong   large;          // Objects too large for the slabs
+    };
+
+public:
+    static void *       Allocate(size_t size);
+    static void         Free(void *ptr, size_t size);
+    static void         NewFrame();
+
+    static const Stats &LastFrame()     { return lastFrame; }
+    static ulong        LiveObjects()   { return live; }
+    static ulong        LiveBytes()     { return liveBytes; }
+    static ulong        Reserved()      { return slabs.size() * SLAB_SIZE; }
+
+protected:
+    struct FreeBlock    { FreeBlock *next; };
+    static void         Refill(uint sizeClass);
+
+protected:
+    static FreeBlock *          freeList[CLASSES];
+    static std::vector<char *>  slabs;
+    static char *               slabCurrent;
+    static char *               slabEnd;
+    static Stats                thisFrame, lastFrame;
+    static ulong                live, liveBytes;
+};
+
+TAO_END
+
+#endif // DRAWING_ARENA_H
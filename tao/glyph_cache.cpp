@@ -28,7 +28,16 @@
 #include "tao_utf8.h"
 #include "path3d.h"
 #include "save.h"
+#include "application.h"
 #include <QFontMetricsF>
+#include <QGLShaderProgram>
+#include <QDir>
+#include <QFileInfo>
+#if QT_VERSION >= 0x040800
+#include <QRawFont>
+#endif
+#include <algorithm>
+#include <cstring>
 
 TAO_BEGIN
 
@@ -54,7 +63,8 @@ PerFontGlyphCache::PerFontGlyphCache(const QFont &font)
 // ----------------------------------------------------------------------------
 //   Construct an empty per-font glyph cache
 // ----------------------------------------------------------------------------
-    : font(font), ascent(0), descent(0), leading(0)
+    : font(font), ascent(0), descent(0), leading(0),
+      disk(NULL), mapped(NULL), diskSize(0), diskLimit(0)
 {
     QFontMetricsF fm(font);
     ascent = fm.ascent();
@@ -66,26 +76,12 @@ PerFontGlyphCache::PerFontGlyphCache(const QFont &font)
 
 PerFontGlyphCache::~PerFontGlyphCache()
 // ----------------------------------------------------------------------------
-//   Clear the per-font glyph cache
+//   Clear the per-font glyph cache, saving new glyphs on disk
 // ----------------------------------------------------------------------------
 {
-    for (CodeMap::iterator ci = codes.begin(); ci != codes.end(); ci++)
-    {
-        GlyphEntry &e = (*ci).second;
-        if (e.interior)
-            GL.DeleteLists(e.interior, 1);
-        if (e.outline)
-            GL.DeleteLists(e.outline, 1);
-
-    }
-    for (TextMap::iterator ti = texts.begin(); ti != texts.end(); ti++)
-    {
-        GlyphEntry &e = (*ti).second;
-        if (e.interior)
-            GL.DeleteLists(e.interior, 1);
-        if (e.outline)
-            GL.DeleteLists(e.outline, 1);
-    }
+    ClearLists();
+    Save();
+    delete disk;
 }
 
 
@@ -94,10 +90,18 @@ bool PerFontGlyphCache::Find(uint code, GlyphEntry &entry)
 //   For a given Unicode, find per-font glyph cache entry if it exists
 // ----------------------------------------------------------------------------
 {
-    CodeMap::iterator it = codes.find(code);
-    if (it != codes.end())
+    if (code < LATIN1)
     {
-        entry = (*it).second;
+        if (code < latin1.size() && latin1[code].key)
+        {
+            entry = latin1[code].value;
+            return true;
+        }
+        return false;
+    }
+    if (GlyphEntry *found = codes.Find(code))
+    {
+        entry = *found;
         return true;
     }
     return false;
@@ -124,7 +128,15 @@ void PerFontGlyphCache::Insert(uint code, const GlyphEntry &entry)
 //   Insert glyph entry for a single Unicode glyph
 // ----------------------------------------------------------------------------
 {
-    codes[code] = entry;
+    if (code < LATIN1)
+    {
+        if (latin1.empty())
+            latin1.resize(LATIN1);
+        latin1[code].key = code + 1;
+        latin1[code].value = entry;
+        return;
+    }
+    codes.Insert(code) = entry;
 }
 
 
@@ -137,6 +149,223 @@ void PerFontGlyphCache::Insert(text word, const GlyphEntry &entry)
 }
 
 
+static void clearLists(GlyphCacheEntry &e)
+// ----------------------------------------------------------------------------
+//   Delete the display lists of a glyph
+// ----------------------------------------------------------------------------
+{
+    if (e.interior)
+        GL.DeleteLists(e.interior, 1);
+    if (e.outline)
+        GL.DeleteLists(e.outline, 1);
+    e.interior = 0;
+    e.outline = 0;
+}
+
+
+void PerFontGlyphCache::ClearLists()
+// ----------------------------------------------------------------------------
+//   Delete the display lists of all glyphs, but keep their textures
+// ----------------------------------------------------------------------------
+{
+    typedef CodeMap::Slots::iterator slot_iter;
+    CodeMap::Slots &slots = codes.slots;
+    for (slot_iter li = latin1.begin(); li != latin1.end(); li++)
+        if ((*li).key)
+            clearLists((*li).value);
+    for (slot_iter ci = slots.begin(); ci != slots.end(); ci++)
+        if ((*ci).key)
+            clearLists((*ci).value);
+    for (TextMap::iterator ti = texts.begin(); ti != texts.end(); ti++)
+        clearLists((*ti).second);
+}
+
+
+
+// ============================================================================
+//
+//   Glyphs stored on disk
+//
+// ============================================================================
+//   Each font has a file beginning with a DiskHeader, followed by records
+//   made of a DiskGlyph and the alpha values of the glyph cell, row by row.
+//   New records are only appended, so the file is memory-mapped and only
+//   the record headers are read when it is opened. The coverage of a glyph
+//   is read when the glyph is first drawn.
+
+struct DiskHeader
+// ----------------------------------------------------------------------------
+//   Header identifying a glyph file
+// ----------------------------------------------------------------------------
+{
+    char        magic[8];
+    quint32     version;
+    quint32     reserved;
+};
+static const DiskHeader diskHeader = { { 'T','a','o','G','l','y','p','h' },
+                                       1, 0 };
+
+
+struct DiskGlyph
+// ----------------------------------------------------------------------------
+//   A glyph record, with bounds and texture relative to the cell
+// ----------------------------------------------------------------------------
+{
+    quint32     code;
+    quint16     width, height;  // Size of the cell
+    float       bounds[4];      // Lower x, y, upper x, y
+    float       texture[4];
+    float       advance;
+    float       scaling;
+};
+
+
+void PerFontGlyphCache::Open(QString path, uint64 limit)
+// ----------------------------------------------------------------------------
+//   Open the file where the glyphs of this font are stored
+// ----------------------------------------------------------------------------
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    disk = new QtLockedFile(path);
+    diskLimit = limit;
+    if (!disk->open(QIODevice::ReadWrite | QIODevice::Unbuffered))
+    {
+        IFTRACE(fonts)
+            std::cerr << "Cannot open glyph file " << +path << "\n";
+        delete disk;
+        disk = NULL;
+        return;
+    }
+    disk->lock(QtLockedFile::WriteLock);
+    bool indexed = Index();
+    disk->unlock();
+    if (!indexed)
+        Close();
+}
+
+
+void PerFontGlyphCache::Close()
+// ----------------------------------------------------------------------------
+//   Stop using the glyph file, keeping the glyphs already in the atlas
+// ----------------------------------------------------------------------------
+{
+    IFTRACE(fonts)
+        std::cerr << "Not using glyph file " << +disk->fileName() << "\n";
+    if (mapped)
+        disk->unmap(mapped);
+    mapped = NULL;
+    diskSize = 0;
+    stored.Clear();
+    pending.clear();
+    delete disk;
+    disk = NULL;
+}
+
+
+bool PerFontGlyphCache::Index()
+// ----------------------------------------------------------------------------
+//   Map the file and record where each glyph is stored
+// ----------------------------------------------------------------------------
+//   This is called with the file locked, since other instances of Tao may
+//   be appending to it. Only complete records are used, and diskSize is
+//   the end of the last one. The rest can only be a record cut short by an
+//   instance that stopped while saving. A file that does not begin with
+//   our header is left untouched, and we return false to stop using it.
+{
+    if (mapped)
+        disk->unmap(mapped);
+    mapped = NULL;
+    diskSize = 0;
+    stored.Clear();
+
+    uint64 size = disk->size();
+    if (size < sizeof(DiskHeader))
+    {
+        // New file, or the header itself was cut short
+        if (!disk->resize(0) || !disk->seek(0) ||
+            disk->write((const char *) &diskHeader, sizeof(DiskHeader)) !=
+            qint64(sizeof(DiskHeader)))
+            return false;
+        size = sizeof(DiskHeader);
+    }
+
+    mapped = disk->map(0, size);
+    if (!mapped)
+        return false;
+    if (memcmp(mapped, &diskHeader, sizeof(DiskHeader)))
+    {
+        disk->unmap(mapped);
+        mapped = NULL;
+        return false;
+    }
+
+    uint64 offset = sizeof(DiskHeader);
+    while (offset + sizeof(DiskGlyph) <= size)
+    {
+        DiskGlyph glyph;
+        memcpy(&glyph, mapped + offset, sizeof(DiskGlyph));
+        uint64 next = offset + sizeof(DiskGlyph)
+                    + uint64(glyph.width) * glyph.height;
+        if (next > size)
+            break;
+        stored.Insert(uint64(glyph.code) + 1) = offset + 1;
+        offset = next;
+    }
+    diskSize = offset;
+
+    // Do not keep a record cut short mapped, since it may be truncated
+    if (offset < size)
+    {
+        disk->unmap(mapped);
+        mapped = disk->map(0, offset);
+    }
+    return mapped != NULL;
+}
+
+
+const uchar *PerFontGlyphCache::Record(uint64 offset)
+// ----------------------------------------------------------------------------
+//   Return a glyph record, either in the file or not saved yet
+// ----------------------------------------------------------------------------
+{
+    if (offset < diskSize)
+        return mapped + offset;
+    return (const uchar *) pending.constData() + (offset - diskSize);
+}
+
+
+void PerFontGlyphCache::Save()
+// ----------------------------------------------------------------------------
+//   Append the new glyph records to the file
+// ----------------------------------------------------------------------------
+//   Other instances may have added records since we indexed the file, so
+//   we index it again with the file locked, and append after the last
+//   complete record. The file is only truncated to remove a record cut
+//   short, which no instance has indexed, so that the part mapped by
+//   other instances remains valid. Once the file reaches its size limit,
+//   new glyphs are no longer saved.
+{
+    if (!disk || pending.isEmpty())
+        return;
+
+    disk->lock(QtLockedFile::WriteLock);
+    bool ok = Index();
+    if (ok && diskSize + pending.size() <= diskLimit)
+    {
+        if (uint64(disk->size()) > diskSize)
+            ok = disk->resize(diskSize);
+        ok = ok && disk->seek(diskSize);
+        ok = ok && disk->write(pending) == pending.size();
+        ok = ok && Index();
+    }
+    disk->unlock();
+    pending.clear();
+
+    if (!ok)
+        Close();
+}
+
+
 
 // ============================================================================
 //
@@ -144,17 +373,30 @@ void PerFontGlyphCache::Insert(text word, const GlyphEntry &entry)
 //
 // ============================================================================
 
-uint GlyphCache::defaultSize = 128;
+uint              GlyphCache::defaultSize = 128;
+QGLShaderProgram *GlyphCache::sdfProgram = NULL;
+bool              GlyphCache::sdfFailed = false;
 
 GlyphCache::GlyphCache()
 // ----------------------------------------------------------------------------
-//   Default constructor creates an empty glyph cache with a texture
+//   Default constructor creates an empty glyph cache with one atlas page
 // ----------------------------------------------------------------------------
     : cache(),
-      packer(defaultSize, defaultSize),
-      texture(0),
-      image(defaultSize, defaultSize, QImage::Format_ARGB32),
-      dirty(false),
+      pages(),
+      frame(1),
+      lastKey(0),
+      pageSize(1024),
+      maxPages(4),
+      rasterized(0), lastRasterized(0),
+      evicted(0), lastEvicted(0),
+      loaded(0), lastLoaded(0),
+      unsaved(0),
+      diskCache(false),
+      diskPath(Application::defaultTaoPreferencesFolderPath() + "/glyphs"),
+      diskLimit(16 << 20),
+      sdf(false),
+      sdfSize(48),
+      sdfSpread(8),
       minFontSize(30),
       maxFontSize(120),
       minFontSizeForAntialiasing(9),
@@ -165,21 +407,25 @@ GlyphCache::GlyphCache()
       GLcontext(QGLContext::currentContext()),
       layout(NULL)
 {
-    image.fill(0);
+    pages.push_back(new GlyphPage(defaultSize));
 }
 
 
 GlyphCache::~GlyphCache()
 // ----------------------------------------------------------------------------
-//   Release the texture we were using
+//   Release the textures we were using
 // ----------------------------------------------------------------------------
 {
     // Don't delete texture if context has been changed
     // REVISIT glyph cache should support multiple contexts
-    if (GLcontext == QGLContext::currentContext())
-        if (texture)
-            glDeleteTextures(1, &texture);
     Clear();
+    bool sameContext = GLcontext == QGLContext::currentContext();
+    for (Pages::iterator p = pages.begin(); p != pages.end(); p++)
+    {
+        if (sameContext && (*p)->texture)
+            glDeleteTextures(1, &(*p)->texture);
+        delete *p;
+    }
 }
 
 
@@ -191,9 +437,11 @@ void GlyphCache::Clear()
     for (FontMap::iterator it = cache.begin(); it != cache.end(); it++)
         delete (*it).second;
     cache.clear();
-    packer.Clear();
-    image.fill(0);
+    fontKeys.Clear();
+    for (Pages::iterator p = pages.begin(); p != pages.end(); p++)
+        (*p)->Clear();
     lastFont = NULL;
+    lastKey = 0;
 }
 
 
@@ -201,72 +449,141 @@ void GlyphCache::CheckActiveLayout(Layout *where)
 // ----------------------------------------------------------------------------
 //   Check if changes in the layout require us to clear the cache
 // ----------------------------------------------------------------------------
+//   Only the display lists depend on the texture units, so the glyphs
+//   already rendered in the atlas remain valid.
 {
     // Check if there are new texture units active compared to what we had
     if (GL.ActiveTextureUnits() & ~this->texUnits)
     {
-        Clear();
+        for (FontMap::iterator it = cache.begin(); it != cache.end(); it++)
+            (*it).second->ClearLists();
         this->texUnits |= GL.ActiveTextureUnits();
     }
     layout = where;
 }
 
 
+void GlyphCache::NewFrame()
+// ----------------------------------------------------------------------------
+//   Start a new frame for the usage stamps and record the statistics
+// ----------------------------------------------------------------------------
+{
+    frame++;
+    lastRasterized = rasterized;
+    lastEvicted = evicted;
+    lastLoaded = loaded;
+
+    // Write new glyphs on disk once text stops changing
+    if (unsaved && !rasterized)
+    {
+        for (FontMap::iterator it = cache.begin(); it != cache.end(); it++)
+            (*it).second->Save();
+        unsaved = 0;
+    }
+    rasterized = 0;
+    evicted = 0;
+    loaded = 0;
+}
+
+
 GlyphCache::PerFont *GlyphCache::FindFont(const QFont &font, bool create)
 // ----------------------------------------------------------------------------
 //   Find the per-font information in the cache
 // ----------------------------------------------------------------------------
+{
+    return FindFont(font, LayoutTextState::FontKey(font), create);
+}
+
+
+GlyphCache::PerFont *GlyphCache::FindFont(const QFont &font, uint64 fontKey,
+                                          bool create)
+// ----------------------------------------------------------------------------
+//   Find the per-font information from the fingerprint of the font
+// ----------------------------------------------------------------------------
+//   Fonts that are seen for the first time are compared with the fonts
+//   in the cache, and then remembered by their fingerprint.
 {
     PerFontGlyphCache *perFont = lastFont;
-    if (!perFont || perFont->font != font)
+    if (!perFont || lastKey != fontKey)
     {
-        Key key(font);
-        FontMap::iterator cacheEntry = cache.find(key);
-        if (cacheEntry == cache.end())
+        if (PerFont **known = fontKeys.Find(fontKey))
         {
-            // Create font cache entry if necessary
-            if (!create)
-                return NULL;
-            perFont = new PerFontGlyphCache(font);
-            cache[key] = perFont;
+            perFont = *known;
         }
         else
         {
-            // Get the cache entry we want
-            perFont = (*cacheEntry).second;
+            // Distance fields are rendered once for all sizes
+            QFont reference(font);
+            if (sdf)
+                reference.setPointSizeF(sdfSize);
+
+            Key key(reference);
+            FontMap::iterator cacheEntry = cache.find(key);
+            if (cacheEntry == cache.end())
+            {
+                // Create font cache entry if necessary
+                if (!create)
+                    return NULL;
+                perFont = new PerFontGlyphCache(reference);
+                cache[key] = perFont;
+                if (diskCache && !diskPath.isEmpty())
+                    perFont->Open(DiskName(reference), diskLimit);
+            }
+            else
+            {
+                // Get the cache entry we want
+                perFont = (*cacheEntry).second;
+            }
+            fontKeys.Insert(fontKey) = perFont;
         }
         lastFont = perFont;
+        lastKey = fontKey;
     }
     return perFont;
 }
 
 
-bool GlyphCache::Find(const QFont &font,
+bool GlyphCache::Find(const QFont &font, uint64 fontKey,
                       uint code, GlyphEntry &entry,
                       bool create, bool interior, scale lineWidth)
 // ----------------------------------------------------------------------------
 //   Find or create a unicode entry in the cache
 // ----------------------------------------------------------------------------
 {
-    PerFont *perFont = FindFont(font, create);
+    PerFont *perFont = FindFont(font, fontKey, create);
     if (!perFont)
         return false;
     bool found = perFont->Find(code, entry);
     if (!found && !create)
         return false;
 
-    if (!found)
+    bool resident = found && entry.page != GlyphEntry::NO_PAGE;
+    if (resident && create && entry.used != frame)
+    {
+        // Record that the glyph is drawn in this frame
+        Used(entry);
+        perFont->Insert(code, entry);
+    }
+
+    // Glyphs rendered in a previous run are copied from disk
+    if (!resident && create && LoadGlyph(perFont, code, entry, found))
+        resident = true;
+
+    if (!resident && create)
     {
         // Apply a font with scaling
+        const QFont &source = sdf ? perFont->font : font;
         scale fs = fontScaling;
         uint aam = antiAliasMargin;
-        if (font.pointSizeF() < minFontSizeForAntialiasing)
+        if (source.pointSizeF() < minFontSizeForAntialiasing)
         {
             fs = 1;
             aam = 0;
         }
-        QFont scaled(font);
-        scaled.setPointSizeF(font.pointSizeF() * fs);
+        if (sdf)
+            aam = sdfSpread;
+        QFont scaled(source);
+        scaled.setPointSizeF(source.pointSizeF() * fs);
         if (!aam)
         {
             scaled.setStyleStrategy(QFont::NoAntialias);
@@ -329,20 +646,34 @@ bool GlyphCache::Find(const QFont &font,
         uint width = ceil(bw);
         uint height = ceil(bh);
 
-        // Allocate a rectangle where we will put the texture (may resize us)
+        // Allocate a rectangle where we will put the texture (may evict)
         BinPacker::Rect rect;
-        Allocate(width + 2*aam, height + 2*aam, rect);
+        uint page;
+        Allocate(width + 2*aam, height + 2*aam, rect, page);
 
         // Record glyph information in the entry
         entry.bounds = Box(bx/fs, by/fs, bw/fs, bh/fs);
         entry.texture = Box(rect.x1+aam, rect.y1+aam, width, height);
+        if (sdf)
+        {
+            // Draw the whole distance field, so that outlines fit in it
+            entry.bounds = Box((bx-aam)/fs, (by-aam)/fs,
+                               (bw+2*aam)/fs, (bh+2*aam)/fs);
+            entry.texture = Box(rect.x1, rect.y1, width+2*aam, height+2*aam);
+        }
         entry.advance = fm.width(qc) / fs;
         entry.scalingFactor = fs;
-        entry.interior = 0;
-        entry.outline = 0;
-        entry.outlineWidth = 1.0;
-        entry.outlineDepth = 0.0;
-        entry.outlineRadius = 0.0;
+        entry.cell = rect;
+        entry.page = page;
+        if (!found)
+        {
+            entry.interior = 0;
+            entry.outline = 0;
+            entry.outlineWidth = 1.0;
+            entry.outlineDepth = 0.0;
+            entry.outlineRadius = 0.0;
+        }
+        Used(entry);
 
         // Store the new entry
         perFont->Insert(code, entry);
@@ -351,7 +682,8 @@ bool GlyphCache::Find(const QFont &font,
         qreal x = rect.x1 + aam - bounds.left();
         qreal y = rect.y2 - aam - bounds.bottom();
 
-        QPainter painter(&image);
+        GlyphPage *atlas = pages[page];
+        QPainter painter(&atlas->image);
         painter.setFont(scaled);
         painter.setBrush(Qt::transparent);
         painter.setPen(Qt::black);
@@ -373,9 +705,13 @@ bool GlyphCache::Find(const QFont &font,
 #endif
 
         painter.end();
+        if (sdf)
+            DistanceField(atlas->image, rect);
 
         // We will need to update the texture
-        dirty = true;
+        atlas->Painted(rect);
+        rasterized++;
+        SaveGlyph(perFont, code, entry);
     }
 
     // Line width should remain identical even if we scale the font
@@ -481,32 +817,43 @@ bool GlyphCache::Find(const QFont &font,
 }
 
 
-bool GlyphCache::Find(const QFont &font,
+bool GlyphCache::Find(const QFont &font, uint64 fontKey,
                       text code, GlyphEntry &entry,
                       bool create, bool interior, scale lineWidth)
 // ----------------------------------------------------------------------------
 //   Find or create a word entry in the cache
 // ----------------------------------------------------------------------------
 {
-    PerFont *perFont = FindFont(font, create);
+    PerFont *perFont = FindFont(font, fontKey, create);
     if (!perFont)
         return false;
     bool found = perFont->Find(code, entry);
     if (!found && !create)
         return false;
 
-    if (!found)
+    bool resident = found && entry.page != GlyphEntry::NO_PAGE;
+    if (resident && create && entry.used != frame)
+    {
+        // Record that the glyph is drawn in this frame
+        Used(entry);
+        perFont->Insert(code, entry);
+    }
+
+    if (!resident && create)
     {
         // Apply a font with scaling
+        const QFont &source = sdf ? perFont->font : font;
         scale fs = fontScaling;
         uint aam = antiAliasMargin;
-        if (font.pointSizeF() < minFontSizeForAntialiasing)
+        if (source.pointSizeF() < minFontSizeForAntialiasing)
         {
             fs = 1;
             aam = 0;
         }
-        QFont scaled(font);
-        scaled.setPointSizeF(font.pointSizeF() * fs);
+        if (sdf)
+            aam = sdfSpread;
+        QFont scaled(source);
+        scaled.setPointSizeF(source.pointSizeF() * fs);
         if (!aam)
         {
             scaled.setStyleStrategy(QFont::NoAntialias);
@@ -530,20 +877,34 @@ bool GlyphCache::Find(const QFont &font,
         uint width = ceil(bw);
         uint height = ceil(bh);
 
-        // Allocate a rectangle where we will put the texture (may resize us)
+        // Allocate a rectangle where we will put the texture (may evict)
         BinPacker::Rect rect;
-        Allocate(width + 2*aam, height + 2*aam, rect);
+        uint page;
+        Allocate(width + 2*aam, height + 2*aam, rect, page);
 
         // Record glyph information in the entry
         entry.bounds = Box(bx/fs, by/fs, bw/fs, bh/fs);
         entry.texture = Box(rect.x1+aam, rect.y1+aam, width, height);
+        if (sdf)
+        {
+            // Draw the whole distance field, so that outlines fit in it
+            entry.bounds = Box((bx-aam)/fs, (by-aam)/fs,
+                               (bw+2*aam)/fs, (bh+2*aam)/fs);
+            entry.texture = Box(rect.x1, rect.y1, width+2*aam, height+2*aam);
+        }
         entry.advance = fm.width(qs) / fs;
         entry.scalingFactor = fs;
-        entry.interior = 0;
-        entry.outline = 0;
-        entry.outlineWidth = 1.0;
-        entry.outlineDepth = 0.0;
-        entry.outlineRadius = 0.0;
+        entry.cell = rect;
+        entry.page = page;
+        if (!found)
+        {
+            entry.interior = 0;
+            entry.outline = 0;
+            entry.outlineWidth = 1.0;
+            entry.outlineDepth = 0.0;
+            entry.outlineRadius = 0.0;
+        }
+        Used(entry);
 
         // Store the new entry
         perFont->Insert(code, entry);
@@ -552,15 +913,19 @@ bool GlyphCache::Find(const QFont &font,
         qreal x = rect.x1 + aam - bounds.left();
         qreal y = rect.y2 - aam - bounds.bottom();
 
-        QPainter painter(&image);
+        GlyphPage *atlas = pages[page];
+        QPainter painter(&atlas->image);
         painter.setFont(scaled);
         painter.setBrush(Qt::transparent);
         painter.setPen(Qt::black);
         painter.drawText(QPointF(x+fs, y+fs), qs);
         painter.end();
+        if (sdf)
+            DistanceField(atlas->image, rect);
 
         // We will need to update the texture
-        dirty = true;
+        atlas->Painted(rect);
+        rasterized++;
     }
 
     // Line width should remain identical even if we scale the font
@@ -666,50 +1031,385 @@ bool GlyphCache::Find(const QFont &font,
 }
 
 
-void GlyphCache::Allocate(uint width, uint height, Rect &rect)
+void GlyphCache::Allocate(uint width, uint height, Rect &rect, uint &page)
 // ----------------------------------------------------------------------------
-//   Allocate  a rectangle, resizing it as necessary
+//   Allocate a rectangle in one of the pages, evicting glyphs as necessary
 // ----------------------------------------------------------------------------
 {
-    while (!packer.Allocate(width, height, rect))
+    // Try the existing pages, growing them up to the page size
+    for (page = 0; page < pages.size(); page++)
+        if (pages[page]->Allocate(width, height, rect, pageSize))
+            return;
+
+    // Add a page while within budget, or if all pages are used in this frame
+    if (pages.size() < maxPages || !Evict(width, height, rect, page))
     {
-        uint w = packer.Width();
-        uint h = packer.Height();
-        do { w <<= 1; } while (w < width);
-        do { h <<= 1; } while (h < height);
+        page = pages.size();
+        pages.push_back(new GlyphPage(defaultSize));
+        pages[page]->Allocate(width, height, rect, std::max(width, height));
+    }
+}
 
-        // Resize the image and copy in the texture
-        image = image.copy(0,0,w,h);
-        dirty = true;
 
-        // Resize the rectangle from which we do the texture allocation
-        packer.Resize(w, h);
+bool GlyphCache::Evict(uint width, uint height, Rect &rect, uint &page)
+// ----------------------------------------------------------------------------
+//   Make room in the least recently used page
+// ----------------------------------------------------------------------------
+//   Pages drawn in the current frame are never evicted, since their glyphs
+//   may already be in the vertices being built. We first try to keep the
+//   glyphs drawn the last time the page was used, and only if that does
+//   not leave enough room, we empty the page entirely.
+{
+    page = GlyphEntry::NO_PAGE;
+    ulong oldest = frame;
+    for (uint p = 0; p < pages.size(); p++)
+    {
+        if (pages[p]->used < oldest)
+        {
+            oldest = pages[p]->used;
+            page = p;
+        }
     }
+    if (page == GlyphEntry::NO_PAGE)
+        return false;
+
+    GlyphPage *victim = pages[page];
+    Compact(page, victim->used);
+    if (victim->Allocate(width, height, rect, pageSize))
+        return true;
+    Compact(page, frame);
+    return victim->Allocate(width, height, rect, std::max(width, height));
 }
 
 
-void GlyphCache::GenerateTexture()
+void GlyphCache::Compact(uint page, ulong keep)
 // ----------------------------------------------------------------------------
-//   Copy the current image into our GL texture
+//   Repack the glyphs of a page used since 'keep', evict the others
 // ----------------------------------------------------------------------------
+//   The kept glyphs are copied from the old image, they are not rendered
+//   again. The entries are updated in place in the per-font caches.
 {
-    if (!texture)
-        GL.GenTextures(1, &texture);
+    GlyphPage *atlas = pages[page];
+    QImage old = atlas->image;
+    atlas->Clear();
 
-    QImage invert(image);
-    invert.invertPixels();
-    QImage texImg = QGLWidget::convertToGLFormat(invert).mirrored(false, true);
-    GL.BindTexture(GL_TEXTURE_2D, texture);
-    GL.TexParameter(GL_TEXTURE_2D,
-                     GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    GL.TexParameter(GL_TEXTURE_2D,
-                    GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    GL.TexParameter(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-    GL.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 texImg.width(), texImg.height(), 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, texImg.bits());
+    QPainter painter(&atlas->image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (FontMap::iterator it = cache.begin(); it != cache.end(); it++)
+    {
+        PerFont *perFont = (*it).second;
+        PerFont::CodeMap::Slots &latin1 = perFont->latin1;
+        PerFont::CodeMap::Slots &codes = perFont->codes.slots;
+        PerFont::TextMap &texts = perFont->texts;
+        for (PerFont::CodeMap::Slots::iterator li = latin1.begin();
+             li != latin1.end(); li++)
+            if ((*li).key)
+                Relocate((*li).value, page, keep, old, painter);
+        for (PerFont::CodeMap::Slots::iterator ci = codes.begin();
+             ci != codes.end(); ci++)
+            if ((*ci).key)
+                Relocate((*ci).value, page, keep, old, painter);
+        for (PerFont::TextMap::iterator ti = texts.begin();
+             ti != texts.end(); ti++)
+            Relocate((*ti).second, page, keep, old, painter);
+    }
+    painter.end();
+}
 
-    dirty = false;
+
+void GlyphCache::Relocate(GlyphEntry &entry, uint page, ulong keep,
+                          const QImage &old, QPainter &painter)
+// ----------------------------------------------------------------------------
+//   Move a glyph to a new place in its page, or evict it
+// ----------------------------------------------------------------------------
+{
+    if (entry.page != page)
+        return;
+
+    GlyphPage *atlas = pages[page];
+    Rect &cell = entry.cell;
+    uint w = cell.x2 - cell.x1;
+    uint h = cell.y2 - cell.y1;
+    Rect moved;
+    if (entry.used < keep || !atlas->packer.Allocate(w, h, moved))
+    {
+        entry.page = GlyphEntry::NO_PAGE;
+        evicted++;
+        return;
+    }
+
+    painter.drawImage(QPoint(moved.x1, moved.y1), old,
+                      QRect(cell.x1, cell.y1, w, h));
+    coord dx = coord(moved.x1) - coord(cell.x1);
+    coord dy = coord(moved.y1) - coord(cell.y1);
+    entry.texture.lower.x += dx;
+    entry.texture.upper.x += dx;
+    entry.texture.lower.y += dy;
+    entry.texture.upper.y += dy;
+    cell = moved;
+    if (atlas->used < entry.used)
+        atlas->used = entry.used;
+}
+
+
+void GlyphCache::DistanceField(QImage &image, const Rect &rect)
+// ----------------------------------------------------------------------------
+//   Replace the coverage painted in a cell with a signed distance field
+// ----------------------------------------------------------------------------
+//   The distance to the nearest texel on the other side of the outline is
+//   searched within sdfSpread texels. It is stored in the alpha channel,
+//   where 0.5 is on the outline and higher values are inside the glyph.
+{
+    int x1 = rect.x1, y1 = rect.y1;
+    int w = rect.x2 - rect.x1, h = rect.y2 - rect.y1;
+    int spread = sdfSpread;
+    if (w <= 0 || h <= 0 || spread <= 0)
+        return;
+
+    // Record which texels are inside the glyph
+    std::vector<bool> inside(w * h);
+    for (int y = 0; y < h; y++)
+    {
+        const QRgb *line = (const QRgb *) image.constScanLine(y1 + y) + x1;
+        for (int x = 0; x < w; x++)
+            inside[y * w + x] = qAlpha(line[x]) >= 128;
+    }
+
+    // Find the nearest texel with the opposite state for each texel
+    for (int y = 0; y < h; y++)
+    {
+        QRgb *line = (QRgb *) image.scanLine(y1 + y) + x1;
+        for (int x = 0; x < w; x++)
+        {
+            bool in = inside[y * w + x];
+            int best = spread * spread;
+            for (int dy = -spread; dy <= spread; dy++)
+            {
+                int yy = y + dy;
+                if (yy < 0 || yy >= h || dy * dy >= best)
+                    continue;
+                for (int dx = -spread; dx <= spread; dx++)
+                {
+                    int xx = x + dx;
+                    int d2 = dx * dx + dy * dy;
+                    if (xx >= 0 && xx < w && d2 < best &&
+                        inside[yy * w + xx] != in)
+                        best = d2;
+                }
+            }
+
+            scale d = sqrt(scale(best)) - 0.5;
+            if (!in)
+                d = -d;
+            int alpha = 128 + int(d * 127 / spread);
+            alpha = std::max(0, std::min(255, alpha));
+            line[x] = qRgba(0, 0, 0, alpha);
+        }
+    }
+}
+
+
+scale GlyphCache::DistanceWidth(const QFont &font, scale lineWidth)
+// ----------------------------------------------------------------------------
+//   Convert half a line width into a difference of distance field values
+// ----------------------------------------------------------------------------
+{
+    scale texels = lineWidth * fontScaling * sdfSize / font.pointSizeF();
+    return texels / (4 * sdfSpread);
+}
+
+
+uint GlyphCache::DistanceProgram()
+// ----------------------------------------------------------------------------
+//   Return the shader drawing distance field glyphs, 0 if not available
+// ----------------------------------------------------------------------------
+{
+    if (!sdfProgram && !sdfFailed)
+    {
+        sdfProgram = new QGLShaderProgram();
+        QString path = Application::applicationDirPath();
+        QString vs = path + "/glyph_sdf.vs";
+        QString fs = path + "/glyph_sdf.fs";
+
+        bool ok = false;
+        if (sdfProgram->addShaderFromSourceFile(QGLShader::Vertex, vs))
+        {
+            if (sdfProgram->addShaderFromSourceFile(QGLShader::Fragment, fs))
+                ok = sdfProgram->link();
+            else
+                std::cerr << "Error loading shader code: " << +fs << "\n";
+        }
+        else
+        {
+            std::cerr << "Error loading shader code: " << +vs << "\n";
+        }
+        if (!ok)
+        {
+            std::cerr << +sdfProgram->log();
+            delete sdfProgram;
+            sdfProgram = NULL;
+            sdfFailed = true;
+        }
+    }
+    return sdfProgram ? sdfProgram->programId() : 0;
+}
+
+
+void GlyphCache::ContextChanged()
+// ----------------------------------------------------------------------------
+//   Forget the distance field shader, which belongs to the old GL context
+// ----------------------------------------------------------------------------
+{
+    delete sdfProgram;
+    sdfProgram = NULL;
+    sdfFailed = false;
+}
+
+
+void GlyphCache::Used(GlyphEntry &entry)
+// ----------------------------------------------------------------------------
+//   Stamp a glyph and its page with the current frame
+// ----------------------------------------------------------------------------
+{
+    entry.used = frame;
+    pages[entry.page]->used = frame;
+}
+
+
+QString GlyphCache::DiskName(const QFont &font)
+// ----------------------------------------------------------------------------
+//   Return the name of the file storing the glyphs of a font
+// ----------------------------------------------------------------------------
+//   The name depends on the font attributes and on the rendering settings.
+//   It also depends on the 'head' table of the font, which contains a
+//   checksum of the whole font file, so that glyphs rendered with another
+//   version of the font are not reused.
+{
+    uint64 hash = LayoutTextState::FontKey(font);
+    QByteArray data;
+#if QT_VERSION >= 0x040800
+    data = QRawFont::fromFont(font).fontTable("head");
+#else
+    data = QFontInfo(font).family().toUtf8();
+#endif
+    uint64 fields[] =
+    {
+        (uint64) (qint64) (fontScaling * 64),
+        (uint64) antiAliasMargin,
+        (uint64) (qint64) (minFontSizeForAntialiasing * 64),
+        (uint64) sdf,
+        (uint64) (qint64) (sdfSize * 64),
+        (uint64) sdfSpread
+    };
+    data.append((const char *) fields, sizeof(fields));
+    for (int i = 0; i < data.size(); i++)
+        hash = (hash ^ uchar(data[i])) * 1099511628211ULL;
+
+    return diskPath + QString("/%1.glyphs")
+        .arg(qulonglong(hash), 16, 16, QChar('0'));
+}
+
+
+bool GlyphCache::LoadGlyph(PerFont *perFont, uint code, GlyphEntry &entry,
+                           bool found)
+// ----------------------------------------------------------------------------
+//   Copy a glyph stored on disk in the atlas
+// ----------------------------------------------------------------------------
+{
+    uint64 *offset = perFont->stored.Find(uint64(code) + 1);
+    if (!offset)
+        return false;
+
+    const uchar *record = perFont->Record(*offset - 1);
+    DiskGlyph glyph;
+    memcpy(&glyph, record, sizeof(DiskGlyph));
+    const uchar *alpha = record + sizeof(DiskGlyph);
+
+    // Render again glyphs that we would not have saved, e.g. damaged ones
+    if (glyph.code != code ||
+        glyph.width > pageSize || glyph.height > pageSize)
+        return false;
+
+    // Copy the coverage, which is painted in black in the atlas
+    BinPacker::Rect rect;
+    uint page;
+    Allocate(glyph.width, glyph.height, rect, page);
+    GlyphPage *atlas = pages[page];
+    for (uint y = 0; y < glyph.height; y++)
+    {
+        QRgb *line = (QRgb *) atlas->image.scanLine(rect.y1 + y) + rect.x1;
+        for (uint x = 0; x < glyph.width; x++)
+            line[x] = qRgba(0, 0, 0, *alpha++);
+    }
+
+    // Record glyph information in the entry
+    entry.bounds.lower.x = glyph.bounds[0];
+    entry.bounds.lower.y = glyph.bounds[1];
+    entry.bounds.upper.x = glyph.bounds[2];
+    entry.bounds.upper.y = glyph.bounds[3];
+    entry.texture.lower.x = rect.x1 + glyph.texture[0];
+    entry.texture.lower.y = rect.y1 + glyph.texture[1];
+    entry.texture.upper.x = rect.x1 + glyph.texture[2];
+    entry.texture.upper.y = rect.y1 + glyph.texture[3];
+    entry.advance = glyph.advance;
+    entry.scalingFactor = glyph.scaling;
+    entry.cell = rect;
+    entry.page = page;
+    if (!found)
+    {
+        entry.interior = 0;
+        entry.outline = 0;
+        entry.outlineWidth = 1.0;
+        entry.outlineDepth = 0.0;
+        entry.outlineRadius = 0.0;
+    }
+    Used(entry);
+    perFont->Insert(code, entry);
+
+    atlas->Painted(rect);
+    loaded++;
+    return true;
+}
+
+
+void GlyphCache::SaveGlyph(PerFont *perFont, uint code,
+                           const GlyphEntry &entry)
+// ----------------------------------------------------------------------------
+//   Prepare the record of a glyph just rendered, to be written on disk
+// ----------------------------------------------------------------------------
+{
+    if (!perFont->disk)
+        return;
+
+    const Rect &cell = entry.cell;
+    DiskGlyph glyph;
+    glyph.code = code;
+    glyph.width = cell.x2 - cell.x1;
+    glyph.height = cell.y2 - cell.y1;
+    glyph.bounds[0] = entry.bounds.lower.x;
+    glyph.bounds[1] = entry.bounds.lower.y;
+    glyph.bounds[2] = entry.bounds.upper.x;
+    glyph.bounds[3] = entry.bounds.upper.y;
+    glyph.texture[0] = entry.texture.lower.x - cell.x1;
+    glyph.texture[1] = entry.texture.lower.y - cell.y1;
+    glyph.texture[2] = entry.texture.upper.x - cell.x1;
+    glyph.texture[3] = entry.texture.upper.y - cell.y1;
+    glyph.advance = entry.advance;
+    glyph.scaling = entry.scalingFactor;
+
+    QByteArray &pending = perFont->pending;
+    perFont->stored.Insert(uint64(code) + 1) =
+        perFont->diskSize + pending.size() + 1;
+    pending.append((const char *) &glyph, sizeof(DiskGlyph));
+
+    const QImage &image = pages[entry.page]->image;
+    for (uint y = cell.y1; y < cell.y2; y++)
+    {
+        const QRgb *line = (const QRgb *) image.constScanLine(y);
+        for (uint x = cell.x1; x < cell.x2; x++)
+            pending.append(char(qAlpha(line[x])));
+    }
+    unsaved++;
 }
 
 
@@ -766,4 +1466,158 @@ void GlyphCache::ScaleDown(GlyphEntry &entry, scale fontScale, scale extra)
     }
 }
 
+
+
+// ============================================================================
+//
+//   Glyph atlas pages
+//
+// ============================================================================
+
+GlyphPage::GlyphPage(uint size)
+// ----------------------------------------------------------------------------
+//   Create an empty page, the texture is created on first use
+// ----------------------------------------------------------------------------
+    : packer(size, size),
+      texture(0),
+      image(size, size, QImage::Format_ARGB32),
+      dirty(false),
+      resized(true),
+      used(0)
+{
+    image.fill(0);
+}
+
+
+bool GlyphPage::Allocate(uint width, uint height, Rect &rect, uint maxSize)
+// ----------------------------------------------------------------------------
+//   Allocate a rectangle, growing the page up to maxSize as necessary
+// ----------------------------------------------------------------------------
+{
+    while (!packer.Allocate(width, height, rect))
+    {
+        uint w = packer.Width();
+        uint h = packer.Height();
+        if (w >= maxSize && h >= maxSize)
+            return false;
+        do { w <<= 1; } while (w < width);
+        do { h <<= 1; } while (h < height);
+
+        // Resize the image and copy in the texture
+        image = image.copy(0,0,w,h);
+        dirty = true;
+        resized = true;
+
+        // Resize the rectangle from which we do the texture allocation
+        packer.Resize(w, h);
+    }
+    return true;
+}
+
+
+void GlyphPage::Painted(const Rect &rect)
+// ----------------------------------------------------------------------------
+//   Record that a region of the image changed and must be uploaded
+// ----------------------------------------------------------------------------
+{
+    painted.push_back(rect);
+    dirty = true;
+}
+
+
+void GlyphPage::Clear()
+// ----------------------------------------------------------------------------
+//   Empty the page, keeping its size and texture
+// ----------------------------------------------------------------------------
+{
+    packer.Clear();
+    image.fill(0);
+    painted.clear();
+    resized = true;
+    dirty = true;
+    used = 0;
+}
+
+
+void GlyphPage::GenerateTexture()
+// ----------------------------------------------------------------------------
+//   Copy the current image into our GL texture
+// ----------------------------------------------------------------------------
+//   When only a few glyphs were added, only their regions are converted
+//   and uploaded, and the mipmaps are regenerated once for all of them.
+{
+    // Check if a partial upload is worth it
+    uint area = 0;
+    for (Rects::iterator r = painted.begin(); r != painted.end(); r++)
+        area += ((*r).x2 - (*r).x1) * ((*r).y2 - (*r).y1);
+    if (texture && !resized &&
+        area < uint(image.width() * image.height()) / 2)
+    {
+        GL.BindTexture(GL_TEXTURE_2D, texture);
+        GL.TexParameter(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
+        uint count = painted.size();
+        for (uint i = 0; i < count; i++)
+        {
+            if (i + 1 == count)
+                GL.TexParameter(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+            UploadRegion(painted[i]);
+        }
+        painted.clear();
+        dirty = false;
+        return;
+    }
+
+    if (!texture)
+        GL.GenTextures(1, &texture);
+
+    QImage invert(image);
+    invert.invertPixels();
+    QImage texImg = QGLWidget::convertToGLFormat(invert).mirrored(false, true);
+    GL.BindTexture(GL_TEXTURE_2D, texture);
+    GL.TexParameter(GL_TEXTURE_2D,
+                     GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    GL.TexParameter(GL_TEXTURE_2D,
+                    GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GL.TexParameter(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    GL.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                 texImg.width(), texImg.height(), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, texImg.bits());
+
+    painted.clear();
+    resized = false;
+    dirty = false;
+}
+
+
+void GlyphPage::UploadRegion(const Rect &rect)
+// ----------------------------------------------------------------------------
+//   Convert a region of the image to the texture format and upload it
+// ----------------------------------------------------------------------------
+//   This does the same as the inversion and conversion to GL format of
+//   GenerateTexture, but only for the pixels in the region.
+{
+    uint x1 = rect.x1, y1 = rect.y1;
+    uint x2 = std::min(rect.x2, (uint) image.width());
+    uint y2 = std::min(rect.y2, (uint) image.height());
+    if (x2 <= x1 || y2 <= y1)
+        return;
+
+    pixels.resize(4 * (x2 - x1) * (y2 - y1));
+    uchar *out = &pixels[0];
+    for (uint y = y1; y < y2; y++)
+    {
+        const QRgb *line = (const QRgb *) image.constScanLine(y);
+        for (uint x = x1; x < x2; x++)
+        {
+            QRgb pixel = line[x];
+            *out++ = 255 - qRed(pixel);
+            *out++ = 255 - qGreen(pixel);
+            *out++ = 255 - qBlue(pixel);
+            *out++ = qAlpha(pixel);
+        }
+    }
+    GL.TexSubImage2D(GL_TEXTURE_2D, 0, x1, y1, x2 - x1, y2 - y1,
+                     GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
 TAO_END
@@ -29,11 +29,17 @@
 #include "layout.h"
 #include "coords.h"
 #include "binpack.h"
+#include "qtlockedfile.h"
 
 #include <QFont>
 #include <QImage>
+#include <QPainter>
+#include <QFile>
 #include <QGLContext>
 #include <map>
+#include <vector>
+
+class QGLShaderProgram;
 
 TAO_BEGIN
 
@@ -44,8 +50,13 @@ struct GlyphCacheEntry
 //   An entry in one of the glyph caches
 // ----------------------------------------------------------------------------
 {
+    enum { NO_PAGE = ~0U };
+
     Box             bounds;
     Box             texture;
+    BinPacker::Rect cell;               // Area allocated in the atlas page
+    uint            page;               // Atlas page, NO_PAGE if evicted
+    ulong           used;               // Last frame where glyph was drawn
     coord           advance;
     scale           scalingFactor;
     scale           outlineWidth;
@@ -58,10 +69,85 @@ struct GlyphCacheEntry
 };
 
 
+template <class Value>
+struct GlyphHash
+// ----------------------------------------------------------------------------
+//    Open addressing hash table with 64-bit keys, where 0 marks free slots
+// ----------------------------------------------------------------------------
+{
+    struct Slot
+    {
+        Slot(): key(0), value() {}
+        uint64  key;
+        Value   value;
+    };
+    typedef std::vector<Slot> Slots;
+
+    GlyphHash(): slots(16), count(0) {}
+
+    Value *Find(uint64 key)
+    {
+        uint mask = slots.size() - 1;
+        for (uint i = Hash(key) & mask; slots[i].key; i = (i + 1) & mask)
+            if (slots[i].key == key)
+                return &slots[i].value;
+        return NULL;
+    }
+
+    Value &Insert(uint64 key)
+    {
+        if (Value *found = Find(key))
+            return *found;
+        if (2 * (count + 1) > slots.size())
+            Grow();
+        count++;
+        return Place(slots, key);
+    }
+
+    void Clear()
+    {
+        Slots(16).swap(slots);
+        count = 0;
+    }
+
+    void Grow()
+    {
+        Slots old(2 * slots.size());
+        old.swap(slots);
+        for (typename Slots::iterator s = old.begin(); s != old.end(); s++)
+            if ((*s).key)
+                Place(slots, (*s).key) = (*s).value;
+    }
+
+    static Value &Place(Slots &slots, uint64 key)
+    {
+        uint mask = slots.size() - 1;
+        uint i = Hash(key) & mask;
+        while (slots[i].key)
+            i = (i + 1) & mask;
+        slots[i].key = key;
+        return slots[i].value;
+    }
+
+    static uint Hash(uint64 key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return uint(key);
+    }
+
+    Slots       slots;          // Size is always a power of 2
+    uint        count;
+};
+
+
 struct PerFontGlyphCache
 // ----------------------------------------------------------------------------
 //    Cache storing glyph information for a specific font
 // ----------------------------------------------------------------------------
+//   Latin-1 glyphs are stored in a directly indexed array, other code
+//   points in a hash table.
 {
     PerFontGlyphCache(const QFont &font);
     ~PerFontGlyphCache();
@@ -73,18 +159,70 @@ public:
     bool Find(text word, GlyphEntry &entry);
     void Insert(uint code, const GlyphEntry &entry);
     void Insert(text word, const GlyphEntry &entry);
+    void ClearLists();
+
+    void Open(QString path, uint64 limit);
+    void Close();
+    bool Index();
+    void Save();
+    const uchar *Record(uint64 offset);
 
 protected:
-    typedef std::map<uint, GlyphEntry>  CodeMap;
+    typedef GlyphHash<GlyphEntry>       CodeMap;
     typedef std::map<text, GlyphEntry>  TextMap;
+    typedef GlyphHash<uint64>           DiskIndex;
+    enum { LATIN1 = 256 };
 
 protected:
     friend struct GlyphCache;
     QFont       font;    
+    CodeMap::Slots latin1;
     CodeMap     codes;
     TextMap     texts;
     qreal       ascent, descent, leading;
     qreal       baseSize;
+
+    // Glyphs rendered in previous runs, and new ones to write on disk
+    QtLockedFile *disk;
+    uchar *     mapped;
+    uint64      diskSize;       // Size of the valid part of the file
+    uint64      diskLimit;      // No new records past this size
+    DiskIndex   stored;         // Offset of each record plus one
+    QByteArray  pending;
+};
+
+
+struct GlyphPage
+// ----------------------------------------------------------------------------
+//    One texture of the glyph atlas, with the allocation of its area
+// ----------------------------------------------------------------------------
+{
+    GlyphPage(uint size);
+
+public:
+    typedef     BinPacker::Rect                 Rect;
+    typedef     std::vector<Rect>               Rects;
+
+    uint        Width()        { return packer.Width(); }
+    uint        Height()       { return packer.Height(); }
+    uint        Texture()      { if (dirty) GenerateTexture(); return texture; }
+
+    bool        Allocate(uint width, uint height, Rect &rect, uint maxSize);
+    void        Painted(const Rect &rect);
+    void        Clear();
+
+    void        GenerateTexture();
+    void        UploadRegion(const Rect &rect);
+
+public:
+    BinPacker   packer;
+    uint        texture;
+    QImage      image;
+    bool        dirty;
+    bool        resized;        // Texture must be uploaded entirely
+    Rects       painted;        // Regions changed since the last upload
+    std::vector<uchar> pixels;  // Scratch buffer for partial uploads
+    ulong       used;           // Last frame where a glyph was drawn
 };
 
 
@@ -92,6 +230,12 @@ struct GlyphCache
 // ----------------------------------------------------------------------------
 //   Cache storing glyph information irrespective of font
 // ----------------------------------------------------------------------------
+//   The glyphs are rendered in up to maxPages atlas pages of at most
+//   pageSize texels. When all pages are full, the least recently used
+//   page is compacted, or emptied if that does not leave enough room.
+//   When diskCache is set, single glyphs are also kept in files under
+//   diskPath, so that they are copied rather than rendered again in
+//   later runs.
 {
     GlyphCache();
     ~GlyphCache();
@@ -100,24 +244,43 @@ public:
     typedef     GlyphCacheEntry                 GlyphEntry;
     typedef     PerFontGlyphCache               PerFont;
     typedef     BinPacker::Rect                 Rect;
+    typedef     std::vector<GlyphPage *>        Pages;
 
     void        Clear();
     void        CheckActiveLayout(Layout *where);
     void        RemoveLayout()  { layout = NULL; }
+    void        NewFrame();
 
-    uint        Width()        { return packer.Width(); }
-    uint        Height()       { return packer.Height(); }
-    uint        Texture()      { if (dirty) GenerateTexture(); return texture; }
+    uint        Width(uint p)   { return pages[p]->Width(); }
+    uint        Height(uint p)  { return pages[p]->Height(); }
+    uint        Texture(uint p) { return pages[p]->Texture(); }
+    uint        PageCount()     { return pages.size(); }
 
     PerFont *   FindFont(const QFont &font, bool create = false);
+    PerFont *   FindFont(const QFont &font, uint64 fontKey, bool create);
 
-    bool        Find(const QFont &font, const uint code, GlyphEntry&,
+    bool        Find(const QFont &font, uint64 fontKey,
+                     const uint code, GlyphEntry&,
                      bool create=false, bool interior=false, scale lineWidth=0);
-    bool        Find(const QFont &font, text word, GlyphEntry&,
+    bool        Find(const QFont &font, uint64 fontKey,
+                     text word, GlyphEntry&,
                      bool create=false, bool interior=false, scale lineWidth=0);
-    void        Allocate(uint width, uint height, Rect &rect);
+    void        Allocate(uint width, uint height, Rect &rect, uint &page);
+    bool        Evict(uint width, uint height, Rect &rect, uint &page);
+    void        Compact(uint page, ulong keep);
+    void        Relocate(GlyphEntry &entry, uint page, ulong keep,
+                         const QImage &old, QPainter &painter);
+    void        Used(GlyphEntry &entry);
+    QString     DiskName(const QFont &font);
+    bool        LoadGlyph(PerFont *perFont, uint code, GlyphEntry &entry,
+                          bool found);
+    void        SaveGlyph(PerFont *perFont, uint code,
+                          const GlyphEntry &entry);
+    void        DistanceField(QImage &image, const Rect &rect);
+    scale       DistanceWidth(const QFont &font, scale lineWidth);
+    static uint DistanceProgram();
+    static void ContextChanged();
 
-    void        GenerateTexture();
     qreal       Ascent(const QFont &font);
     qreal       Descent(const QFont &font);
     qreal       Leading(const QFont &font);
@@ -202,14 +365,29 @@ protected:
 
 protected:
     typedef std::map<Key, PerFont *> FontMap;
+    typedef GlyphHash<PerFont *>     FontKeys;
     FontMap     cache;
-    BinPacker   packer;
-    uint        texture;
-    QImage      image;
-    bool        dirty;
+    FontKeys    fontKeys;       // Per-font caches indexed by font fingerprint
+    Pages       pages;
+    ulong       frame;
+    uint64      lastKey;
+    static QGLShaderProgram *sdfProgram;
+    static bool sdfFailed;
 
 public:
     static uint defaultSize;
+    uint        pageSize;
+    uint        maxPages;
+    ulong       rasterized, lastRasterized;
+    ulong       evicted, lastEvicted;
+    ulong       loaded, lastLoaded;
+    ulong       unsaved;        // Glyphs not written on disk yet
+    bool        diskCache;      // Keep rendered glyphs between runs
+    QString     diskPath;
+    uint64      diskLimit;      // Maximum size of the file for one font
+    bool        sdf;            // Glyphs are signed distance fields
+    scale       sdfSize;        // Font size at which distance fields are made
+    uint        sdfSpread;      // Texels covered by the distance gradient
     scale       minFontSize;
     scale       maxFontSize;
     scale       minFontSizeForAntialiasing;
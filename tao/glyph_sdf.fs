@@ -0,0 +1,45 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Taodyne.
+** All rights reserved.
+** Contact: Taodyne (contact@taodyne.com)
+**
+** This file is part of the Tao3D application, developped by Taodyne.
+** It can be only used in the software and these modules.
+**
+** If you have questions regarding the use of this file, please contact
+** Taodyne at contact@taodyne.com.
+**
+****************************************************************************/
+
+// Glyphs drawn from the signed distance fields of the glyph cache
+// The distance is 0.5 on the outline of the glyph, higher inside
+
+uniform sampler2D glyphs;
+uniform float     outlineWidth;     // Half the outline, in distance units
+uniform vec4      outlineColor;
+
+varying vec4 color;
+
+void main(void)
+{
+    float dist = texture2D(glyphs, gl_TexCoord[0].st).a;
+
+    // Antialias over about one pixel, whatever the scale
+    float aa = 0.7 * fwidth(dist);
+
+    if (outlineWidth > 0.0)
+    {
+        float inner = smoothstep(0.5 + outlineWidth - aa,
+                                 0.5 + outlineWidth + aa, dist);
+        float outer = smoothstep(0.5 - outlineWidth - aa,
+                                 0.5 - outlineWidth + aa, dist);
+        vec4 mixed = mix(outlineColor, color, inner);
+        gl_FragColor = vec4(mixed.rgb, mixed.a * outer);
+    }
+    else
+    {
+        float fill = smoothstep(0.5 - aa, 0.5 + aa, dist);
+        gl_FragColor = vec4(color.rgb, color.a * fill);
+    }
+}
@@ -0,0 +1,25 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Taodyne.
+** All rights reserved.
+** Contact: Taodyne (contact@taodyne.com)
+**
+** This file is part of the Tao3D application, developped by Taodyne.
+** It can be only used in the software and these modules.
+**
+** If you have questions regarding the use of this file, please contact
+** Taodyne at contact@taodyne.com.
+**
+****************************************************************************/
+
+// Glyphs drawn from the signed distance fields of the glyph cache
+
+varying vec4 color;
+
+void main(void)
+{
+    gl_Position = ftransform();
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    color = gl_Color;
+    gl_ClipVertex = gl_ModelViewMatrix * gl_Vertex;
+}
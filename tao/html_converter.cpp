@@ -42,7 +42,7 @@ XL::Tree *HTMLConverter::fromHTML(QString html, QString css)
 // ----------------------------------------------------------------------------
 {
     QTextDocument doc;
-    doc.setDefaultFont(layout->font);
+    doc.setDefaultFont(layout->Font());
     if (css != "")
         doc.setDefaultStyleSheet(css);
     doc.setHtml(html);
@@ -403,10 +403,10 @@ bool modifyBlockFormat(QTextBlockFormat &blockFormat,
 {
     bool modified = false;
     if (blockFormat.alignment() !=
-        (where->alongX.toQtHAlign() | where->alongY.toQtVAlign()))
+        (where->AlongX().toQtHAlign() | where->AlongY().toQtVAlign()))
     {
-        blockFormat.setAlignment(where->alongX.toQtHAlign() |
-                                 where->alongY.toQtVAlign());
+        blockFormat.setAlignment(where->AlongX().toQtHAlign() |
+                                 where->AlongY().toQtVAlign());
         modified = true;
     }
 
@@ -446,17 +446,17 @@ bool modifyCharFormat(QTextCharFormat &format,
 // ----------------------------------------------------------------------------
 {
     bool modified = false;
-    if (format.font() != where->font)
+    if (format.font() != where->Font())
     {
-        format.setFont(where->font);
+        format.setFont(where->Font());
         modified = true;
     }
 
     QColor fill;
-    fill.setRgbF(where->fillColor.red,
-                 where->fillColor.green,
-                 where->fillColor.blue,
-                 where->fillColor.alpha);
+    fill.setRgbF(where->FillColor().red,
+                 where->FillColor().green,
+                 where->FillColor().blue,
+                 where->FillColor().alpha);
     if ( format.foreground().color() != fill)
     {
         format.setForeground(fill);//QBrush(fill));
@@ -494,6 +494,18 @@ struct ModuleApi
     double (*currentPageTime)();
     double (*DevicePixelRatio)();
     bool (*RenderingTransparency)();
+
+    // ------------------------------------------------------------------------
+    //   Instanced drawing
+    // ------------------------------------------------------------------------
+
+    // Set the values of the buffer drawn by 'instances' when its values
+    // are the given name. There are 10 floats per instance: x, y, z, w, h, d
+    // for the box and r, g, b, a for the color, so count must be a multiple
+    // of 10. A NULL data pointer removes the buffer.
+    // Return false if count is invalid.
+    bool (*setInstanceValues)(std::string name, const float *data,
+                              unsigned int count);
 };
 
 }
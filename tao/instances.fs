@@ -0,0 +1,22 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Taodyne.
+** All rights reserved.
+** Contact: Taodyne (contact@taodyne.com)
+**
+** This file is part of the Tao3D application, developped by Taodyne.
+** It can be only used in the software and these modules.
+**
+** If you have questions regarding the use of this file, please contact
+** Taodyne at contact@taodyne.com.
+**
+****************************************************************************/
+
+// Instances of a mesh, drawn with their own color
+
+varying vec4 color;
+
+void main(void)
+{
+    gl_FragColor = color;
+}
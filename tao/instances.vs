@@ -0,0 +1,45 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Taodyne.
+** All rights reserved.
+** Contact: Taodyne (contact@taodyne.com)
+**
+** This file is part of the Tao3D application, developped by Taodyne.
+** It can be only used in the software and these modules.
+**
+** If you have questions regarding the use of this file, please contact
+** Taodyne at contact@taodyne.com.
+**
+****************************************************************************/
+
+// Instances of a mesh, each with its own center, size and color
+// The pass tells which instances are drawn: 0 for opaque ones,
+// 1 for transparent ones, 2 for all visible ones, 3 for outlines
+
+attribute vec3  center;
+attribute vec3  size;
+attribute vec4  tint;
+
+uniform vec3    offset;
+uniform float   visibility;
+uniform int     pass;
+uniform vec4    lineColor;
+
+varying vec4 color;
+
+void main(void)
+{
+    vec4 position = vec4(gl_Vertex.xyz * size + center + offset, 1.0);
+    float alpha = visibility * tint.a;
+    bool drawn = pass == 3 ||
+        (alpha > 0.0 && (pass == 2 || (pass == 1) == (alpha < 1.0)));
+
+    color = pass == 3 ? lineColor : vec4(tint.rgb, alpha);
+    gl_ClipVertex = gl_ModelViewMatrix * position;
+
+    // Instances not drawn in this pass are moved outside of the view
+    if (drawn)
+        gl_Position = gl_ModelViewProjectionMatrix * position;
+    else
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+}
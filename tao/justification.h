@@ -70,7 +70,7 @@ struct Justification
     float       perSolid;
     float       perBreak;
 
-    Qt::Alignment toQtHAlign()
+    Qt::Alignment toQtHAlign() const
     {
         if (amount >= 0.5)
             return Qt::AlignJustify;
@@ -81,7 +81,7 @@ struct Justification
         return Qt::AlignRight;
     }
 
-    Qt::Alignment toQtVAlign()
+    Qt::Alignment toQtVAlign() const
     {
         if (centering <= 0.4)
             return Qt::AlignTop;
@@ -22,8 +22,17 @@
 // ****************************************************************************
 
 #include "layout.h"
+#include "space_layout.h"
+#include "group_layout.h"
 #include "gl_keepers.h"
 #include "attributes.h"
+#include "transforms.h"
+#include "lighting.h"
+#include "shapes.h"
+#include "shapes3d.h"
+#include "manipulator.h"
+#include "path3d.h"
+#include "text_drawing.h"
 #include "tao_tree.h"
 #include "tao_utf8.h"
 #include "statistics.h"
@@ -34,11 +43,26 @@
 TAO_BEGIN
 
 int   Layout::polygonOffset   = 0;
+uint  Layout::polygonResets   = 0;
 scale Layout::factorBase      = 0;
 scale Layout::factorIncrement = -0.005; // Experimental value
 scale Layout::unitBase        = 0;
 scale Layout::unitIncrement   = -1;
 bool  Layout::inIdentify      = false;
+bool  Layout::compileDrawings = true;
+uint  Layout::commandsDiscarded = 0;
+uint  Layout::transparencyChecks = 0;
+bool  Layout::transparentContent = false;
+uint  Layout::drawPass = 0;
+uint  Layout::transparentSkipped = 0;
+uint  Layout::lastTransparentSkipped = 0;
+bool  Layout::cullLayouts = true;
+uint  Layout::layoutsCulled = 0;
+uint  Layout::lastLayoutsCulled = 0;
+uint  Layout::layoutsDrawn = 0;
+uint  Layout::lastLayoutsDrawn = 0;
+uint  LayoutSharedState::copies = 0;
+uint  LayoutSharedState::lastCopies = 0;
 
 
 LayoutState::LayoutState()
@@ -46,19 +70,15 @@ LayoutState::LayoutState()
 //   Default state for all layouts
 // ----------------------------------------------------------------------------
     : offset(),
-      font(qApp->font()),
-      alongX(), alongY(), alongZ(),
       left(0), right(0), top(0), bottom(0),
       visibility(1),
       extrudeDepth(0),
       extrudeRadius(0),
       extrudeCount(1),
       lineWidth(1.0),
-      lineColor(0,0,0,0),       // Transparent black
-      fillColor(0,0,0,1),       // Black
-      lightId(GL_LIGHT0),
-      perPixelLighting(TaoApp->useShaderLighting),
-      programId(0),
+      sharedText(new LayoutTextState),
+      sharedColors(new LayoutColorState),
+      sharedTransform(new LayoutTransformState),
       groupDrag(false),
       transparency(false),
       blendOrShade(false)
@@ -69,34 +89,86 @@ LayoutState::LayoutState(const LayoutState &o)
 // ----------------------------------------------------------------------------
 //   Copy state (may be used between layouts)
 // ----------------------------------------------------------------------------
+//   The shared blocks are not copied until the new state modifies them
     : offset(o.offset),
-      font(o.font),
-      alongX(o.alongX), alongY(o.alongY), alongZ(o.alongZ),
       left(o.left), right(o.right), top(o.top), bottom(o.bottom),
       visibility(o.visibility),
       extrudeDepth(o.extrudeDepth),
       extrudeRadius(o.extrudeRadius),
       extrudeCount(o.extrudeCount),
       lineWidth(o.lineWidth),
-      lineColor(o.lineColor),
-      fillColor(o.fillColor),
-      lightId(o.lightId),
-      perPixelLighting(o.perPixelLighting),
-      programId(o.programId),
-      model(o.model),
+      sharedText(o.sharedText),
+      sharedColors(o.sharedColors),
+      sharedTransform(o.sharedTransform),
       groupDrag(false),
       transparency(false),
       blendOrShade(false)
 {}
 
 
+uint64 LayoutTextState::FontKey(const QFont &font)
+// ----------------------------------------------------------------------------
+//   Compute a 64-bit fingerprint of the font attributes used by text
+// ----------------------------------------------------------------------------
+//   This lets the glyph cache find fonts with hash tables, without
+//   comparing family names. The result is never 0.
+{
+    uint64 hash = 14695981039346656037ULL;      // FNV-1a offset basis
+    QString family = font.family();
+    const ushort *name = family.utf16();
+    for (int i = 0; i < family.size(); i++)
+        hash = (hash ^ name[i]) * 1099511628211ULL;
+
+    uint64 fields[] =
+    {
+        (uint64) (qint64) (font.pointSizeF() * 64),
+        (uint64) font.pixelSize(),
+        (uint64) font.weight(),
+        (uint64) font.style(),
+        (uint64) font.stretch(),
+        (uint64) font.capitalization(),
+        (uint64) font.styleStrategy(),
+        (uint64) ((font.underline() << 2) |
+                  (font.overline()  << 1) |
+                  (font.strikeOut()))
+    };
+    for (uint f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+        for (uint b = 0; b < 64; b += 8)
+            hash = (hash ^ ((fields[f] >> b) & 0xFF)) * 1099511628211ULL;
+
+    return hash ? hash : 1;
+}
+
+
+uint64 LayoutState::FontKey() const
+// ----------------------------------------------------------------------------
+//   Return the fingerprint of the current font, computing it if necessary
+// ----------------------------------------------------------------------------
+//   Copies of a QFont share their data, so checking that the font did not
+//   change since the fingerprint was computed is usually a pointer compare.
+{
+    const LayoutTextState *state = sharedText.constData();
+    if (!state->fontKey || state->keyedFont != state->font)
+    {
+        state->fontKey = LayoutTextState::FontKey(state->font);
+        state->keyedFont = state->font;
+    }
+    return state->fontKey;
+}
+
+
 void LayoutState::ClearAttributes()
 // ----------------------------------------------------------------------------
 //   Reset default state for a layout
 // ----------------------------------------------------------------------------
+//   Layouts are cleared very often, so they share the blocks of a single
+//   default state instead of allocating new ones. The default state is
+//   never deleted, since its font must not outlive the application.
 {
-    LayoutState zero;
-    *this = zero;
+    static LayoutState *defaults = new LayoutState;
+    if (defaults->PerPixelLighting() != TaoApp->useShaderLighting)
+        defaults->ColorState().perPixelLighting = TaoApp->useShaderLighting;
+    *this = *defaults;
 }
 
 
@@ -150,6 +222,9 @@ Layout::Layout(Widget *widget)
       LayoutState(widget->layout ? *widget->layout : LayoutState()),
       id(0), charId(0), parent(NULL),
       items(), display(widget), idx(-1),
+      commands(), compiled(false), opaque(false), opaquePass(0),
+      opaqueOffsets(0), opaqueResets(false),
+      cullState(CULL_UNKNOWN), cullBounds(), cullFont(0), cullWidth(-1),
       refreshEvents(), nextRefresh(DBL_MAX)
 {
     IFTRACE(justify)
@@ -165,6 +240,9 @@ Layout::Layout(const Layout &o)
 // ----------------------------------------------------------------------------
     : Drawing(o), LayoutState(o), id(0), charId(0), parent(NULL),
       items(), display(o.display), idx(-1),
+      commands(), compiled(false), opaque(false), opaquePass(0),
+      opaqueOffsets(0), opaqueResets(false),
+      cullState(CULL_UNKNOWN), cullBounds(), cullFont(0), cullWidth(-1),
       refreshEvents(), nextRefresh(DBL_MAX)
 {
     IFTRACE(justify)
@@ -181,6 +259,8 @@ Layout::~Layout()
     IFTRACE(justify)
         std::cerr << "-> Layout::~Layout ["<< this << "] \n";
     Clear();
+    if (RefreshIndex *index = Index())
+        index->Forget(this);
     IFTRACE(justify)
         std::cerr << "<- Layout::~Layout ["<< this << "] \n";
 }
@@ -231,12 +311,12 @@ void Layout::Clear()
         delete *i;
     }
     items.clear();
+    InvalidateCommands();
 
     // Initial state has no rotation or attribute changes
     ClearAttributes();
 
-    refreshEvents.clear();
-    nextRefresh = DBL_MAX;
+    ClearRefresh();
     IFTRACE(justify)
         std::cerr << "<- Layout::Clear ["<< this << "] \n";
 }
@@ -280,31 +360,65 @@ void Layout::Draw(Layout *where)
 //   Draw the elements in the layout
 // ----------------------------------------------------------------------------
 {
+    // Nothing to do in the transparent pass if we were found opaque
+    if (where && where->transparency && SkipTransparentPass())
+    {
+        SkipPolygonOffsets(opaqueOffsets, opaqueResets);
+        return;
+    }
+
+    // Nothing to do if we are outside of the view
+    if (where && Culled(where))
+        return;
+
     IFTRACE(lfps)
         PerLayoutStatistics::beginDraw(body);
 
     // Save polygon offset for transparency
     int savePolygonOffset = polygonOffset;
+    uint saveResets = polygonResets;
+
+    // A new opaque pass starts from the root
+    if (!where && !transparency)
+        drawPass++;
 
     if (true)
     {
         // Inherit offset from our parent layout if there is one
         XL::Save<Point3> save(offset, offset);
+        XL::Save<bool> saveContent(transparentContent, false);
         GLAllStateKeeper glSave;
         Inherit(where);
 
         // Display all items
         PushLayout();
-        for (Drawings::iterator i = items.begin(); i != items.end(); i++)
+        if (compileDrawings)
         {
-            Drawing *child = *i;
-            child->Draw(this);
+            if (!compiled)
+                Compile();
+            Replay(commands, 0, commands.size());
+        }
+        else
+        {
+            for (Drawings::iterator i = items.begin(); i != items.end(); i++)
+                DrawItem(*i);
         }
         PopLayout();
+        RecordOpaque();
+        saveContent.saved |= transparentContent;
+    }
+
+    // Record the polygon offsets we used, in case we skip the next pass
+    if (!transparency)
+    {
+        opaqueResets = polygonResets != saveResets;
+        opaqueOffsets = polygonOffset;
+        if (!opaqueResets)
+            opaqueOffsets -= savePolygonOffset;
     }
 
     // Two passes for transparency, see #2199
-    if (!where && !transparency)
+    if (!where && !transparency && !SkipTransparentPass())
     {
         polygonOffset = savePolygonOffset;
         ClearAttributes();
@@ -319,6 +433,630 @@ void Layout::Draw(Layout *where)
 }
 
 
+void Layout::DrawItem(Drawing *item)
+// ----------------------------------------------------------------------------
+//   Draw an item, checking if it may have content for the transparent pass
+// ----------------------------------------------------------------------------
+//   Shapes and text tell us through Layout::TransparencyCheck. Drawings that
+//   don't are assumed to draw in both passes.
+{
+    uint checks = transparencyChecks;
+    item->Draw(this);
+    if (checks == transparencyChecks && !transparency && !item->IsAttribute())
+        transparentContent = true;
+}
+
+
+void Layout::RecordOpaque()
+// ----------------------------------------------------------------------------
+//   After drawing in the opaque pass, remember if we had transparent content
+// ----------------------------------------------------------------------------
+//   A layout may be drawn several times in a pass (e.g. text flows),
+//   so it is opaque only if it was opaque every time.
+{
+    if (transparency)
+        return;
+    bool isOpaque = !transparentContent;
+    if (opaquePass != drawPass)
+    {
+        opaquePass = drawPass;
+        opaque = isOpaque;
+    }
+    else
+    {
+        opaque = opaque && isOpaque;
+    }
+}
+
+
+bool Layout::SkipTransparentPass()
+// ----------------------------------------------------------------------------
+//   Check if the last opaque pass found nothing to draw in transparent pass
+// ----------------------------------------------------------------------------
+{
+    if (opaque && opaquePass == drawPass)
+    {
+        transparentSkipped++;
+        return true;
+    }
+    return false;
+}
+
+
+void Layout::SkipPolygonOffsets(uint offsets, bool resets)
+// ----------------------------------------------------------------------------
+//   Advance the polygon offset as if a skipped layout had been drawn
+// ----------------------------------------------------------------------------
+//   Shapes drawn after the skipped layout must get the same offsets in
+//   the transparent pass as in the opaque pass, otherwise they fail the
+//   depth test against coplanar opaque shapes.
+{
+    if (resets)
+        polygonOffset = offsets;
+    else
+        polygonOffset += offsets;
+}
+
+
+void Layout::NewFrame()
+// ----------------------------------------------------------------------------
+//   Record the drawing counters for the frame that just ended
+// ----------------------------------------------------------------------------
+{
+    lastTransparentSkipped = transparentSkipped;
+    transparentSkipped = 0;
+    lastLayoutsCulled = layoutsCulled;
+    layoutsCulled = 0;
+    lastLayoutsDrawn = layoutsDrawn;
+    layoutsDrawn = 0;
+    LayoutSharedState::lastCopies = LayoutSharedState::copies;
+    LayoutSharedState::copies = 0;
+}
+
+
+static void cullInclude(Box3 &result, Box3 box, scale margin,
+                        Matrix4 &model)
+// ----------------------------------------------------------------------------
+//   Add a box widened by the line width, transformed by the model matrix
+// ----------------------------------------------------------------------------
+{
+    if (box.lower.x > box.upper.x)
+        return;
+    box.lower -= Vector3(margin, margin, margin);
+    box.upper += Vector3(margin, margin, margin);
+
+    coord *m = model.Data(false);
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        coord x = corner & 1 ? box.upper.x : box.lower.x;
+        coord y = corner & 2 ? box.upper.y : box.lower.y;
+        coord z = corner & 4 ? box.upper.z : box.lower.z;
+        result |= Point3(m[0] * x + m[4] * y + m[8]  * z + m[12],
+                         m[1] * x + m[5] * y + m[9]  * z + m[13],
+                         m[2] * x + m[6] * y + m[10] * z + m[14]);
+    }
+}
+
+
+bool Layout::CullBounds(Layout *where, Box3 &bounds)
+// ----------------------------------------------------------------------------
+//   Return the cached bounds of the items if they are reliable for culling
+// ----------------------------------------------------------------------------
+//   The bounds are relative to the offset of 'where', and include the
+//   transforms, moves, line widths and font changes of the items. They
+//   depend on the font and line width of 'where' if an item uses them
+//   before setting them, in which case we recompute them when these change.
+//   Bounds are not reliable if an item changes the geometry in a way we
+//   don't track (shaders, extrusion, absolute moves, balloon tails).
+{
+    if (cullState != CULL_UNKNOWN &&
+        ((cullWidth >= 0 && cullWidth != where->lineWidth) ||
+         (cullFont && cullFont != where->FontKey())))
+        cullState = CULL_UNKNOWN;
+
+    if (cullState == CULL_UNKNOWN)
+    {
+        // Track the offset, font and line width as drawing would
+        Layout state(*where);
+        state.offset = Vector3();
+        Vector3 &offset = state.offset;
+        Matrix4 model;
+        bool ok = true;
+        bool fontSet = false, widthSet = false;
+        bool usesFont = false, usesWidth = false;
+        Box3 result;
+        for (Drawings::iterator i = items.begin(); ok && i != items.end(); i++)
+        {
+            Drawing *item = *i;
+            if (Layout *child = dynamic_cast<Layout *> (item))
+            {
+                Box3 childBounds;
+                ok = (child->parent == this && child->Flattenable() &&
+                      child->CullBounds(&state, childBounds));
+                if (ok)
+                {
+                    childBounds += offset;
+                    cullInclude(result, childBounds, 0, model);
+                    usesFont |= !fontSet && child->cullFont;
+                    usesWidth |= !widthSet && child->cullWidth >= 0;
+                }
+            }
+            else if (Rectangle *rect = dynamic_cast<Rectangle *> (item))
+            {
+                // Balloons and callouts draw a tail outside of their bounds
+                ok = (!dynamic_cast<SpeechBalloon *> (item) &&
+                      !dynamic_cast<Callout *> (item));
+                Box3 box(rect->bounds);
+                box += offset;
+                cullInclude(result, box, state.lineWidth, model);
+                usesWidth |= !widthSet;
+            }
+            else if (Cube *cube = dynamic_cast<Cube *> (item))
+            {
+                // Spheres, tori and cones are drawn within the cube bounds
+                cullInclude(result, cube->bounds + offset,
+                            state.lineWidth, model);
+                usesWidth |= !widthSet;
+            }
+            else if (GraphicPath *path = dynamic_cast<GraphicPath *> (item))
+            {
+                // Endpoint decorations are drawn outside of the path bounds
+                ok = (path->startStyle == GraphicPath::NONE &&
+                      path->endStyle == GraphicPath::NONE);
+                cullInclude(result, path->Bounds(&state),
+                            state.lineWidth, model);
+                usesWidth |= !widthSet;
+            }
+            else if (TextSplit *split = dynamic_cast<TextSplit *> (item))
+            {
+                // Evaluated text changes, and new lines restart at x = 0
+                ok = (!dynamic_cast<TextFormula *> (item) &&
+                      !dynamic_cast<TextValue *> (item) &&
+                      split->source->value.find('\n', split->start) >=
+                      split->end);
+                if (ok)
+                    cullInclude(result, split->Bounds(&state),
+                                state.lineWidth, model);
+                usesFont |= !fontSet;
+                usesWidth |= !widthSet;
+            }
+            else if (Translation *t = dynamic_cast<Translation *> (item))
+            {
+                model.Translate(t->xaxis, t->yaxis, t->zaxis);
+            }
+            else if (Rotation *r = dynamic_cast<Rotation *> (item))
+            {
+                // Rotations and scaling are around the current offset
+                model.Translate(offset.x, offset.y, offset.z);
+                model.Rotate(r->amount, r->xaxis, r->yaxis, r->zaxis);
+                model.Translate(-offset.x, -offset.y, -offset.z);
+            }
+            else if (Scale *s = dynamic_cast<Scale *> (item))
+            {
+                model.Translate(offset.x, offset.y, offset.z);
+                model.Scale(s->xaxis, s->yaxis, s->zaxis);
+                model.Translate(-offset.x, -offset.y, -offset.z);
+            }
+            else if (MoveToRel *move = dynamic_cast<MoveToRel *> (item))
+            {
+                offset += Vector3(move->xaxis, move->yaxis, move->zaxis);
+            }
+            else if (FontChange *font = dynamic_cast<FontChange *> (item))
+            {
+                font->Draw(&state);
+                fontSet = true;
+            }
+            else if (LineWidth *lw = dynamic_cast<LineWidth *> (item))
+            {
+                state.lineWidth = lw->width;
+                widthSet = true;
+            }
+            else if (dynamic_cast<ClipPlane *> (item))
+            {
+                // Clipping only removes geometry
+            }
+            else if (dynamic_cast<Transform *> (item) ||
+                     dynamic_cast<ShaderProgram *> (item) ||
+                     dynamic_cast<ExtrudeDepth *> (item))
+            {
+                ok = false;
+            }
+            else
+            {
+                // Other attributes and manipulators don't draw geometry
+                ok = item->IsAttribute() || dynamic_cast<Manipulator *>(item);
+            }
+        }
+
+        cullBounds = result;
+        cullState = ok ? CULL_BOUNDS : CULL_NEVER;
+        cullFont = ok && usesFont ? where->FontKey() : 0;
+        cullWidth = ok && usesWidth ? where->lineWidth : -1;
+    }
+
+    bounds = cullBounds;
+    return cullState == CULL_BOUNDS;
+}
+
+
+bool Layout::Culled(Layout *where)
+// ----------------------------------------------------------------------------
+//   Check if the layout is entirely outside of the view, and count it
+// ----------------------------------------------------------------------------
+//   Layouts are only counted when drawn, not when identified
+{
+    if (!cullLayouts)
+        return false;
+
+    bool culled = OutsideView(where);
+    if (!inIdentify)
+    {
+        if (culled)
+            layoutsCulled++;
+        else
+            layoutsDrawn++;
+    }
+    return culled;
+}
+
+
+bool Layout::OutsideView(Layout *where)
+// ----------------------------------------------------------------------------
+//   Check if the layout is entirely outside of the current view frustum
+// ----------------------------------------------------------------------------
+{
+    // Extrusion inherited from the parent may exceed the bounds
+    Box3 bounds;
+    if (!Flattenable() || where->extrudeDepth > 0.0 ||
+        !CullBounds(where, bounds) || bounds.lower.x > bounds.upper.x)
+        return false;
+    bounds += where->Offset();
+
+    // Combined projection and model-view matrix (column-major)
+    coord *mv = GL.ModelViewMatrix();
+    coord *pr = GL.ProjectionMatrix();
+    coord m[16];
+    for (uint c = 0; c < 4; c++)
+        for (uint r = 0; r < 4; r++)
+            m[4*c+r] = (pr[0*4+r] * mv[4*c+0] + pr[1*4+r] * mv[4*c+1] +
+                        pr[2*4+r] * mv[4*c+2] + pr[3*4+r] * mv[4*c+3]);
+
+    // Check if all corners are outside the same clipping plane
+    uint outside[6] = { 0, 0, 0, 0, 0, 0 };
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        coord x = corner & 1 ? bounds.upper.x : bounds.lower.x;
+        coord y = corner & 2 ? bounds.upper.y : bounds.lower.y;
+        coord z = corner & 4 ? bounds.upper.z : bounds.lower.z;
+        coord clip[4];
+        for (uint r = 0; r < 4; r++)
+            clip[r] = m[r] * x + m[4+r] * y + m[8+r] * z + m[12+r];
+        for (uint axis = 0; axis < 3; axis++)
+        {
+            if (clip[axis] < -clip[3])
+                outside[2*axis]++;
+            if (clip[axis] > clip[3])
+                outside[2*axis+1]++;
+        }
+    }
+    for (uint plane = 0; plane < 6; plane++)
+        if (outside[plane] == 8)
+            return true;
+    return false;
+}
+
+
+void Layout::Compile()
+// ----------------------------------------------------------------------------
+//   Build the flat draw command stream for this layout and its children
+// ----------------------------------------------------------------------------
+{
+    commands.clear();
+    CompileItems(commands);
+    compiled = true;
+}
+
+
+void Layout::CompileItems(DrawCommands &cmds)
+// ----------------------------------------------------------------------------
+//   Append the commands drawing our items to the given command stream
+// ----------------------------------------------------------------------------
+{
+    for (Drawings::iterator i = items.begin(); i != items.end(); i++)
+    {
+        Drawing *item = *i;
+        Layout *child = dynamic_cast<Layout *> (item);
+        if (child && child->parent == this && child->Flattenable())
+        {
+            uint enter = cmds.size();
+            DrawCommand cmd = DrawCommand();
+            cmd.opcode = DrawCommand::ENTER;
+            cmd.layout = child;
+            cmds.push_back(cmd);
+            child->CompileItems(cmds);
+            uint end = cmds.size();
+            cmds[enter].end = end;
+        }
+        else
+        {
+            cmds.push_back(CompileItem(item));
+        }
+    }
+}
+
+
+DrawCommand Layout::CompileItem(Drawing *item)
+// ----------------------------------------------------------------------------
+//   Build the record drawing an item
+// ----------------------------------------------------------------------------
+//   Only drawings of exactly the given types are turned into records,
+//   since derived classes may draw differently.
+{
+    DrawCommand cmd = DrawCommand();
+    cmd.opcode = DrawCommand::DRAW;
+    cmd.drawing = item;
+
+    const std::type_info &type = typeid(*item);
+    coord *args = cmd.args;
+    if (type == typeid(Tao::FillColor) || type == typeid(Tao::LineColor))
+    {
+        const Color &color = ((ColorAttribute *) item)->color;
+        cmd.opcode = (type == typeid(Tao::FillColor)
+                      ? DrawCommand::FILL_COLOR
+                      : DrawCommand::LINE_COLOR);
+        args[0] = color.red;
+        args[1] = color.green;
+        args[2] = color.blue;
+        args[3] = color.alpha;
+    }
+    else if (type == typeid(LineWidth))
+    {
+        cmd.opcode = DrawCommand::LINE_WIDTH;
+        args[0] = ((LineWidth *) item)->width;
+    }
+    else if (type == typeid(Translation))
+    {
+        Translation *t = (Translation *) item;
+        cmd.opcode = DrawCommand::TRANSLATE;
+        args[0] = t->xaxis;
+        args[1] = t->yaxis;
+        args[2] = t->zaxis;
+    }
+    else if (type == typeid(Rotation))
+    {
+        Rotation *r = (Rotation *) item;
+        cmd.opcode = DrawCommand::ROTATE;
+        args[0] = r->amount;
+        args[1] = r->xaxis;
+        args[2] = r->yaxis;
+        args[3] = r->zaxis;
+    }
+    else if (type == typeid(Scale))
+    {
+        Scale *s = (Scale *) item;
+        cmd.opcode = DrawCommand::SCALE;
+        args[0] = s->xaxis;
+        args[1] = s->yaxis;
+        args[2] = s->zaxis;
+    }
+    else if (type == typeid(FillTexture))
+    {
+        FillTexture *t = (FillTexture *) item;
+        cmd.opcode = DrawCommand::TEXTURE;
+        cmd.texture = t->glName;
+        cmd.target = t->glType;
+    }
+    else if (type == typeid(Rectangle) ||
+             type == typeid(RoundedRectangle) ||
+             type == typeid(Ellipse) ||
+             type == typeid(EllipseArc) ||
+             type == typeid(IsoscelesTriangle) ||
+             type == typeid(RightTriangle))
+    {
+        // These shapes are drawn by Shape2::Draw from their path
+        cmd.opcode = DrawCommand::SHAPE;
+    }
+    return cmd;
+}
+
+
+bool Layout::Flattenable()
+// ----------------------------------------------------------------------------
+//   Check if a child layout can be replayed directly in its parent's stream
+// ----------------------------------------------------------------------------
+//   This is only true for layouts that draw exactly like Layout::Draw
+{
+    const std::type_info &type = typeid(*this);
+    return (type == typeid(Layout) ||
+            type == typeid(SpaceLayout) ||
+            type == typeid(GroupLayout));
+}
+
+
+void Layout::InvalidateCommands()
+// ----------------------------------------------------------------------------
+//   Discard command streams and cached bounds that depend on our items
+// ----------------------------------------------------------------------------
+{
+    for (Layout *l = this; l; l = l->parent)
+    {
+        if (l->compiled)
+        {
+            l->commands.clear();
+            l->compiled = false;
+            commandsDiscarded++;
+        }
+        l->cullState = CULL_UNKNOWN;
+    }
+}
+
+
+void Layout::Replay(DrawCommands &cmds, uint first, uint last)
+// ----------------------------------------------------------------------------
+//   Draw a range of commands in this layout
+// ----------------------------------------------------------------------------
+//   Each record at this level draws one of our items, the records of child
+//   layouts being skipped with their ENTER record. If drawing an item adds
+//   or removes drawings in the tree, the stream is discarded while we use
+//   it, and the items we did not draw yet are drawn by walking the tree.
+{
+    uint discarded = commandsDiscarded;
+    uint item = 0;
+    for (uint pc = first; pc < last; pc++, item++)
+    {
+        if (commandsDiscarded != discarded)
+        {
+            for (; item < items.size(); item++)
+                DrawItem(items[item]);
+            return;
+        }
+
+        DrawCommand &cmd = cmds[pc];
+        switch (cmd.opcode)
+        {
+        case DrawCommand::DRAW:
+            DrawItem(cmd.drawing);
+            break;
+
+        case DrawCommand::SHAPE:
+        {
+            // Same as DrawItem, but without a virtual call
+            uint checks = transparencyChecks;
+            ((Shape2 *) cmd.drawing)->Shape2::Draw(this);
+            if (checks == transparencyChecks && !transparency)
+                transparentContent = true;
+            break;
+        }
+
+        case DrawCommand::ENTER:
+        {
+            uint end = cmd.end;
+            ReplayChild(cmds, pc);
+            pc = end - 1;
+            break;
+        }
+
+        default:
+            ReplayState(cmd);
+            break;
+        }
+    }
+}
+
+
+void Layout::ReplayState(DrawCommand &cmd)
+// ----------------------------------------------------------------------------
+//   Replay a record changing the layout or GL state
+// ----------------------------------------------------------------------------
+//   Colors are only written if they change, so that replaying does not
+//   copy the color state shared with our parent.
+{
+    coord *args = cmd.args;
+    switch (cmd.opcode)
+    {
+    case DrawCommand::FILL_COLOR:
+    {
+        Color color(args[0], args[1], args[2], args[3]);
+        if (color != FillColor())
+            ColorState().fillColor = color;
+        break;
+    }
+    case DrawCommand::LINE_COLOR:
+    {
+        Color color(args[0], args[1], args[2], args[3]);
+        if (color != LineColor())
+            ColorState().lineColor = color;
+        break;
+    }
+    case DrawCommand::LINE_WIDTH:
+        LineWidth::Apply(this, args[0]);
+        break;
+    case DrawCommand::TRANSLATE:
+        Translation::Apply(args[0], args[1], args[2]);
+        break;
+    case DrawCommand::ROTATE:
+        Rotation::Apply(this, args[0], args[1], args[2], args[3]);
+        break;
+    case DrawCommand::SCALE:
+        Scale::Apply(this, args[0], args[1], args[2]);
+        break;
+    case DrawCommand::TEXTURE:
+        FillTexture::Apply(cmd.texture, cmd.target);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void Layout::ReplayChild(DrawCommands &cmds, uint pc)
+// ----------------------------------------------------------------------------
+//   Draw the child layout starting at 'pc' and record its polygon offsets
+// ----------------------------------------------------------------------------
+//   The offsets of culled children are left as measured when last drawn
+{
+    DrawCommand &cmd = cmds[pc];
+    Layout *child = cmd.layout;
+    uint end = cmd.end;
+    if (transparency && child->SkipTransparentPass())
+    {
+        SkipPolygonOffsets(cmd.offsets, cmd.resets);
+        return;
+    }
+    if (child->Culled(this))
+        return;
+
+    int before = polygonOffset;
+    uint resets = polygonResets;
+    uint discarded = commandsDiscarded;
+    child->DrawCompiled(this, cmds, pc + 1, end);
+
+    // The stream may have been discarded while drawing
+    if (!transparency && commandsDiscarded == discarded)
+    {
+        // 3D shapes restart polygon offsets from zero
+        bool reset = polygonResets != resets;
+        cmds[pc].offsets = reset ? polygonOffset : polygonOffset - before;
+        cmds[pc].resets = reset;
+    }
+}
+
+
+void Layout::DrawCompiled(Layout *where, DrawCommands &cmds,
+                          uint first, uint last)
+// ----------------------------------------------------------------------------
+//   Draw a flattened child layout, same as Draw(where) for a non-root layout
+// ----------------------------------------------------------------------------
+{
+    IFTRACE(lfps)
+        PerLayoutStatistics::beginDraw(body);
+
+    GLAllStateKeeper glSave;
+    EnterCompiled(where, cmds, first, last);
+
+    IFTRACE(lfps)
+        PerLayoutStatistics::endDraw(body);
+}
+
+
+void Layout::EnterCompiled(Layout *where, DrawCommands &cmds,
+                           uint first, uint last)
+// ----------------------------------------------------------------------------
+//   Inherit the state of our parent and replay our records
+// ----------------------------------------------------------------------------
+{
+    XL::Save<Point3> save(offset, offset);
+    XL::Save<bool> saveContent(transparentContent, false);
+    Inherit(where);
+
+    PushLayout();
+    Replay(cmds, first, last);
+    PopLayout();
+    RecordOpaque();
+    saveContent.saved |= transparentContent;
+}
+
+
 void Layout::DrawSelection(Layout *where)
 // ----------------------------------------------------------------------------
 //   Draw the selection for the elements in the layout
@@ -367,6 +1105,10 @@ void Layout::Identify(Layout *where)
 //   Identify the elements of the layout for OpenGL selection
 // ----------------------------------------------------------------------------
 {
+    // Nothing to identify if we are outside of the view
+    if (where && Culled(where))
+        return;
+
     IFTRACE(lfps)
         PerLayoutStatistics::beginDraw(body);
 
@@ -480,9 +1222,17 @@ void Layout::Add(Drawing *d)
                   << demangle(typeid(*d).name()) << std::endl;
 
     items.push_back(d);
+    InvalidateCommands();
     Layout * child = dynamic_cast<Layout *>(d);
     if (child)
+    {
+        // Move refresh subscriptions to the index of our root, if any
+        RefreshIndex *from = child->Index();
         child->parent = this;
+        RefreshIndex *to = child->Index();
+        if (from != to)
+            child->Reindex(from, to);
+    }
     d->Evaluate(this);
 }
 
@@ -505,6 +1255,7 @@ void Layout::ClearPolygonOffset()
 // ----------------------------------------------------------------------------
 {
     polygonOffset = 0;
+    polygonResets++;
     GL.PolygonOffset(factorBase, unitBase);
 }
 
@@ -596,8 +1347,7 @@ bool Layout::Refresh(QEvent *e, double now, Layout *parent, QString dbg)
             std::cerr << "Layout " << layoutId
                       << " id " << id << " needs updating\n";
 
-        refreshEvents.clear();
-        nextRefresh = DBL_MAX;
+        ClearRefresh();
 
         // Check if we can evaluate locally
         if (ctx && body)
@@ -677,6 +1427,9 @@ bool Layout::RefreshChildren(QEvent *e, double now, QString dbg)
 //   Refresh all child layouts
 // ----------------------------------------------------------------------------
 {
+    if (RefreshIndex *index = RootIndex())
+        return RefreshIndexed(index, e, now, dbg);
+
     bool result = false;
     Layouts lyo;
     ChildLayouts(lyo);
@@ -686,11 +1439,113 @@ bool Layout::RefreshChildren(QEvent *e, double now, QString dbg)
 }
 
 
+bool Layout::RefreshIndexed(RefreshIndex *index, QEvent *e, double now,
+                            QString dbg)
+// ----------------------------------------------------------------------------
+//   Refresh only the layouts that subscribed to the event
+// ----------------------------------------------------------------------------
+{
+    bool result = false;
+    Layouts targets;
+    index->Targets(e, now, targets);
+
+    IFTRACE(layoutevents)
+        std::cerr << "Event " << ToText(e->type()) << " dispatched to "
+                  << targets.size() << " layout(s)\n";
+
+    for (Layouts::iterator i = targets.begin(); i != targets.end(); i++)
+    {
+        Layout *target = *i;
+        if (target != this)
+            result |= target->Refresh(e, now, target->parent, dbg);
+    }
+    return result;
+}
+
+
+RefreshIndex *Layout::Index()
+// ----------------------------------------------------------------------------
+//   Return the refresh index of the root of the tree we belong to
+// ----------------------------------------------------------------------------
+{
+    Layout *root = this;
+    while (root->parent)
+        root = root->parent;
+    return root->RootIndex();
+}
+
+
+void Layout::Reindex(RefreshIndex *from, RefreshIndex *to)
+// ----------------------------------------------------------------------------
+//   Move subscriptions for this layout and its children to another index
+// ----------------------------------------------------------------------------
+{
+    if (refreshEvents.size() || nextRefresh != DBL_MAX)
+    {
+        if (from)
+            from->Remove(this);
+        if (to)
+            to->Insert(this);
+    }
+    if (names.size() || deps.size())
+    {
+        if (from)
+            from->Forget(this);
+        if (to)
+            to->Register(this);
+    }
+
+    Layouts lyo;
+    ChildLayouts(lyo);
+    for (Layouts::iterator i = lyo.begin(); i != lyo.end(); i++)
+        if ((*i)->parent == this)
+            (*i)->Reindex(from, to);
+}
+
+
+void Layout::SetNextRefresh(double when, RefreshIndex *index)
+// ----------------------------------------------------------------------------
+//   Change the refresh deadline and record it in the index
+// ----------------------------------------------------------------------------
+{
+    if (index)
+        index->Schedule(this, nextRefresh, when);
+    nextRefresh = when;
+}
+
+
+void Layout::ClearRefresh()
+// ----------------------------------------------------------------------------
+//   Remove all refresh events and deadline for this layout
+// ----------------------------------------------------------------------------
+{
+    if (refreshEvents.size() || nextRefresh != DBL_MAX)
+        if (RefreshIndex *index = Index())
+            index->Remove(this);
+    refreshEvents.clear();
+    nextRefresh = DBL_MAX;
+}
+
+
+bool Layout::HasRefreshEvent(int type)
+// ----------------------------------------------------------------------------
+//   Check if this layout or any child refreshes on the given event type
+// ----------------------------------------------------------------------------
+{
+    if (RefreshIndex *index = RootIndex())
+        return index->Subscribed(type);
+    return RefreshEvents().count(type) != 0;
+}
+
+
 LayoutState::qevent_ids Layout::RefreshEvents()
 // ----------------------------------------------------------------------------
 //   The set of all refresh events for this layout and its children
 // ----------------------------------------------------------------------------
 {
+    if (RefreshIndex *index = RootIndex())
+        return index->Events();
+
     LayoutState::qevent_ids events = refreshEvents;
     Layouts lyo;
     ChildLayouts(lyo);
@@ -708,6 +1563,9 @@ double Layout::NextRefresh()
 //   The date of next refresh for this layout or any of its children
 // ----------------------------------------------------------------------------
 {
+    if (RefreshIndex *index = RootIndex())
+        return index->NextRefresh();
+
     double next = nextRefresh;
     Layouts lyo;
     ChildLayouts(lyo);
@@ -743,16 +1601,22 @@ bool Layout::RefreshOn(Layout *layout)
 // ----------------------------------------------------------------------------
 {
     bool changed = false;
+    RefreshIndex *index = Index();
 
-    qevent_ids::size_type prev = refreshEvents.size();
-    refreshEvents.insert(layout->refreshEvents.begin(),
-                         layout->refreshEvents.end());
-    if (refreshEvents.size() != prev)
-        changed = true;
+    qevent_ids &events = layout->refreshEvents;
+    for (qevent_ids::iterator i = events.begin(); i != events.end(); i++)
+    {
+        if (refreshEvents.insert(*i).second)
+        {
+            if (index)
+                index->Subscribe(this, *i);
+            changed = true;
+        }
+    }
 
     if (layout->nextRefresh < nextRefresh)
     {
-        nextRefresh = layout->nextRefresh;
+        SetNextRefresh(layout->nextRefresh, index);
         changed = true;
     }
 
@@ -786,17 +1650,20 @@ bool Layout::RefreshOn(int type, double when)
 // ----------------------------------------------------------------------------
 {
     bool changed = false;
+    RefreshIndex *index = Index();
 
     if (refreshEvents.count(type) == 0)
     {
         refreshEvents.insert(type);
+        if (index)
+            index->Subscribe(this, type);
         changed = true;
     }
 
     if (type == QEvent::Timer &&
         when < nextRefresh)
     {
-        nextRefresh = when;
+        SetNextRefresh(when, index);
         changed = true;
     }
 
@@ -811,9 +1678,12 @@ void Layout::NoRefreshOn(int type)
 {
     if (refreshEvents.count(type) != 0)
     {
+        RefreshIndex *index = Index();
         refreshEvents.erase(type);
+        if (index)
+            index->Unsubscribe(this, type);
         if (type == QEvent::Timer)
-            nextRefresh = DBL_MAX;
+            SetNextRefresh(DBL_MAX, index);
     }
 }
 
@@ -825,7 +1695,9 @@ void Layout::AddName(text name)
 {
     IFTRACE(layoutevents)
         std::cerr << "Name " << name << " is layout " << PrettyId() << "\n";
-    names.insert(name);
+    if (names.insert(name).second)
+        if (RefreshIndex *index = Index())
+            index->AddName(this, name);
 }
 
 
@@ -837,7 +1709,9 @@ void Layout::AddDep(text name)
     IFTRACE(layoutevents)
         std::cerr << "Layout " << PrettyId() << " shall refresh "
                   << name << " \n";
-    deps.insert(name);
+    if (deps.insert(name).second)
+        if (RefreshIndex *index = Index())
+            index->AddDep(this);
 }
 
 
@@ -846,6 +1720,10 @@ void Layout::CheckRefreshDeps()
 //   Copy refresh info of children to named dependent layouts (refresh_also)
 // ----------------------------------------------------------------------------
 {
+    // The root layout maintains the dependency graph incrementally
+    if (RefreshIndex *index = RootIndex())
+        return index->PropagateDeps();
+
     // All named layouts.
     // One name can be shared by multiple layout, and one layout can
     // have several names.
@@ -942,10 +1820,6 @@ void LayoutState::InheritState(LayoutState *where)
     // Inherit color and other parameters as initial values
     // Note that these may really impact what gets rendered,
     // e.g. transparent colors may cause shapes to be drawn or not
-    font             = where->font;
-    alongX           = where->alongX;
-    alongY           = where->alongY;
-    alongZ           = where->alongZ;
     left             = where->left;
     right            = where->right;
     top              = where->top;
@@ -955,16 +1829,11 @@ void LayoutState::InheritState(LayoutState *where)
     extrudeRadius    = where->extrudeRadius;
     extrudeCount     = where->extrudeCount;
     lineWidth        = where->lineWidth;
-    lineColor        = where->lineColor;
-    fillColor        = where->fillColor;
-
-    lightId          = where->lightId;
-    perPixelLighting = where->perPixelLighting;
-
-    programId        = where->programId;
-
-    model            = where->model;
 
+    // Font, colors, lighting and model matrix are shared, not copied
+    sharedText       = where->sharedText;
+    sharedColors     = where->sharedColors;
+    sharedTransform  = where->sharedTransform;
 }
 
 
@@ -974,7 +1843,7 @@ void LayoutState::toDebugString(std::ostream &out) const
 // ----------------------------------------------------------------------------
 {
     out << "LayoutState[" << this << "]\n";
-    out << "\tfont            = " << font.toString().toStdString() << std::endl;
+    out << "\tfont            = " << +Font().toString() << std::endl;
     out << "\tleft            = " << left << std::endl;
     out << "\tright           = " << right << std::endl;
     out << "\ttop             = " << top << std::endl;
@@ -984,10 +1853,10 @@ void LayoutState::toDebugString(std::ostream &out) const
     out << "\textrudeRadius   = " << extrudeRadius << std::endl;
     out << "\textrudeCount    = " << extrudeCount << std::endl;
     out << "\tlineWidth       = " << lineWidth << std::endl;
-    out << "\tlineColor       = " << lineColor << std::endl;
-    out << "\tfillColor       = " << fillColor << std::endl;
-    out << "\tlightId         = " << lightId << std::endl;
-    out << "\tprogramId       = " << programId << std::endl;
+    out << "\tlineColor       = " << LineColor() << std::endl;
+    out << "\tfillColor       = " << FillColor() << std::endl;
+    out << "\tlightId         = " << LightId() << std::endl;
+    out << "\tprogramId       = " << ProgramId() << std::endl;
 }
 
 
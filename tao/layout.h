@@ -34,6 +34,7 @@
 #include <vector>
 #include <set>
 #include <QFont>
+#include <QSharedData>
 #include <QEvent>
 #include <float.h>
 
@@ -41,11 +42,73 @@
 TAO_BEGIN
 struct Widget;
 struct Layout;
+struct RefreshIndex;
+
+struct LayoutSharedState : QSharedData
+// ----------------------------------------------------------------------------
+//   Base for the blocks of state shared between layouts, counting copies
+// ----------------------------------------------------------------------------
+{
+    LayoutSharedState(): QSharedData() {}
+    LayoutSharedState(const LayoutSharedState &o): QSharedData(o) { copies++; }
+
+    static uint         copies, lastCopies;
+};
+
+
+struct LayoutTextState : LayoutSharedState
+// ----------------------------------------------------------------------------
+//   Text attributes of a layout, shared until a layout changes them
+// ----------------------------------------------------------------------------
+{
+    LayoutTextState(): font(qApp->font()), keyedFont(), fontKey(0),
+                       alongX(), alongY(), alongZ() {}
+    static uint64       FontKey(const QFont &font);
+
+    QFont               font;
+    mutable QFont       keyedFont;      // Font for which fontKey was computed
+    mutable uint64      fontKey;        // Fingerprint of keyedFont
+    Justification       alongX, alongY, alongZ;
+};
+
+
+struct LayoutColorState : LayoutSharedState
+// ----------------------------------------------------------------------------
+//   Colors and lighting of a layout, shared until a layout changes them
+// ----------------------------------------------------------------------------
+{
+    LayoutColorState()
+        : lineColor(0,0,0,0),   // Transparent black
+          fillColor(0,0,0,1),   // Black
+          lightId(GL_LIGHT0),
+          perPixelLighting(TaoApp->useShaderLighting),
+          programId(0) {}
+
+    Color               lineColor;
+    Color               fillColor;
+    uint                lightId;
+    bool                perPixelLighting;
+    uint                programId;
+};
+
+
+struct LayoutTransformState : LayoutSharedState
+// ----------------------------------------------------------------------------
+//   Model matrix of a layout, shared until a layout changes it
+// ----------------------------------------------------------------------------
+{
+    Matrix4             model;
+};
+
 
 struct LayoutState
 // ----------------------------------------------------------------------------
 //   The state we want to preserve in a layout
 // ----------------------------------------------------------------------------
+//   Child layouts are created and inherit their state very often, while
+//   they rarely change fonts, colors or transforms. The larger parts of
+//   the state are therefore kept in shared blocks, which are only copied
+//   when written through TextState(), ColorState() or TransformState().
 {
                         LayoutState();
                         LayoutState(const LayoutState &o);
@@ -60,26 +123,39 @@ public:
     void                InheritState(LayoutState *other);
     void                toDebugString(std::ostream &out) const;
 
+    // Read access to the shared state
+    const QFont &       Font() const        { return sharedText->font; }
+    uint64              FontKey() const;
+    const Justification&AlongX() const      { return sharedText->alongX; }
+    const Justification&AlongY() const      { return sharedText->alongY; }
+    const Justification&AlongZ() const      { return sharedText->alongZ; }
+    const Color &       LineColor() const   { return sharedColors->lineColor; }
+    const Color &       FillColor() const   { return sharedColors->fillColor; }
+    uint                LightId() const     { return sharedColors->lightId; }
+    bool                PerPixelLighting() const
+    { return sharedColors->perPixelLighting; }
+    uint                ProgramId() const   { return sharedColors->programId; }
+    const Matrix4 &     Model() const       { return sharedTransform->model; }
+
+    // Write access to the shared state, copying it if necessary
+    LayoutTextState &   TextState()         { return *sharedText; }
+    LayoutColorState &  ColorState()        { return *sharedColors; }
+    LayoutTransformState &TransformState()  { return *sharedTransform; }
+
 public:
     Vector3             offset;
-    QFont               font;
-    Justification       alongX, alongY, alongZ;
     coord               left, right, top, bottom; // Margins
     scale               visibility;
     scale               extrudeDepth;
     scale               extrudeRadius;
     int                 extrudeCount;
     scale               lineWidth;
-    Color               lineColor;
-    Color               fillColor;
 
-    // Lighting states
-    uint                lightId;
-    bool                perPixelLighting;
-    uint                programId;
+    // Shared state (text, colors and lighting, transformations)
+    QSharedDataPointer<LayoutTextState>         sharedText;
+    QSharedDataPointer<LayoutColorState>        sharedColors;
+    QSharedDataPointer<LayoutTransformState>    sharedTransform;
 
-    // Transformations
-    Matrix4             model;
     bool                groupDrag       : 1;
     bool                transparency    : 1;
     bool                blendOrShade    : 1;
@@ -89,6 +165,39 @@ public:
 typedef std::vector<Layout *> Layouts;
 typedef std::set<text>        LayoutNames;
 
+
+struct DrawCommand
+// ----------------------------------------------------------------------------
+//   A record in the flat draw command stream of a compiled layout
+// ----------------------------------------------------------------------------
+//   Child layouts that draw like a plain Layout are flattened in their
+//   parent's stream: an ENTER record is followed by the child's records,
+//   and 'end' is the index of the first record past the child.
+//   Colors, line widths, transforms and textures are copied in the record,
+//   and 2D shapes are drawn with a direct call, so that replaying them
+//   does not go through Drawing::Draw. Other drawings use DRAW records.
+{
+    enum Opcode
+    {
+        DRAW, ENTER,
+        FILL_COLOR, LINE_COLOR, LINE_WIDTH,
+        TRANSLATE, ROTATE, SCALE,
+        TEXTURE, SHAPE
+    };
+
+    Opcode              opcode;
+    uint                end;            // ENTER: end of the child's records
+    Layout *            layout;         // ENTER: child layout to enter
+    Drawing *           drawing;        // DRAW, SHAPE: drawing to draw
+    uint                offsets;        // ENTER: polygon offsets last used
+    bool                resets;         // ENTER: 'offsets' is absolute
+    uint                texture;        // TEXTURE: texture name
+    GLenum              target;         // TEXTURE: texture type
+    coord               args[4];        // Color, width or transform
+};
+typedef std::vector<DrawCommand> DrawCommands;
+
+
 struct Layout : Drawing, LayoutState
 // ----------------------------------------------------------------------------
 //   A layout is responsible for laying out Drawing objects in 2D or 3D space
@@ -117,6 +226,7 @@ public:
     virtual void        Clear();
     virtual void        ClearCaches();
     virtual Widget *    Display()        { return display; }
+    Layout *            Parent()         { return parent; }
     virtual void        PolygonOffset(bool willDraw);
     virtual void        ClearPolygonOffset();
     virtual uint        Selected();
@@ -138,6 +248,9 @@ public:
     void                AddName(text name);
     void                AddDep(text name);
     void                CheckRefreshDeps();
+    bool                HasRefreshEvent(int type);
+    virtual RefreshIndex *RootIndex()   { return NULL; }
+    RefreshIndex *      Index();
 
     LayoutState &       operator=(const LayoutState &o);
     virtual void        Inherit(Layout *other);
@@ -149,9 +262,46 @@ public:
 
     void                CachesInfoFrom(Drawing *d)      { caches.push_back(d); }
 
+    // Compiled draw command stream
+    void                Compile();
+    void                InvalidateCommands();
+
     // Used to optimize away texturing and programs if in Identify
     static bool         InIdentify()    { return inIdentify; }
 
+    // Record if a drawing has content for the transparent pass
+    static void         TransparencyCheck(bool transparent)
+    {
+        transparencyChecks++;
+        if (transparent)
+            transparentContent = true;
+    }
+    static void         NewFrame();
+
+protected:
+    void                CompileItems(DrawCommands &cmds);
+    static DrawCommand  CompileItem(Drawing *item);
+    void                Replay(DrawCommands &cmds, uint first, uint last);
+    void                ReplayState(DrawCommand &cmd);
+    void                ReplayChild(DrawCommands &cmds, uint pc);
+    void                DrawCompiled(Layout *where, DrawCommands &cmds,
+                                     uint first, uint last);
+    void                EnterCompiled(Layout *where, DrawCommands &cmds,
+                                      uint first, uint last);
+    bool                Flattenable();
+    void                DrawItem(Drawing *item);
+    void                RecordOpaque();
+    bool                SkipTransparentPass();
+    static void         SkipPolygonOffsets(uint offsets, bool resets);
+    bool                CullBounds(Layout *where, Box3 &bounds);
+    bool                Culled(Layout *where);
+    bool                OutsideView(Layout *where);
+    bool                RefreshIndexed(RefreshIndex *index, QEvent *e,
+                                       double now, QString debug);
+    void                Reindex(RefreshIndex *from, RefreshIndex *to);
+    void                SetNextRefresh(double when, RefreshIndex *index);
+    void                ClearRefresh();
+
 public:
     // OpenGL identification for that shape and for characters within
     uint                id;
@@ -166,9 +316,25 @@ protected:
     int                 idx;
     Drawings            caches;  // Drawings that may reference us
     friend struct TextFlow;
+    friend struct RefreshIndex;
     // Refresh dependencies
     LayoutNames         names; // Name(s) of this layout
     LayoutNames         deps;  // Layout(s) to refresh with this one
+    // Draw commands, valid until the layout or a descendant changes
+    DrawCommands        commands;
+    bool                compiled;
+    // Nothing to draw in the transparent pass of frame 'opaquePass'
+    bool                opaque;
+    uint                opaquePass;
+    // Polygon offsets used in the opaque pass, absolute if opaqueResets
+    uint                opaqueOffsets;
+    bool                opaqueResets;
+    // Cached bounds of the items, without offset, used for culling
+    enum { CULL_UNKNOWN, CULL_BOUNDS, CULL_NEVER }
+                        cullState;
+    Box3                cullBounds;
+    uint64              cullFont;       // Inherited font used, or 0
+    scale               cullWidth;      // Inherited line width used, or -1
 
 public:
     qevent_ids          refreshEvents;
@@ -179,9 +345,25 @@ public:
 public:
     // Static attributes for polygon offset computation
     static int          polygonOffset;
+    static uint         polygonResets;
     static scale        factorBase, factorIncrement;
     static scale        unitBase, unitIncrement;
     static bool         inIdentify;
+    static bool         compileDrawings;
+
+    // Count of command streams discarded, to detect it while replaying
+    static uint         commandsDiscarded;
+
+    // Transparency pass tracking
+    static uint         transparencyChecks;
+    static bool         transparentContent;
+    static uint         drawPass;
+    static uint         transparentSkipped, lastTransparentSkipped;
+
+    // View frustum culling
+    static bool         cullLayouts;
+    static uint         layoutsCulled, lastLayoutsCulled;
+    static uint         layoutsDrawn, lastLayoutsDrawn;
 };
 
 
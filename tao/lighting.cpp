@@ -105,7 +105,7 @@ void PerPixelLighting::Draw(Layout *where)
 //   Enable or disable per pixel lighting
 // ----------------------------------------------------------------------------
 {
-    where->perPixelLighting = enable;
+    where->ColorState().perPixelLighting = enable;
 }
 
 
@@ -132,16 +132,16 @@ void LightId::Draw(Layout *where)
 //   Select and enable or disable a light
 // ----------------------------------------------------------------------------
 {
-    where->lightId = GL_LIGHT0 + id;
+    where->ColorState().lightId = GL_LIGHT0 + id;
     if (enable)
     {
-        GL.Enable(where->lightId);
+        GL.Enable(where->LightId());
         GL.Enable(GL_LIGHTING);
         GL.LightModel(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
     }
     else
     {
-        GL.Disable(where->lightId);
+        GL.Disable(where->LightId());
         if(! GL.LightsMask())
         {
             GL.Disable(GL_LIGHTING);
@@ -156,7 +156,7 @@ void Light::Draw(Layout *where)
 //   Send the corresponding GL attribute
 // ----------------------------------------------------------------------------
 {
-    GL.Light(where->lightId, function, &args[0]);
+    GL.Light(where->LightId(), function, &args[0]);
 }
 
 
@@ -185,14 +185,14 @@ void ShaderProgram::Draw(Layout *where)
         if(program)
         {
             program->bind();
-            where->programId = program->programId();
+            where->ColorState().programId = program->programId();
             where->blendOrShade = true;
         }
         else
         {
-            where->programId = 0;
+            where->ColorState().programId = 0;
         }
-        GL.UseProgram(where->programId);
+        GL.UseProgram(where->ProgramId());
     }
 }
 
@@ -202,7 +202,7 @@ void ShaderValue::Draw(Layout *where)
 //   Set the shader value
 // ----------------------------------------------------------------------------
 {
-    if (where->programId && !where->InIdentify())
+    if (where->ProgramId() && !where->InIdentify())
     {
         GLint id = location;
         int sz = values.size();
@@ -264,7 +264,7 @@ void ShaderAttribute::Draw(Layout *where)
 //   Set the shader attribute
 // ----------------------------------------------------------------------------
 {
-    if (where->programId && !where->InIdentify())
+    if (where->ProgramId() && !where->InIdentify())
     {
         switch(values.size())
         {
@@ -0,0 +1,166 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+// ****************************************************************************
+//  lru_cache.h                                                     Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     A cache of objects indexed by a key, with a memory budget
+//
+//     Meshes, extruded sides and outlines are expensive to build, and are
+//     kept in such caches. When the objects use more than the budget, or
+//     when there are too many of them, the least recently used ones are
+//     deleted.
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tao.h"
+#include "base.h"
+#include <map>
+#include <list>
+
+
+TAO_BEGIN
+
+template <class Key, class Value>
+struct LRUCache
+// ----------------------------------------------------------------------------
+//   Values owned by the cache, evicted in least recently used order
+// ----------------------------------------------------------------------------
+//   The size of a value is given when it is entered. Values are deleted
+//   when evicted or cleared, but not when the cache is destroyed at exit,
+//   since they may own GL resources and the GL context may be gone.
+{
+    typedef std::list<Key>              Order;
+    struct Entry
+    {
+        Value *                 value;
+        ulong                   size;
+        typename Order::iterator used;  // Position in the LRU order
+    };
+    typedef std::map<Key, Entry>        Entries;
+
+public:
+    LRUCache(ulong maxBytes, uint maxCount = ~0U)
+        : entries(), order(), maxBytes(maxBytes), maxCount(maxCount),
+          bytes(0), hits(0), misses(0), lastHits(0), lastMisses(0) {}
+
+    Value *             Find(const Key &key);
+    Value *             Enter(const Key &key, Value *value, ulong size);
+    void                Clear();
+    void                NewFrame();
+    uint                Count()         { return entries.size(); }
+
+protected:
+    void                Evict();
+
+public:
+    Entries             entries;
+    Order               order;          // Most recently used first
+    ulong               maxBytes;
+    uint                maxCount;
+    ulong               bytes;
+    uint                hits, misses;
+    uint                lastHits, lastMisses;
+};
+
+
+
+// ============================================================================
+//
+//   Template members
+//
+// ============================================================================
+
+template <class Key, class Value>
+Value *LRUCache<Key, Value>::Find(const Key &key)
+// ----------------------------------------------------------------------------
+//   Return the cached value for the key and mark it as recently used
+// ----------------------------------------------------------------------------
+{
+    typename Entries::iterator found = entries.find(key);
+    if (found == entries.end())
+    {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    Entry &entry = (*found).second;
+    order.splice(order.begin(), order, entry.used);
+    return entry.value;
+}
+
+
+template <class Key, class Value>
+Value *LRUCache<Key, Value>::Enter(const Key &key, Value *value, ulong size)
+// ----------------------------------------------------------------------------
+//   Cache a new value, evicting the least recently used ones
+// ----------------------------------------------------------------------------
+//   The new value is always kept, even if it is larger than the budget.
+{
+    bytes += size;
+    Evict();
+
+    order.push_front(key);
+    Entry &entry = entries[key];
+    entry.value = value;
+    entry.size = size;
+    entry.used = order.begin();
+    return value;
+}
+
+
+template <class Key, class Value>
+void LRUCache<Key, Value>::Evict()
+// ----------------------------------------------------------------------------
+//   Delete the least recently used values until we are within budget
+// ----------------------------------------------------------------------------
+{
+    while ((bytes > maxBytes || entries.size() >= maxCount) && !order.empty())
+    {
+        typename Entries::iterator last = entries.find(order.back());
+        Entry &entry = (*last).second;
+        bytes -= entry.size;
+        delete entry.value;
+        entries.erase(last);
+        order.pop_back();
+    }
+}
+
+
+template <class Key, class Value>
+void LRUCache<Key, Value>::Clear()
+// ----------------------------------------------------------------------------
+//   Delete all the cached values
+// ----------------------------------------------------------------------------
+{
+    typename Entries::iterator i;
+    for (i = entries.begin(); i != entries.end(); i++)
+        delete (*i).second.value;
+    entries.clear();
+    order.clear();
+    bytes = 0;
+}
+
+
+template <class Key, class Value>
+void LRUCache<Key, Value>::NewFrame()
+// ----------------------------------------------------------------------------
+//   Record the statistics for the frame that just ended
+// ----------------------------------------------------------------------------
+{
+    lastHits = hits;
+    lastMisses = misses;
+    hits = 0;
+    misses = 0;
+}
+
+TAO_END
+
+#endif // LRU_CACHE_H
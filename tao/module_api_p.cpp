@@ -32,6 +32,7 @@
 #include "window.h"
 #include "texture_cache.h"
 #include "file_monitor.h"
+#include "shapes3d.h"
 
 TAO_BEGIN
 
@@ -144,6 +145,9 @@ ModuleApiPrivate::ModuleApiPrivate()
     currentPageTime = Widget::currentPageTimeAPI;
     DevicePixelRatio = Widget::DevicePixelRatioAPI;
     RenderingTransparency = Widget::RenderingTransparencyAPI;
+
+    // Instanced drawing
+    setInstanceValues = Instances::SetBuffer;
 }
 
 TAO_END
@@ -92,7 +92,7 @@ bool ModuleRenderer::SetShader(int id)
 // ----------------------------------------------------------------------------
 {
     if(id >= 0)
-        currentLayout->programId = id;
+        currentLayout->ColorState().programId = id;
 
     return Shape::setShader(currentLayout);
 }
@@ -121,7 +121,7 @@ Matrix4 ModuleRenderer::ModelMatrix()
 //   Module interface for currentModelMatrix
 // ----------------------------------------------------------------------------
 {
-    return Widget::Tao()->layout->model;
+    return Widget::Tao()->layout->Model();
 }
 
 
@@ -2378,6 +2378,21 @@ void OpenGLState::TexImage2D(GLenum target, GLint level, GLint internalformat,
 }
 
 
+void OpenGLState::TexSubImage2D(GLenum target, GLint level,
+                                GLint xoffset, GLint yoffset,
+                                GLsizei width, GLsizei height,
+                                GLenum format, GLenum type,
+                                const GLvoid *pixels)
+// ----------------------------------------------------------------------------
+//    Replace a region of an existing image
+// ----------------------------------------------------------------------------
+{
+    Sync(STATE_textures | STATE_textureUnits | STATE_activeTexture);
+    glTexSubImage2D(target, level, xoffset, yoffset, width, height,
+                    format, type, pixels);
+}
+
+
 void OpenGLState::CompressedTexImage2D(GLenum target, GLint level,
                                        GLenum internalformat,
                                        GLsizei width, GLsizei height,
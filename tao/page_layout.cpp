@@ -85,6 +85,23 @@ LayoutLine::~LayoutLine()
 }
 
 
+void LayoutLine::SetSpread(Layout *where)
+// ----------------------------------------------------------------------------
+//   Copy the spacing computed for the line to the layout we draw in
+// ----------------------------------------------------------------------------
+//   The text state is shared with the parent layout, so we only write it,
+//   and copy it, if the spacing is not already the one we computed.
+{
+    const Justification &alongX = where->AlongX();
+    if (alongX.perSolid != perSolid || alongX.perBreak != perBreak)
+    {
+        LayoutTextState &textState = where->TextState();
+        textState.alongX.perSolid = perSolid;
+        textState.alongX.perBreak = perBreak;
+    }
+}
+
+
 void LayoutLine::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //   Compute line layout and draw the placed elements
@@ -97,8 +114,7 @@ void LayoutLine::Draw(Layout *where)
                   << ":Draw(Layout * " << where << ")\n";
 
     // Copy the perSolid we computed to the layout we draw in
-    where->alongX.perSolid = perSolid;
-    where->alongX.perBreak = perBreak;
+    SetSpread(where);
 
     // Display all items
     LineJustifier::Places &places = line.places;
@@ -129,8 +145,7 @@ void LayoutLine::DrawSelection(Layout *where)
     assert(!line.data && "LayoutLine::DrawSelection called before layout");
 
     // Copy the perSolid we computed to the layout we draw in
-    where->alongX.perSolid = perSolid;
-    where->alongX.perBreak = perBreak;
+    SetSpread(where);
 
     // Display all items
     LineJustifier::Places &places = line.places;
@@ -153,8 +168,7 @@ void LayoutLine::Identify(Layout *where)
     assert(!line.data && "LayoutLine::Identify called before layout");
 
     // Copy the perSolid we computed to the layout we draw in
-    where->alongX.perSolid = perSolid;
-    where->alongX.perBreak = perBreak;
+    SetSpread(where);
 
     // Display all items
     LineJustifier::Places &places = line.places;
@@ -221,7 +235,8 @@ PageLayout::PageLayout(Widget *widget)
 //   Create a new layout
 // ----------------------------------------------------------------------------
     : Layout(widget),
-      space(), bounds(), page(), currentFlow(NULL), selectId(0)
+      space(), bounds(), page(), alongLines(), alongPage(),
+      currentFlow(NULL), selectId(0)
 {
     IFTRACE(justify)
         std::cerr << "<->PageLayout::PageLayout [" << this
@@ -234,7 +249,7 @@ PageLayout::PageLayout(const PageLayout &o)
 //   Copy a layout from another layout
 // ----------------------------------------------------------------------------
     : Layout(o), space(o.space), bounds(o.bounds),
-      page(), currentFlow(NULL), selectId(0)
+      page(), alongLines(), alongPage(), currentFlow(NULL), selectId(0)
 {
     IFTRACE(justify)
             std::cerr << "<->PageLayout::PageLayout[" << this
@@ -382,9 +397,9 @@ void PageLayout::Identify(Layout *where)
     }
     PopLayout();
 
-    coord x = space.Left(),  y = space.Bottom();
-    coord w = space.Width(), h = space.Height();
-    coord array[4][3] =
+    GLfloat x = space.Left(),  y = space.Bottom();
+    GLfloat w = space.Width(), h = space.Height();
+    GLfloat array[4][3] =
     {
         { x,     y,     0 },
         { x + w, y,     0 },
@@ -395,7 +410,7 @@ void PageLayout::Identify(Layout *where)
     GL.Color(0.2,0.6,1.0,0.1);
     // Load model view matrix
     GL.LoadMatrix();
-    GL.VertexPointer(3, GL_DOUBLE, 0, array);
+    GL.VertexPointer(3, GL_FLOAT, 0, array);
     GL.EnableClientState(GL_VERTEX_ARRAY);
     GL.DrawArrays(GL_QUADS, 0, 4);
     GL.DisableClientState(GL_VERTEX_ARRAY);
@@ -582,8 +597,9 @@ void PageLayout::Compute(Layout *where)
     // Save GL state before paginate to fix #2971.
     GLAllStateKeeper save;
 
-    // Begin pagination
-    page.BeginLayout(top, bottom, alongY);
+    // Begin pagination (the justifier keeps a reference to alongPage)
+    SyncJustification();
+    page.BeginLayout(top, bottom, alongPage);
 
     // Paginate all the items that fit
     bool ok = true;
@@ -596,7 +612,8 @@ void PageLayout::Compute(Layout *where)
     // We are done with the pagination
     if (ok && !page.Empty())
         PaginateLastLine(NoBreak);
-    page.EndLayout(&alongY.perSolid, &alongY.perBreak);
+    SyncJustification();
+    page.EndLayout(&alongPage.perSolid, &alongPage.perBreak);
 
     // Restore state as it was at the beginning of the layout
     Inherit(where);
@@ -615,6 +632,7 @@ bool PageLayout::PaginateItem(Drawing *drawing, BreakOrder order, uint count)
     // Quick exit if we are out of space
     if (!page.HasRoom())
         return false;
+    SyncJustification();
 
     // Find which layout line we are working with
     LayoutLine *line = NULL;
@@ -630,7 +648,8 @@ bool PageLayout::PaginateItem(Drawing *drawing, BreakOrder order, uint count)
     }
     if (!line)
     {
-        line = new LayoutLine(space.Left()+left, space.Right()-right, alongX);
+        line = new LayoutLine(space.Left()+left, space.Right()-right,
+                              alongLines);
         bool lineFits = page.AddItem(line);
         if (!lineFits)
         {
@@ -673,7 +692,8 @@ bool PageLayout::PaginateItem(Drawing *drawing, BreakOrder order, uint count)
             return false;
 
         // Create a new layout line
-        line = new LayoutLine(space.Left()+left, space.Right()-right, alongX);
+        line = new LayoutLine(space.Left()+left, space.Right()-right,
+                              alongLines);
         bool lineFits = page.AddItem(line);
         if (!lineFits)
         {
@@ -708,6 +728,7 @@ bool PageLayout::PaginateLastLine(BreakOrder order)
 // ----------------------------------------------------------------------------
 {
     assert (!page.Empty());
+    SyncJustification();
 
     LayoutLine *line = page.Current();
     page.PopItem();
@@ -733,6 +754,21 @@ bool PageLayout::PaginateLastLine(BreakOrder order)
 }
 
 
+void PageLayout::SyncJustification()
+// ----------------------------------------------------------------------------
+//   Copy the current justification to where the justifiers can refer to it
+// ----------------------------------------------------------------------------
+//   The justifiers keep references to the justification while paginating.
+//   They cannot refer to the text state, which is shared with other layouts
+//   and may be copied or released whenever a layout writes to it. So they
+//   refer to copies in the page layout, which we refresh before using them
+//   so that they see justification changes made by the items paginated.
+{
+    alongLines = AlongX();
+    alongPage = AlongY();
+}
+
+
 void PageLayout::SetLastSplit(TextSplit *split)
 // ----------------------------------------------------------------------------
 //   Record last text split if we have an active flow
@@ -59,6 +59,7 @@ public:
     virtual bool        Paginate(PageLayout *);
 
     void                PerformLayout();
+    void                SetSpread(Layout *where);
 
 public:
     Box                 bounds;
@@ -104,10 +105,15 @@ public:
     void                SetLastSplit(TextSplit *);
     TextSplit *         LastSplit();
 
+protected:
+    void                SyncJustification();
+
 public:
     // Space requested for the layout
     Box                 space, bounds;
     PageJustifier       page;
+    Justification       alongLines;     // Justifiers use this copy of alongX
+    Justification       alongPage;      // ... and this copy of alongY
     TextFlow *          currentFlow;
     uint                selectId; // Selection Id of its englobing layout.
 };
@@ -26,9 +26,10 @@
 #include "manipulator.h"
 #include "gl_keepers.h"
 #include "tao_gl.h"
-#include "tao_glu.h"
+#include "tesselator.h"
 #include <QPainterPath>
 #include <QPainterPathStroker>
+#include <algorithm>
 #include <iostream>
 
 TAO_BEGIN
@@ -36,28 +37,70 @@ TAO_BEGIN
 typedef GraphicPath::VertexData         VertexData;
 typedef GraphicPath::PolygonData        PolygonData;
 typedef GraphicPath::Vertices           Vertices;
-typedef GraphicPath::DynamicVertices    DynamicVertices;
 typedef GraphicPath::EndpointStyle      EndpointStyle;
 
 scale GraphicPath::steps_min = 0;
 scale GraphicPath::steps_increase = 2;
 scale GraphicPath::steps_max = 25;
+scale GraphicPath::flatness = 0;
 
-inline int pathSteps(scale length)
+inline int pathSteps(scale length, scale detail)
 // ----------------------------------------------------------------------------
 //   Compute the number of polygon sides when converting a path
 // ----------------------------------------------------------------------------
+//   If 'detail' is set, it gives the pixels per unit on screen, and steps
+//   are limited so that they are not shorter than Shape::lodPixels, if set.
 {
     scale order = log2(length);
     scale steps = GraphicPath::steps_min
                 + order * GraphicPath::steps_increase;
     if (steps > GraphicPath::steps_max)
         steps = GraphicPath::steps_max;
+    if (detail > 0 && Shape::lodPixels > 0)
+    {
+        scale limit = length * detail / Shape::lodPixels;
+        if (steps > limit)
+            steps = limit;
+    }
     if (steps < 1)
         steps = 1;
     return (int) ceil(steps);
 }
-            
+
+
+inline int curveSteps(const Vertices &control, scale length, scale detail)
+// ----------------------------------------------------------------------------
+//   Compute the number of segments used to flatten a Bezier curve
+// ----------------------------------------------------------------------------
+//   If a flatness is set and 'detail' gives the pixels per unit, we use
+//   Wang's formula, which bounds the distance between the curve and the
+//   segments: n = sqrt(d (d-1) M / 8 tolerance), where d is the degree and
+//   M the largest second difference of the control points. Gentle curves
+//   get few segments, and tight ones as many as they need.
+{
+    const scale MAX_STEPS = 256;
+    uint size = control.size();
+    if (GraphicPath::flatness <= 0 || detail <= 0 || size < 3)
+        return pathSteps(length, detail);
+
+    scale second = 0;
+    for (uint i = 0; i + 2 < size; i++)
+    {
+        Vector3 d = control[i].vertex
+                  - 2 * control[i+1].vertex
+                  + control[i+2].vertex;
+        second = std::max(second, d.Length());
+    }
+    scale degree = size - 1;
+    scale tolerance = GraphicPath::flatness / detail;
+    scale steps = sqrt(degree * (degree - 1) * second / (8 * tolerance));
+    if (steps > MAX_STEPS)
+        steps = MAX_STEPS;
+    if (steps < 1)
+        steps = 1;
+    return (int) ceil(steps);
+}
+
 
 #ifndef CALLBACK // Needed for Windows
 #define CALLBACK
@@ -81,58 +124,36 @@ GraphicPath::~GraphicPath()
 }
 
 
-GraphicPath::PolygonData::~PolygonData()
+static void drawArrays(GLenum mode, uint64 textureUnits, Vertices &data)
 // ----------------------------------------------------------------------------
-//   Delete all the intersections we created
+//   Draw arrays after packing them as floats
 // ----------------------------------------------------------------------------
 {
-    DynamicVertices::iterator i;
-    for (i = allocated.begin(); i != allocated.end(); i++)
-        delete *i;
+    static VertexArray packed;
+    VertexArray::Vertices &vertices = packed.vertices;
+    uint count = data.size();
+    vertices.clear();
+    vertices.reserve(count);
+    for (uint i = 0; i < count; i++)
+        vertices.push_back(PackedVertex(data[i].vertex, data[i].normal,
+                                        data[i].texture));
+    packed.Draw(mode, textureUnits);
 }
 
 
-static void drawArrays(GLenum mode, uint64 textureUnits, Vertices &data)
+static void addStrip(ExtrusionMesh &mesh, Vertices &strip)
 // ----------------------------------------------------------------------------
-//   Draw arrays 
+//   Append a triangle strip to an extrusion mesh after packing it as floats
 // ----------------------------------------------------------------------------
 {
-    double *vdata = &data[0].vertex.x;
-    double *tdata = &data[0].texture.x;
-    double *ndata = &data[0].normal.x;
-    GLuint size = data.size();
-
-    GL.VertexPointer(3,GL_DOUBLE,sizeof(VertexData), vdata);
-    GL.NormalPointer(GL_DOUBLE, sizeof(VertexData), ndata);
-    GL.EnableClientState(GL_VERTEX_ARRAY);
-    GL.EnableClientState(GL_NORMAL_ARRAY);
-
-    // Activate texture coordinates for all used units
-    for(uint i = 0; i < GL.MaxTextureCoords() ; i++)
-    {
-        if(textureUnits & (1 << i))
-        {
-            GL.ClientActiveTexture( GL_TEXTURE0 + i );
-            GL.EnableClientState(GL_TEXTURE_COORD_ARRAY);
-            GL.TexCoordPointer(3, GL_DOUBLE, sizeof(VertexData), tdata);
-        }
-    }
-
-    GL.DrawArrays(mode, 0, size);
-    GL.DisableClientState(GL_VERTEX_ARRAY);
-    GL.DisableClientState(GL_NORMAL_ARRAY);
-
-    for(uint i = 0; i < GL.MaxTextureCoords() ; i++)
-    {
-        if(textureUnits & (1 << i))
-        {
-            GL.ClientActiveTexture( GL_TEXTURE0 + i );
-            GL.DisableClientState(GL_TEXTURE_COORD_ARRAY);
-        }
-    }
-
-    // Restore the client active texture
-    GL.ClientActiveTexture(GL_TEXTURE0);
+    VertexArray::Vertices &vertices = mesh.sides.vertices;
+    uint first = vertices.size();
+    uint count = strip.size();
+    vertices.reserve(first + count);
+    for (uint i = 0; i < count; i++)
+        vertices.push_back(PackedVertex(strip[i].vertex, strip[i].normal,
+                                        strip[i].texture));
+    mesh.strips.push_back(ExtrusionMesh::Strip(first, count));
 }
 
 
@@ -175,11 +196,11 @@ static inline void extrudeFacet(Vertices &side, VertexData &v,
 #define ROUNDING_EPSILON        0.001
 #define BACKSTEP_VALUE          0.9
 
-static void extrudeSide(Vertices &data, bool invert, uint64 textureUnits,
+static void extrudeSide(Vertices &data, bool invert, ExtrusionMesh &mesh,
                         double r1, double z1, double sa1, double ca1,
                         double r2, double z2, double sa2, double ca2)
 // ----------------------------------------------------------------------------
-//   Extrude a side range
+//   Extrude a side range into the mesh
 // ----------------------------------------------------------------------------
 {
     uint       size = data.size();
@@ -242,13 +263,14 @@ static void extrudeSide(Vertices &data, bool invert, uint64 textureUnits,
         extrudeFacet(side, v, orig, normal, r2, z2, sa2, ca2);
     }
 
-    drawArrays(GL_TRIANGLE_STRIP, textureUnits, side);
+    addStrip(mesh, side);
 }
 
 
-static void extrude(PolygonData &poly, Vertices &data, scale depth)
+static void extrude(PolygonData &poly, Vertices &data, scale depth,
+                    ExtrusionMesh &mesh)
 // ----------------------------------------------------------------------------
-//   Extrude a given set of vertices
+//   Extrude a given set of vertices into the mesh
 // ----------------------------------------------------------------------------
 {
     uint size = data.size();
@@ -256,7 +278,6 @@ static void extrude(PolygonData &poly, Vertices &data, scale depth)
         return;
     
     Layout *layout = poly.layout;
-    uint64 textureUnits = GL.ActiveTextureUnits();
 
     scale radius = layout->extrudeRadius;
     int count = layout->extrudeCount;
@@ -289,23 +310,23 @@ static void extrude(PolygonData &poly, Vertices &data, scale depth)
             double r2 = radius * sa2;
 
             if (sharpEdges)
-                extrudeSide(data, invert, textureUnits,
+                extrudeSide(data, invert, mesh,
                             r1, z1, sa2, ca2, r2, z2, sa2, ca2);
             else
-                extrudeSide(data, invert, textureUnits,
+                extrudeSide(data, invert, mesh,
                             r1, z1, sa1, ca1, r2, z2, sa2, ca2);
             z1 = -depth - z1;
             z2 = -depth - z2;
             if (sharpEdges)
-                extrudeSide(data, invert, textureUnits,
+                extrudeSide(data, invert, mesh,
                             r2, z2, sa2, -ca2, r1, z1, sa2, -ca2);
             else
-                extrudeSide(data, invert, textureUnits,
+                extrudeSide(data, invert, mesh,
                             r2, z2, sa2, -ca2, r1, z1, sa1, -ca1);
         }
 
         if (depth > 2 * radius)
-            extrudeSide(data, invert, textureUnits,
+            extrudeSide(data, invert, mesh,
                         radius, -radius, 1, 0, radius, radius - depth, 1, 0);
     }
     else // Optimized case for 0 radius
@@ -351,83 +372,113 @@ static void extrude(PolygonData &poly, Vertices &data, scale depth)
             side.push_back(v);
         }
 
-        drawArrays(GL_TRIANGLE_STRIP, textureUnits, side);
+        addStrip(mesh, side);
     }
 }
 
 
-static void CALLBACK tessBegin(GLenum mode, PolygonData *poly)
+void ExtrusionMesh::Draw(uint64 textureUnits)
 // ----------------------------------------------------------------------------
-//   Callback for beginning of rendering
+//   Draw all the strips of the extruded sides
 // ----------------------------------------------------------------------------
 {
-    poly->mode = mode;
-    poly->vertices.clear();
+    sides.Enable(textureUnits);
+    for (Strips::iterator s = strips.begin(); s != strips.end(); s++)
+        sides.Render(GL_TRIANGLE_STRIP, (*s).first, (*s).second);
+    sides.Disable(textureUnits);
 }
 
 
-static void CALLBACK tessVertex(VertexData *vertex, PolygonData *poly)
+ExtrusionCache::Cache   ExtrusionCache::cache(ExtrusionCache::MAX_BYTES);
+
+
+ExtrusionMesh *ExtrusionCache::Enter(const PathKey &key, ExtrusionMesh *mesh)
 // ----------------------------------------------------------------------------
-//   Emit a vertex during tesselation
+//   Upload and cache new sides, evicting the least recently used ones
 // ----------------------------------------------------------------------------
 {
-    poly->vertices.push_back(*vertex);
-    VertexData &back = poly->vertices.back();
-    back.normal = Vector3(0, 0, 1);
+    mesh->sides.Upload();
+    return cache.Enter(key, mesh, mesh->sides.Size());
 }
 
 
-static void CALLBACK tessEnd(PolygonData *poly)
+TesselationCache::Cache TesselationCache::cache(TesselationCache::MAX_BYTES);
+
+
+PathTesselation *TesselationCache::Enter(const PathKey &key,
+                                         PathTesselation *tesselated)
 // ----------------------------------------------------------------------------
-//   Callback for end of rendering
+//   Upload and cache new triangles, evicting the least recently used ones
 // ----------------------------------------------------------------------------
 {
-    Vertices &data = poly->vertices;
-    uint size = data.size();
-    if (size)
+    tesselated->mesh.Upload();
+    return cache.Enter(key, tesselated, tesselated->mesh.Size());
+}
+
+
+OutlineCache::Cache     OutlineCache::cache(OutlineCache::MAX_BYTES);
+
+
+PathTesselation *OutlineCache::Enter(const PathKey &key,
+                                     PathTesselation *outline)
+// ----------------------------------------------------------------------------
+//   Upload and cache a new outline, evicting the least recently used ones
+// ----------------------------------------------------------------------------
+{
+    outline->mesh.Upload();
+    return cache.Enter(key, outline, outline->mesh.Size());
+}
+
+
+static void drawTesselated(PolygonData *poly, PathTesselation &tesselated)
+// ----------------------------------------------------------------------------
+//   Draw triangles produced by the tesselator, and their back if extruded
+// ----------------------------------------------------------------------------
+{
+    VertexArray &mesh = tesselated.mesh;
+    if (mesh.indices.empty())
+        return;
+
+    Layout *layout = poly->layout;
+    uint64 textureUnits = GL.ActiveTextureUnits();
+    double depth = layout->extrudeDepth;
+
+    mesh.Enable(textureUnits);
+    if (depth > 0.0)
     {
-        Layout *layout = poly->layout;
-        uint64 textureUnits = GL.ActiveTextureUnits();
-        double depth = layout->extrudeDepth;
-        if (depth > 0.0)
-        {
-            bool invert = poly->path->invert;
-            GL.Sync();
-            // REVISIT: Replace pushMatrix/popMatrix by
-            // GL.Save() (Find why it occurs a bug with outline). Refs #3040.
-            glPushMatrix();
-            glTranslatef(0.0, 0.0, -depth);
-            glScalef(1, 1, -1);
-            GL.FrontFace(invert ? GL_CCW : GL_CW);
-            drawArrays(poly->mode, textureUnits, data);
-            GL.FrontFace(invert ? GL_CW : GL_CCW);
-            glPopMatrix();
-        }
-        drawArrays(poly->mode, textureUnits, data);
-        data.clear();
-     }
+        bool invert = poly->path->invert;
+        GL.Sync();
+        // REVISIT: Replace pushMatrix/popMatrix by
+        // GL.Save() (Find why it occurs a bug with outline). Refs #3040.
+        glPushMatrix();
+        glTranslatef(0.0, 0.0, -depth);
+        glScalef(1, 1, -1);
+        GL.FrontFace(invert ? GL_CCW : GL_CW);
+        mesh.Render(GL_TRIANGLES);
+        GL.FrontFace(invert ? GL_CW : GL_CCW);
+        glPopMatrix();
+    }
+    mesh.Render(GL_TRIANGLES);
+    mesh.Disable(textureUnits);
 }
 
 
-static void CALLBACK tessCombine(GLdouble coords[3],
-                                 VertexData *vertex[4],
-                                 GLfloat weight[4], VertexData **dataOut,
-                                 PolygonData *polygon)
+static void runTesselator(Tesselator &tess, PathTesselation &tesselated)
 // ----------------------------------------------------------------------------
-//   Combine vertex data when the polygon self-intersects
+//   Run the tesselator and pack its output as floats
 // ----------------------------------------------------------------------------
 {
-    Point3 pos(coords[0], coords[1], coords[2]);
-
-    // The documentation states that all pointers are "valid", but valid
-    // seems to mean they can be NULL if we come from SpliceMergeVertices
-    Point3 tex =          weight[0] * vertex[0]->texture;
-    if (vertex[1]) tex += weight[1] * vertex[1]->texture;
-    if (vertex[2]) tex += weight[2] * vertex[2]->texture;
-    if (vertex[3]) tex += weight[3] * vertex[3]->texture;
-    VertexData *result = new VertexData(pos, tex, -1);
-    polygon->allocated.push_back(result);
-    *dataOut = result;
+    Tesselator::Vertices output;
+    VertexArray &mesh = tesselated.mesh;
+    mesh.Clear();
+    tess.Tesselate(output, mesh.indices);
+
+    Vector3 normal(0, 0, 1);
+    uint count = output.size();
+    mesh.vertices.reserve(count);
+    for (uint i = 0; i < count; i++)
+        mesh.vertices.push_back(PackedVertex(output[i].position, normal,
+                                             output[i].texture));
 }
 
 
@@ -440,6 +491,114 @@ void GraphicPath::Draw(Layout *where)
 }
 
 
+uint64 GraphicPath::Hash(uint64 hash, const void *data, uint size)
+// ----------------------------------------------------------------------------
+//   FNV-1a hash of a range of bytes
+// ----------------------------------------------------------------------------
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (uint i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+void PathKey::Add(const void *data, uint size)
+// ----------------------------------------------------------------------------
+//   Add a range of bytes to the inputs and to their hash
+// ----------------------------------------------------------------------------
+{
+    const char *bytes = (const char *) data;
+    hash = GraphicPath::Hash(hash, data, size);
+    inputs.insert(inputs.end(), bytes, bytes + size);
+}
+
+
+scale GraphicPath::DetailScale(Layout *where)
+// ----------------------------------------------------------------------------
+//   Pixels per unit of the path on screen, or 0 to use the path steps only
+// ----------------------------------------------------------------------------
+//   The result is rounded up to a power of two, so that cached tesselations
+//   and meshes are only rebuilt when the size on screen changes a lot.
+{
+    if (lodPixels <= 0 && flatness <= 0)
+        return 0;
+    coord w = bounds.upper.x - bounds.lower.x;
+    coord h = bounds.upper.y - bounds.lower.y;
+    coord d = bounds.upper.z - bounds.lower.z;
+    coord size = std::max(w, std::max(h, d));
+    if (!(size > 0))
+        return 0;
+    scale pixels = ProjectedSize(bounds + where->Offset());
+    if (pixels <= 0)
+        return 0;
+    return exp2(ceil(log2(pixels / size)));
+}
+
+
+PathKey GraphicPath::TesselationKey(const Vector3 &offset, GLenum tessel,
+                                    scale detail)
+// ----------------------------------------------------------------------------
+//   Record everything the output of the tesselator depends on
+// ----------------------------------------------------------------------------
+//   Texture coordinates depend on the bounds, and the number of points
+//   on curves depends on the path steps parameters and level of detail.
+{
+    PathKey key;
+    path_elements::iterator i;
+    for (i = elements.begin(); i != elements.end(); i++)
+    {
+        Element &e = *i;
+        uint kind = e.kind;
+        key.Add(&kind, sizeof(kind));
+        key.Add(&e.position, sizeof(e.position));
+    }
+    key.Add(&offset, sizeof(offset));
+    key.Add(&bounds.lower, sizeof(bounds.lower));
+    key.Add(&bounds.upper, sizeof(bounds.upper));
+    key.Add(&tessel, sizeof(tessel));
+    key.Add(&steps_min, sizeof(steps_min));
+    key.Add(&steps_increase, sizeof(steps_increase));
+    key.Add(&steps_max, sizeof(steps_max));
+    key.Add(&flatness, sizeof(flatness));
+    key.Add(&detail, sizeof(detail));
+    return key;
+}
+
+
+PathKey GraphicPath::ExtrusionKey(Layout *where, const Vector3 &offset,
+                                  scale detail)
+// ----------------------------------------------------------------------------
+//   Record everything the extruded sides depend on
+// ----------------------------------------------------------------------------
+{
+    PathKey key = TesselationKey(offset, GL_DEPTH, detail);
+    key.Add(&where->extrudeDepth, sizeof(where->extrudeDepth));
+    key.Add(&where->extrudeRadius, sizeof(where->extrudeRadius));
+    key.Add(&where->extrudeCount, sizeof(where->extrudeCount));
+    key.Add(&invert, sizeof(invert));
+    return key;
+}
+
+
+PathKey GraphicPath::OutlineKey(Layout *where, scale detail)
+// ----------------------------------------------------------------------------
+//   Record everything the outline of the path depends on
+// ----------------------------------------------------------------------------
+{
+    PathKey key = TesselationKey(where->offset, GLU_TESS_WINDING_POSITIVE,
+                                 detail);
+    key.Add(&where->lineWidth, sizeof(where->lineWidth));
+    key.Add(&lineStyle, sizeof(lineStyle));
+    key.Add(&startStyle, sizeof(startStyle));
+    key.Add(&endStyle, sizeof(endStyle));
+    return key;
+}
+
+
 static scale getShortenByStyle(EndpointStyle style, scale lw)
 // ----------------------------------------------------------------------------
 //   Returns the length to remove from a path for a particular endpoint style
@@ -723,7 +882,7 @@ void GraphicPath::Draw(Layout *where, GLenum tessel)
     GLAllStateKeeper save;
 
     // Sync lighting state only if we have lights or shaders
-    if(GL.LightsMask() || where->programId)
+    if(GL.LightsMask() || where->ProgramId())
         GL.Sync(STATE_lights);
 
     GL.LoadMatrix();
@@ -759,7 +918,21 @@ void GraphicPath::DrawOutline(Layout *where)
 // ----------------------------------------------------------------------------
 //   Draw the outline for the current path
 // ----------------------------------------------------------------------------
+//   Outlines of flat paths that are not extruded are cached, so that the
+//   stroker and the tesselator only run when the path or style change.
 {
+    PathKey key;
+    bool cache = where->extrudeDepth <= 0.0;
+    if (cache)
+    {
+        key = OutlineKey(where, DetailScale(where));
+        if (PathTesselation *cached = OutlineCache::Find(key))
+        {
+            cached->mesh.Draw(GL_TRIANGLES, GL.ActiveTextureUnits());
+            return;
+        }
+    }
+
     GraphicPath outline;
 
     bool first = true;
@@ -930,8 +1103,19 @@ void GraphicPath::DrawOutline(Layout *where)
         if (!last)
             addEndpointToPath(endStyle, endPoint, endHeading, outline);
 
-        outline.Draw(where, where->offset,
-                     GL_POLYGON, GLU_TESS_WINDING_POSITIVE);
+        if (cache)
+        {
+            PathTesselation *built = new PathTesselation;
+            outline.Draw(where, where->offset,
+                         GL_POLYGON, GLU_TESS_WINDING_POSITIVE, built);
+            built = OutlineCache::Enter(key, built);
+            built->mesh.Draw(GL_TRIANGLES, GL.ActiveTextureUnits());
+        }
+        else
+        {
+            outline.Draw(where, where->offset,
+                         GL_POLYGON, GLU_TESS_WINDING_POSITIVE);
+        }
     }
     else
     {
@@ -943,10 +1127,13 @@ void GraphicPath::DrawOutline(Layout *where)
 
 void GraphicPath::Draw(Layout *layout,
                        const Vector3 &offset,
-                       GLenum mode, GLenum tesselation)
+                       GLenum mode, GLenum tesselation,
+                       PathTesselation *record)
 // ----------------------------------------------------------------------------
 //   Draw the graphic path using curves with the given mode and tesselation
 // ----------------------------------------------------------------------------
+//   If 'record' is set, the path is tesselated into it but not drawn.
+//   Paths without a tesselation are then filled with the non-zero rule.
 {
     PolygonData polygon (this);        // Polygon information
     Vertices &data = polygon.vertices;
@@ -956,25 +1143,59 @@ void GraphicPath::Draw(Layout *layout,
     uint textureUnits = GL.ActiveTextureUnits();
     uint vertexIndex = 0;
     scale depth = layout->extrudeDepth;
-
-    // Check if we need to tesselate polygon
-    static GLUtesselator *tess = 0;
-    if (tesselation && tesselation != GL_DEPTH)
+    scale detail = DetailScale(layout);
+
+    // Check if we already tesselated the same path
+    PathTesselation *cached = record;
+    PathTesselation *entering = NULL;
+    PathKey key;
+    if (record && !tesselation)
+        tesselation = GLU_TESS_WINDING_NONZERO;
+    if (!record && tesselation && tesselation != GL_DEPTH)
     {
-        if (!tess)
+        key = TesselationKey(offset, tesselation, detail);
+        cached = TesselationCache::Find(key);
+        if (cached)
         {
-            tess = gluNewTess();
-            typedef void CALLBACK (*fn)();
-            gluTessCallback(tess, GLU_TESS_BEGIN_DATA,   fn(tessBegin));
-            gluTessCallback(tess, GLU_TESS_END_DATA,     fn(tessEnd));
-            gluTessCallback(tess, GLU_TESS_VERTEX_DATA,  fn(tessVertex));
-            gluTessCallback(tess, GLU_TESS_COMBINE_DATA, fn(tessCombine));
+            if (depth <= 0.0)
+            {
+                drawTesselated(&polygon, *cached);
+                return;
+            }
+
+            // Only compute the sides of the extruded path below
+            tesselation = GL_DEPTH;
+        }
+        else
+        {
+            cached = entering = new PathTesselation;
         }
+    }
 
-        gluTessProperty(tess, GLU_TESS_WINDING_RULE, tesselation);
-        gluTessBeginPolygon(tess, &polygon);
+    // Check if we already extruded the same path
+    ExtrusionMesh *extruded = NULL;
+    ExtrusionMesh *extruding = NULL;
+    PathKey extrusionKey;
+    if (depth > 0.0 && !record)
+    {
+        extrusionKey = ExtrusionKey(layout, offset, detail);
+        extruded = ExtrusionCache::Find(extrusionKey);
+        if (extruded && tesselation == GL_DEPTH)
+        {
+            // Nothing left to compute from the path elements
+            extruded->Draw(textureUnits);
+            if (cached)
+                drawTesselated(&polygon, *cached);
+            return;
+        }
+        if (!extruded)
+            extruding = new ExtrusionMesh;
     }
 
+    // Check if we need to tesselate polygon
+    bool tesselate = tesselation && tesselation != GL_DEPTH;
+    Tesselator tess(tesselation);
+
     for (i = begin; i != end; i++)
     {
         Element    &e    = *i;
@@ -1023,10 +1244,9 @@ void GraphicPath::Draw(Layout *layout,
                 Vector3& t1 = control[1].texture;
                 Vector3& t2 = control[2].texture;
 
-                // REVISIT: Implement a true optimization of the interpolation
                 // Compute a good number of points for approximating the curve
                 scale length = (v2-v0).Length() + 1;
-                uint steps = pathSteps(length);
+                uint steps = curveSteps(control, length, detail);
                 double dt = 1.0 / steps;
                 double lt = 1.0 + dt/2;
 
@@ -1061,7 +1281,7 @@ void GraphicPath::Draw(Layout *layout,
 
                 // Compute a good number of points for approximating the curve
                 scale length = (v2-v0).Length() + 1;
-                uint steps = pathSteps(length);
+                uint steps = curveSteps(control, length, detail);
                 double dt = 1.0 / steps;
                 double lt = 1.0 + dt/2;
 
@@ -1104,7 +1324,8 @@ void GraphicPath::Draw(Layout *layout,
                         GL.FrontFace(GL_CCW);
                         GL.Restore(save);
                     }
-                    extrude(polygon, data, depth);
+                    if (extruding)
+                        extrude(polygon, data, depth, *extruding);
                 }
 
                 // Pass the data we had so far to OpenGL and clear it
@@ -1112,14 +1333,9 @@ void GraphicPath::Draw(Layout *layout,
                 {
                     if (tesselation)
                     {
-                        gluTessBeginContour(tess);
+                        tess.BeginContour();
                         for (uint j = 0; j < size; j++)
-                        {
-                            VertexData *dynv = new VertexData(data[j]);
-                            polygon.allocated.push_back(dynv);
-                            gluTessVertex(tess, &dynv->vertex.x, dynv);
-                        }
-                        gluTessEndContour(tess);
+                            tess.Vertex3(data[j].vertex, data[j].texture);
                     }
                     else
                     {
@@ -1136,11 +1352,26 @@ void GraphicPath::Draw(Layout *layout,
 
     } // Loop on all elements
 
+    // Draw the extruded sides, either just computed or from the cache
+    if (extruding)
+        extruded = ExtrusionCache::Enter(extrusionKey, extruding);
+    if (extruded)
+        extruded->Draw(textureUnits);
+
     // End of tesselation
-    if (tesselation && tesselation != GL_DEPTH)
+    PathTesselation tesselated;
+    if (tesselate)
     {
-        gluTessEndPolygon(tess);
+        if (!cached)
+            cached = &tesselated;
+        runTesselator(tess, *cached);
+        if (entering)
+            cached = TesselationCache::Enter(key, entering);
     }
+
+    // Draw the triangles, either just computed or from the cache
+    if (cached && !record)
+        drawTesselated(&polygon, *cached);
 }
 
 
@@ -1472,4 +1703,5 @@ void TesselatedPath::Draw(Layout *where)
     GraphicPath::Draw(where, tesselation);
 }
 
+
 TAO_END
@@ -27,6 +27,8 @@
 #include "tree.h"
 #include "tao_tree.h"
 #include "tao_gl.h"
+#include "vertex_array.h"
+#include "lru_cache.h"
 #include <QPen>
 
 class QPainterPath;
@@ -35,6 +37,30 @@ TAO_BEGIN
 
 struct ControlPoint;
 struct FrameManipulator;
+struct PathTesselation;
+
+
+struct PathKey
+// ----------------------------------------------------------------------------
+//    The inputs a cached path mesh was built from, with their hash
+// ----------------------------------------------------------------------------
+//    Keys are ordered by hash first, so that they are usually compared
+//    without looking at the inputs, but equal keys have equal inputs.
+{
+    PathKey(): hash(14695981039346656037ULL), inputs() {}
+    void                Add(const void *data, uint size);
+    bool operator<(const PathKey &o) const
+    {
+        if (hash != o.hash)
+            return hash < o.hash;
+        return inputs < o.inputs;
+    }
+
+    uint64              hash;           // FNV-1a hash of the inputs
+    std::vector<char>   inputs;         // Bytes of all the inputs
+};
+
+
 struct GraphicPath : Shape
 // ----------------------------------------------------------------------------
 //    An arbitrary graphic path
@@ -51,8 +77,16 @@ struct GraphicPath : Shape
     // Internal drawing routines
     void                Draw(Layout *where, GLenum tessel);
     void                Draw(Layout *where,
-                             const Vector3 &offset, GLenum mode, GLenum tessel);
+                             const Vector3 &offset, GLenum mode, GLenum tessel,
+                             PathTesselation *record = NULL);
     void                DrawOutline(Layout *where);
+    scale               DetailScale(Layout *where);
+    PathKey             TesselationKey(const Vector3 &offset, GLenum tessel,
+                                       scale detail);
+    PathKey             ExtrusionKey(Layout *where, const Vector3 &offset,
+                                     scale detail);
+    PathKey             OutlineKey(Layout *where, scale detail);
+    static uint64       Hash(uint64 hash, const void *data, uint size);
 
     // Absolute coordinates
     GraphicPath&        moveTo(Point3 dst);
@@ -103,17 +137,13 @@ public:
         int         index;
     };
     typedef std::vector<VertexData>   Vertices;
-    typedef std::vector<VertexData *> DynamicVertices;
     struct PolygonData
     {
         PolygonData(GraphicPath *path): path(path) {}
-        ~PolygonData();
 
         Vertices        vertices;
-        DynamicVertices allocated;
         Layout *        layout;
         GraphicPath *   path;
-        GLenum          mode;
     };
 
 public:
@@ -127,6 +157,7 @@ public:
     static scale        steps_min;
     static scale        steps_increase;
     static scale        steps_max;
+    static scale        flatness;       // Max curve error in pixels, 0 if off
 };
 
 
@@ -144,6 +175,96 @@ struct GraphicPathInfo : XL::Info
 };
 
 
+struct PathTesselation
+// ----------------------------------------------------------------------------
+//    The triangles produced by the tesselator for a given path
+// ----------------------------------------------------------------------------
+//    Cached tesselations and outlines are uploaded to buffer objects.
+//    The caches are only collected while drawing, with a current context.
+{
+    VertexArray                 mesh;           // Three indices per triangle
+};
+
+
+struct TesselationCache
+// ----------------------------------------------------------------------------
+//    Triangles of filled paths shared by all widgets, with a memory budget
+// ----------------------------------------------------------------------------
+//    All paths drawn with a tesselation are cached, whether they come from
+//    the path primitive, from shapes or from text. Entries are indexed by
+//    GraphicPath::TesselationKey() and kept in buffer objects.
+{
+    typedef LRUCache<PathKey, PathTesselation> Cache;
+    enum { MAX_BYTES = 16 * 1024 * 1024 };
+
+public:
+    static PathTesselation *Find(const PathKey &key)
+    { return cache.Find(key); }
+    static PathTesselation *Enter(const PathKey &key,
+                                  PathTesselation *tesselated);
+
+public:
+    static Cache        cache;
+};
+
+
+struct ExtrusionMesh
+// ----------------------------------------------------------------------------
+//    The side walls and rounded bevels of an extruded path
+// ----------------------------------------------------------------------------
+{
+    typedef std::pair<uint, uint>       Strip;  // First vertex and count
+    typedef std::vector<Strip>          Strips;
+
+    void                Draw(uint64 textureUnits);
+
+    VertexArray         sides;          // Vertices of all triangle strips
+    Strips              strips;
+};
+
+
+struct ExtrusionCache
+// ----------------------------------------------------------------------------
+//    Extruded sides of paths shared by all widgets, with a memory budget
+// ----------------------------------------------------------------------------
+//    Entries are indexed by GraphicPath::ExtrusionKey(). When they use more
+//    than MAX_BYTES, the least recently used ones are evicted.
+{
+    typedef LRUCache<PathKey, ExtrusionMesh> Cache;
+    enum { MAX_BYTES = 16 * 1024 * 1024 };
+
+public:
+    static ExtrusionMesh *Find(const PathKey &key)
+    { return cache.Find(key); }
+    static ExtrusionMesh *Enter(const PathKey &key, ExtrusionMesh *mesh);
+
+public:
+    static Cache        cache;
+};
+
+
+struct OutlineCache
+// ----------------------------------------------------------------------------
+//    Triangles of the outlines of flat paths, with a memory budget
+// ----------------------------------------------------------------------------
+//    Wide lines, dashes, joins and endpoints are built on the CPU by the
+//    stroker, then tesselated. The result is indexed by
+//    GraphicPath::OutlineKey() and kept in buffer objects.
+{
+    typedef LRUCache<PathKey, PathTesselation> Cache;
+    enum { MAX_BYTES = 16 * 1024 * 1024 };
+
+public:
+    static PathTesselation *Find(const PathKey &key)
+    { return cache.Find(key); }
+    static PathTesselation *Enter(const PathKey &key,
+                                  PathTesselation *outline);
+
+public:
+    static Cache        cache;
+};
+
+
 struct TesselatedPath : GraphicPath
 // ----------------------------------------------------------------------------
 //   Like a graphic path, but with explicit tesselation
@@ -32,6 +32,7 @@
 #include "texture_cache.h"
 #include <QPainterPath>
 #include "lighting.h"
+#include <cmath>
 TAO_BEGIN
 
 // ============================================================================
@@ -60,7 +61,7 @@ bool Shape::setTexture(Layout *where)
 
 
 
-void Shape::enableTexCoord(double *texCoord, uint64 mask)
+void Shape::enableTexCoord(GLfloat *texCoord, uint64 mask)
 // ----------------------------------------------------------------------------
 //    Enable texture coordinates of the specified units
 // ----------------------------------------------------------------------------
@@ -73,7 +74,7 @@ void Shape::enableTexCoord(double *texCoord, uint64 mask)
         {
             GL.ClientActiveTexture(GL_TEXTURE0 + unit);
             GL.EnableClientState(GL_TEXTURE_COORD_ARRAY);
-            GL.TexCoordPointer(2, GL_DOUBLE, 0, texCoord);
+            GL.TexCoordPointer(2, GL_FLOAT, 0, texCoord);
             mask &= ~(1ULL << unit);
         }
         unit++;
@@ -101,6 +102,49 @@ void Shape::disableTexCoord(uint64 mask)
 }
 
 
+scale Shape::lodPixels = 0;
+
+
+scale Shape::ProjectedSize(const Box3 &bounds)
+// ----------------------------------------------------------------------------
+//   Return the size in pixels of the bounds with the current matrices
+// ----------------------------------------------------------------------------
+//   This is the largest side of the screen rectangle around the projected
+//   corners, or -1 if some corners are behind the eye.
+{
+    coord *mv = GL.ModelViewMatrix();
+    coord *pr = GL.ProjectionMatrix();
+    coord m[16];
+    for (uint c = 0; c < 4; c++)
+        for (uint r = 0; r < 4; r++)
+            m[4*c+r] = (pr[0*4+r] * mv[4*c+0] + pr[1*4+r] * mv[4*c+1] +
+                        pr[2*4+r] * mv[4*c+2] + pr[3*4+r] * mv[4*c+3]);
+
+    coord xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        coord x = corner & 1 ? bounds.upper.x : bounds.lower.x;
+        coord y = corner & 2 ? bounds.upper.y : bounds.lower.y;
+        coord z = corner & 4 ? bounds.upper.z : bounds.lower.z;
+        coord w = m[3] * x + m[7] * y + m[11] * z + m[15];
+        if (w <= 0)
+            return -1;
+        coord sx = (m[0] * x + m[4] * y + m[8]  * z + m[12]) / w;
+        coord sy = (m[1] * x + m[5] * y + m[9]  * z + m[13]) / w;
+        if (corner == 0 || sx < xmin) xmin = sx;
+        if (corner == 0 || sx > xmax) xmax = sx;
+        if (corner == 0 || sy < ymin) ymin = sy;
+        if (corner == 0 || sy > ymax) ymax = sy;
+    }
+
+    // Normalized device coordinates span 2 units across the viewport
+    int *viewport = GL.Viewport();
+    scale width = (xmax - xmin) * viewport[2] / 2;
+    scale height = (ymax - ymin) * viewport[3] / 2;
+    return width > height ? width : height;
+}
+
+
 bool Shape::setFillColor(Layout *where)
 // ----------------------------------------------------------------------------
 //    Set the fill color and texture according to the layout attributes
@@ -109,8 +153,9 @@ bool Shape::setFillColor(Layout *where)
     // Check if we have a non-transparent fill color
     if (where)
     {
-        Color &color = where->fillColor;
+        const Color &color = where->FillColor();
         scale v = where->visibility * color.alpha;
+        Layout::TransparencyCheck(v > 0.0 && v < 1.0 && !where->blendOrShade);
         if (v > 0.0)
         {
             bool render =  where->blendOrShade
@@ -138,10 +183,12 @@ bool Shape::setLineColor(Layout *where)
     // Check if we have a non-transparent outline color
     if (where)
     {
-        Color &color = where->lineColor;
+        const Color &color = where->LineColor();
         scale width = where->lineWidth;
         scale v = where->visibility * color.alpha;
-        if (v > 0.0 && (width > 0.0 || where->extrudeDepth > 0.0))
+        bool visible = v > 0.0 && (width > 0.0 || where->extrudeDepth > 0.0);
+        Layout::TransparencyCheck(visible && v < 1.0 && !where->blendOrShade);
+        if (visible)
         {
             bool render =  where->blendOrShade
                 ? !where->transparency
@@ -172,7 +219,7 @@ bool Shape::setShader(Layout *where)
     // we use a shader based ligting (Feature #1508), which needs some
     // uniform values to have an efficient behaviour.
     GLuint programId = PerPixelLighting::PerPixelLightingShader();
-    if (where->perPixelLighting && !where->programId && GL.LightsMask() &&
+    if (where->PerPixelLighting() && !where->ProgramId() && GL.LightsMask() &&
         programId)
     {
         GL.UseProgram(programId);
@@ -199,7 +246,7 @@ bool Shape::setShader(Layout *where)
     else
     {
         // Activate current shader
-        GL.UseProgram(where->programId);
+        GL.UseProgram(where->ProgramId());
     }
 
     return true;
@@ -230,7 +277,42 @@ void Shape2::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where);
+    DrawShape(where, path);
+}
+
+
+void Shape2::DrawShape(Layout *where, GraphicPath &path, GLenum tessel)
+// ----------------------------------------------------------------------------
+//    Draw the path of a shape, using a shared mesh for the fill if possible
+// ----------------------------------------------------------------------------
+//    Extruded shapes and outlines depend on the actual size of the shape,
+//    so they are still drawn from the path.
+{
+    if (!ShapeMesh::enabled || where->extrudeDepth > 0.0 ||
+        where->InIdentify())
+    {
+        path.Draw(where, tessel);
+        return;
+    }
+
+    GLAllStateKeeper save;
+
+    // Sync lighting state only if we have lights or shaders
+    if (GL.LightsMask() || where->ProgramId())
+        GL.Sync(STATE_lights);
+
+    GL.LoadMatrix();
+    setTexture(where);
+
+    if (setFillColor(where))
+    {
+        if (ShapeMesh *mesh = ShapeMesh::Find(where, path, tessel))
+            mesh->Draw(path.bounds, where->offset);
+        else
+            path.Draw(where, where->offset, GL_POLYGON, tessel);
+    }
+    if (setLineColor(where))
+        path.DrawOutline(where);
 }
 
 
@@ -386,7 +468,7 @@ void EllipticalRectangle::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where);
+    DrawShape(where, path);
 }
 
 
@@ -495,7 +577,7 @@ void Arrow::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+    DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
 }
 
 
@@ -551,7 +633,7 @@ void DoubleArrow::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+    DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
 }
 
 
@@ -614,11 +696,11 @@ void StarPolygon::Draw(Layout *where)
     if (q <= 1)
     {
         // Regular polygon, no need to tesselate
-        path.Draw(where);
+        DrawShape(where, path);
     }
     else
     {
-        path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+        DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
     }
 }
 
@@ -710,11 +792,11 @@ void Star::Draw(Layout *where)
     if (r >= 1.0)
     {
         // Regular polygon, no need to tesselate
-        path.Draw(where);
+        DrawShape(where, path);
     }
     else
     {
-        path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+        DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
     }
 }
 
@@ -768,7 +850,7 @@ void SpeechBalloon::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+    DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
 }
 
 
@@ -836,7 +918,7 @@ void Callout::Draw(Layout *where)
 {
     GraphicPath path;
     Draw(path);
-    path.Draw(where, GLU_TESS_WINDING_POSITIVE);
+    DrawShape(where, path, GLU_TESS_WINDING_POSITIVE);
 }
 
 
@@ -1031,6 +1113,197 @@ void FixedSizePoint::Draw(Layout *where)
 }
 
 
+// ============================================================================
+//
+//    Shared meshes for 2D shapes
+//
+// ============================================================================
+
+ShapeMesh::Cache ShapeMesh::cache(~0UL, ShapeMesh::MAX_MESHES);
+bool             ShapeMesh::enabled = true;
+
+
+ShapeMesh::ShapeMesh(Layout *where, GraphicPath &path, GLenum tessel)
+// ----------------------------------------------------------------------------
+//   Tesselate the path and normalize the result to its bounding box
+// ----------------------------------------------------------------------------
+    : vertexBuffer(0), indexBuffer(0), count(0), size(0)
+{
+    PathTesselation tesselated;
+    path.Draw(where, Vector3(0, 0, 0), GL_POLYGON, tessel, &tesselated);
+
+    Box3 &b = path.bounds;
+    coord w = b.upper.x - b.lower.x;
+    coord h = b.upper.y - b.lower.y;
+    VertexArray::Vertices &data = tesselated.mesh.vertices;
+    uint n = data.size();
+    vertices.reserve(2 * n);
+    for (uint i = 0; i < n; i++)
+    {
+        vertices.push_back((data[i].position[0] - b.lower.x) / w);
+        vertices.push_back((data[i].position[1] - b.lower.y) / h);
+    }
+    indices.swap(tesselated.mesh.indices);
+    count = indices.size();
+    size = vertices.size() * sizeof(GLfloat) + count * sizeof(GLuint);
+
+    // Keep the mesh in GPU memory if we can
+    if (count && GL.HasBuffers())
+    {
+        GL.GenBuffers(1, &vertexBuffer);
+        GL.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        GL.BufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+                      &vertices[0], GL_STATIC_DRAW);
+        GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GL.GenBuffers(1, &indexBuffer);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        GL.BufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(GLuint),
+                      &indices[0], GL_STATIC_DRAW);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        VertexArray::uploaded += size;
+
+        std::vector<GLfloat>().swap(vertices);
+        std::vector<GLuint>().swap(indices);
+    }
+}
+
+
+ShapeMesh::~ShapeMesh()
+// ----------------------------------------------------------------------------
+//   Release the buffer objects
+// ----------------------------------------------------------------------------
+{
+    if (vertexBuffer)
+        GL.DeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer)
+        GL.DeleteBuffers(1, &indexBuffer);
+}
+
+
+void ShapeMesh::Draw(const Box3 &bounds, const Vector3 &offset)
+// ----------------------------------------------------------------------------
+//   Draw the mesh scaled to the given bounds
+// ----------------------------------------------------------------------------
+{
+    if (!count)
+        return;
+
+    GraphicSave *save = GL.Save();
+    GL.Translate(bounds.lower.x + offset.x,
+                 bounds.lower.y + offset.y,
+                 bounds.lower.z + offset.z);
+    GL.Scale(bounds.upper.x - bounds.lower.x,
+             bounds.upper.y - bounds.lower.y, 1.0);
+    GL.Normal(0.0, 0.0, 1.0);
+
+    GLfloat *vdata = NULL;
+    GLuint *idata = NULL;
+    if (vertexBuffer)
+    {
+        GL.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    }
+    else
+    {
+        vdata = &vertices[0];
+        idata = &indices[0];
+        VertexArray::Submitted(size);
+    }
+
+    // Vertex coordinates in the unit square are also texture coordinates
+    GL.VertexPointer(2, GL_FLOAT, 0, vdata);
+    GL.EnableClientState(GL_VERTEX_ARRAY);
+    uint64 textureUnits = GL.ActiveTextureUnits();
+    for (uint i = 0; i < GL.MaxTextureCoords(); i++)
+    {
+        if (textureUnits & (1ULL << i))
+        {
+            GL.ClientActiveTexture(GL_TEXTURE0 + i);
+            GL.EnableClientState(GL_TEXTURE_COORD_ARRAY);
+            GL.TexCoordPointer(2, GL_FLOAT, 0, vdata);
+        }
+    }
+
+    GL.DrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, idata);
+
+    GL.DisableClientState(GL_VERTEX_ARRAY);
+    Shape::disableTexCoord(textureUnits);
+    GL.ClientActiveTexture(GL_TEXTURE0);
+    if (vertexBuffer)
+    {
+        GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    GL.Restore(save);
+}
+
+
+ShapeMesh *ShapeMesh::Find(Layout *where, GraphicPath &path, GLenum tessel)
+// ----------------------------------------------------------------------------
+//   Find or create the mesh for the given path
+// ----------------------------------------------------------------------------
+//   The key is computed from the path scaled to the unit square, with
+//   coordinates quantized to 1/65536. Since the number of points on curves
+//   depends on their actual length, the key also includes the size of the
+//   shape, in steps of 1/8 of a power of two, and its level of detail.
+{
+    Box3 &b = path.bounds;
+    coord w = b.upper.x - b.lower.x;
+    coord h = b.upper.y - b.lower.y;
+    if (!(w > 0.0 && h > 0.0) || b.upper.z != b.lower.z)
+        return NULL;
+
+    uint64 key = 14695981039346656037ULL;
+    GraphicPath::path_elements::iterator e;
+    for (e = path.elements.begin(); e != path.elements.end(); e++)
+    {
+        int quantized[3] = {
+            (*e).kind,
+            (int) floor(((*e).position.x - b.lower.x) / w * 65536 + 0.5),
+            (int) floor(((*e).position.y - b.lower.y) / h * 65536 + 0.5)
+        };
+        key = GraphicPath::Hash(key, quantized, sizeof(quantized));
+    }
+    int sizeClass = (int) floor(log2(w > h ? w : h) * 8);
+    key = GraphicPath::Hash(key, &sizeClass, sizeof(sizeClass));
+    key = GraphicPath::Hash(key, &tessel, sizeof(tessel));
+    key = GraphicPath::Hash(key, &GraphicPath::steps_min,
+                            sizeof(GraphicPath::steps_min));
+    key = GraphicPath::Hash(key, &GraphicPath::steps_increase,
+                            sizeof(GraphicPath::steps_increase));
+    key = GraphicPath::Hash(key, &GraphicPath::steps_max,
+                            sizeof(GraphicPath::steps_max));
+    scale detail = path.DetailScale(where);
+    key = GraphicPath::Hash(key, &detail, sizeof(detail));
+
+    if (ShapeMesh *found = cache.Find(key))
+        return found;
+
+    // The cache evicts the least recently used meshes if it gets too big
+    ShapeMesh *mesh = new ShapeMesh(where, path, tessel);
+    return cache.Enter(key, mesh, mesh->size);
+}
+
+
+void ShapeMesh::Clear()
+// ----------------------------------------------------------------------------
+//   Delete all meshes, e.g. when the GL context changes
+// ----------------------------------------------------------------------------
+{
+    cache.Clear();
+}
+
+
+void ShapeMesh::NewFrame()
+// ----------------------------------------------------------------------------
+//   Record the counters for the frame that just ended and restart them
+// ----------------------------------------------------------------------------
+{
+    cache.NewFrame();
+}
+
+
 // ============================================================================
 //
 //    Plane
@@ -1048,16 +1321,19 @@ PlaneMesh::PlaneMesh(int lines, int columns)
     float stepY = 1.0 / columns;
 
     // Compute vertices and textures coordinates
+    Vector3 normal(0, 0, 1);
     for(int j = 0; j <= columns; j++)
     {
         for(int i = 0; i <= lines; i++)
         {
-            vertices.push_back(Vector3(stepX * i - 0.5, stepY * j - 0.5, 0));
-            textures.push_back(Vector((double) i / lines, (double) j / columns));
+            Point3 vertex(stepX * i - 0.5, stepY * j - 0.5, 0);
+            Point3 texture((double) i / lines, (double) j / columns, 0);
+            mesh.vertices.push_back(PackedVertex(vertex, normal, texture));
         }
     }
 
     // Compute indexes
+    VertexArray::Indices &indices = mesh.indices;
     for(int j = 0; j < columns; j++)
     {
         for(int i = 0; i < lines; i++)
@@ -1068,6 +1344,9 @@ PlaneMesh::PlaneMesh(int lines, int columns)
             indices.push_back((j + 1) * (lines + 1) + i);
         }
     }
+
+    // Planes are cached, so keep them in GPU memory if we can
+    mesh.Upload();
 }
 
 Plane::PlaneCache Plane::cache;
@@ -1119,27 +1398,23 @@ void Plane::Draw(PlaneMesh* plane, Layout *where)
     GL.Scale(width, height, 1.0);
     GL.Normal(0., 0., 1.);
 
-    // Set vertex coordinates
-    GL.VertexPointer(3, GL_DOUBLE, 0, &plane->vertices[0].x);
-    GL.EnableClientState(GL_VERTEX_ARRAY);
-
-    enableTexCoord(&plane->textures[0].x, ~0ULL);
+    // Set vertex and texture coordinates, the normal is constant
+    VertexArray &mesh = plane->mesh;
+    mesh.Enable(~0ULL, false);
     setTexture(where);
 
     GLuint size = stacks * slices * 4;
 
     // Set fill color defined in Tao
     if(setFillColor(where))
-        GL.DrawElements(GL_QUADS, size, GL_UNSIGNED_INT, &plane->indices[0]);
+        mesh.Render(GL_QUADS, 0, size);
 
     // Set line color defined in Tao
     if(setLineColor(where))
         for(GLuint i = 0; i < size; i+= 4)
-            GL.DrawElements(GL_LINE_LOOP, 4 , GL_UNSIGNED_INT, &plane->indices[0] + i);
-
-    disableTexCoord(~0ULL);
+            mesh.Render(GL_LINE_LOOP, i, 4);
 
-    GL.DisableClientState(GL_VERTEX_ARRAY);
+    mesh.Disable(~0ULL, false);
 }
 
 TAO_END
@@ -26,7 +26,10 @@
 #include "drawing.h"
 #include "tao_gl.h"
 #include "coords3d.h"
+#include "vertex_array.h"
+#include "lru_cache.h"
 #include <vector>
+#include <map>
 
 TAO_BEGIN
 
@@ -43,12 +46,16 @@ struct Shape : Drawing
 
 public:
     // Shape parameters
-    static void         enableTexCoord(double *texCoord, uint64 mask = ~0UL);
+    static void         enableTexCoord(GLfloat *texCoord, uint64 mask = ~0UL);
     static void         disableTexCoord(uint64 mask);
     static bool         setTexture(Layout *where);
     static bool         setShader(Layout *where);
     static bool         setFillColor(Layout *where);
     static bool         setLineColor(Layout *where);
+
+    // Automatic level of detail
+    static scale        ProjectedSize(const Box3 &bounds);
+    static scale        lodPixels;      // Pixels per subdivision, 0 if off
 };
 
 struct Shape2 : Shape
@@ -61,6 +68,41 @@ struct Shape2 : Shape
     virtual void        Draw(Layout *where);
     virtual void        Identify(Layout *);
     virtual void        Draw(GraphicPath &path);
+    void                DrawShape(Layout *where, GraphicPath &path,
+                                  GLenum tessel = 0);
+};
+
+
+struct ShapeMesh
+// ----------------------------------------------------------------------------
+//   The fill of a 2D shape, normalized to the unit square
+// ----------------------------------------------------------------------------
+//   Shapes that have the same path once scaled to their bounding box share
+//   the same mesh. Vertex coordinates are also the texture coordinates.
+{
+    ShapeMesh(Layout *where, GraphicPath &path, GLenum tessel);
+    ~ShapeMesh();
+
+    void                Draw(const Box3 &bounds, const Vector3 &offset);
+
+    std::vector<GLfloat> vertices;      // x, y in the unit square
+    std::vector<GLuint>  indices;       // Three per triangle
+    GLuint               vertexBuffer;
+    GLuint               indexBuffer;
+    uint                 count;         // Number of indices
+    uint                 size;          // Bytes used by the mesh
+
+public:
+    static ShapeMesh *  Find(Layout *where, GraphicPath &path, GLenum tessel);
+    static void         Clear();
+    static void         NewFrame();
+
+public:
+    enum { MAX_MESHES = 256 };
+    typedef LRUCache<uint64, ShapeMesh> Cache;
+
+    static Cache        cache;
+    static bool         enabled;
 };
 
 
@@ -267,9 +309,7 @@ struct PlaneMesh
 {
     PlaneMesh(int lines, int columns);
 
-    std::vector<Point3> vertices;
-    std::vector<GLuint> indices;
-    std::vector<Point>  textures;
+    VertexArray         mesh;           // Four indices per quad
 };
 
 struct Plane : Shape2
@@ -27,6 +27,10 @@
 #include "tao_gl.h"
 #include "application.h"
 #include "gl_keepers.h"
+#include "tao_utf8.h"
+#include <QGLShaderProgram>
+#include <cstring>
+#include <iostream>
 
 
 TAO_BEGIN
@@ -86,14 +90,14 @@ void Cube::Draw(Layout *where)
 //    Draw the cube within the bounding box
 // ----------------------------------------------------------------------------
 {
-    coord xl = bounds.lower.x;
-    coord yl = bounds.lower.y;
-    coord zl = bounds.lower.z;
-    coord xu = bounds.upper.x;
-    coord yu = bounds.upper.y;
-    coord zu = bounds.upper.z;
-
-    coord vertices[][3] =
+    GLfloat xl = bounds.lower.x;
+    GLfloat yl = bounds.lower.y;
+    GLfloat zl = bounds.lower.z;
+    GLfloat xu = bounds.upper.x;
+    GLfloat yu = bounds.upper.y;
+    GLfloat zu = bounds.upper.z;
+
+    GLfloat vertices[][3] =
     {
         {xl, yl, zl}, {xl, yu, zl}, {xu, yu, zl}, {xu, yl, zl},
         {xl, yl, zu}, {xu, yl, zu}, {xu, yu, zu}, {xl, yu, zu},
@@ -103,7 +107,7 @@ void Cube::Draw(Layout *where)
         {xu, yl, zl}, {xu, yu, zl}, {xu, yu, zu}, {xu, yl, zu}
     };
 
-    static GLdouble textures[][2] = {
+    static GLfloat textures[][2] = {
         {1, 0}, {1, 1}, {0, 1}, {0, 0},
         {0, 0}, {1, 0}, {1, 1}, {0, 1},
         {0, 0}, {1, 0}, {1, 1}, {0, 1},
@@ -125,10 +129,10 @@ void Cube::Draw(Layout *where)
     GLAllStateKeeper save;
 
     GL.EnableClientState(GL_VERTEX_ARRAY);
-    GL.VertexPointer(3, GL_DOUBLE, 0, vertices);
+    GL.VertexPointer(3, GL_FLOAT, 0, vertices);
 
     // Set normals only if we have lights or shaders
-    if(GL.LightsMask() || where->programId)
+    if(GL.LightsMask() || where->ProgramId())
     {
         GL.Sync(STATE_lights);
         GL.EnableClientState(GL_NORMAL_ARRAY);
@@ -142,7 +146,10 @@ void Cube::Draw(Layout *where)
 
     // Draw filled faces
     if (setFillColor(where))
+    {
         GL.DrawArrays(GL_QUADS, 0, 24);
+        VertexArray::Submitted(sizeof(vertices) + sizeof(textures));
+    }
 
     // Draw wireframe
     if (setLineColor(where))
@@ -152,7 +159,7 @@ void Cube::Draw(Layout *where)
     // Disable texture coordinates after drawing
     disableTexCoord(~0ULL);
 
-    if(GL.LightsMask() || where->programId)
+    if(GL.LightsMask() || where->ProgramId())
         GL.DisableClientState(GL_NORMAL_ARRAY);
 
     GL.DisableClientState(GL_VERTEX_ARRAY);
@@ -166,6 +173,85 @@ void Cube::Draw(Layout *where)
 //
 // ============================================================================
 
+struct PackedVertexLess
+// ----------------------------------------------------------------------------
+//   Order packed vertices to find identical ones
+// ----------------------------------------------------------------------------
+{
+    bool operator() (const PackedVertex &a, const PackedVertex &b) const
+    {
+        return memcmp(&a, &b, sizeof(PackedVertex)) < 0;
+    }
+};
+
+
+void Mesh::Pack()
+// ----------------------------------------------------------------------------
+//    Convert the quad strip into indexed triangles stored as floats
+// ----------------------------------------------------------------------------
+//    Adjacent strips repeat the same vertices, which are merged.
+//    Triangles that became degenerate are dropped. The double-precision
+//    data is no longer needed once the mesh is packed.
+{
+    // Meshes built directly as indexed triangles only need to be uploaded
+    if (vertices.empty())
+    {
+        packed.Upload();
+        return;
+    }
+
+    typedef std::map<PackedVertex, GLuint, PackedVertexLess> Welded;
+    Welded welded;
+    VertexArray::Vertices &output = packed.vertices;
+    VertexArray::Indices &indices = packed.indices;
+    VertexArray::Indices strip;
+
+    uint count = vertices.size();
+    strip.reserve(count);
+    for (uint i = 0; i < count; i++)
+    {
+        Point3 texture(textures[i].x, textures[i].y, 0);
+        PackedVertex v(vertices[i], normals[i], texture);
+        Welded::iterator found = welded.find(v);
+        if (found == welded.end())
+        {
+            uint index = output.size();
+            output.push_back(v);
+            welded[v] = index;
+            strip.push_back(index);
+        }
+        else
+        {
+            strip.push_back((*found).second);
+        }
+    }
+
+    // Each quad v0 v1 v3 v2 of a strip gives triangles v0 v1 v2, v2 v1 v3
+    for (uint k = 0; k + 3 < count; k += 2)
+    {
+        if (row && k % row + 3 >= row)
+            continue;           // Quad joining two strips
+        GLuint quad[2][3] = { { strip[k],   strip[k+1], strip[k+2] },
+                              { strip[k+2], strip[k+1], strip[k+3] } };
+        for (uint t = 0; t < 2; t++)
+        {
+            GLuint *tri = quad[t];
+            if (tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0])
+                indices.insert(indices.end(), tri, tri + 3);
+        }
+    }
+    triangles = indices.size();
+
+    // The outline follows the original strips
+    indices.insert(indices.end(), strip.begin(), strip.end());
+
+    std::vector<Point3>().swap(vertices);
+    std::vector<Vector3>().swap(normals);
+    std::vector<Point>().swap(textures);
+    packed.Upload();
+}
+
+
 void MeshBased::Draw(Mesh *mesh, Layout *where)
 // ----------------------------------------------------------------------------
 //    Draw the mesh within the bounding box
@@ -175,21 +261,18 @@ void MeshBased::Draw(Mesh *mesh, Layout *where)
 
     GLAllStateKeeper save;
 
-    // Set Vertices
-    GL.EnableClientState(GL_VERTEX_ARRAY);
-    GL.VertexPointer(3, GL_DOUBLE, 0, &mesh->vertices[0].x);
-
     // Set normals only if we have lights or shaders
-    if(GL.LightsMask() || where->programId)
+    bool normals = GL.LightsMask() || where->ProgramId();
+    if (normals)
     {
         GL.Sync(STATE_lights);
         GL.Enable(GL_NORMALIZE);
-        GL.EnableClientState(GL_NORMAL_ARRAY);
-        GL.NormalPointer(GL_DOUBLE, 0, &mesh->normals[0].x);
     }
 
-    //Active texture coordinates for all used units
-    enableTexCoord(&mesh->textures[0].x, ~0ULL);
+    // Set vertices and texture coordinates for all used units
+    VertexArray &packed = mesh->packed;
+    packed.Enable(~0ULL, normals);
+    MeshCache::vertices += packed.vertices.size();
     GL.Translate(p.x, p.y, p.z);
     GL.Scale(bounds.Width(), bounds.Height(), bounds.Depth());
     GL.LoadMatrix();
@@ -199,22 +282,91 @@ void MeshBased::Draw(Mesh *mesh, Layout *where)
 
     // Optimize drawing of convex shapes in case of no shaders thanks to
     // backface culling (doesn't need to draw back faces)
+    uint triangles = mesh->triangles;
     if (setFillColor(where))
-        GL.DrawArrays(GL_QUAD_STRIP, 0, mesh->textures.size());
+        packed.Render(GL_TRIANGLES, 0, triangles);
     if (setLineColor(where))
-        GL.DrawArrays(GL_LINE_LOOP, 0, mesh->textures.size());
+        packed.Render(GL_LINE_LOOP, triangles,
+                      packed.indices.size() - triangles);
+
+    // Disable arrays
+    packed.Disable(~0ULL, normals);
+    if (normals)
+        GL.Disable(GL_NORMALIZE);
+}
+
+
+
+void MeshBased::LevelOfDetail(Layout *where, uint &slices, uint &stacks)
+// ----------------------------------------------------------------------------
+//    Reduce slices and stacks for shapes that are small on screen
+// ----------------------------------------------------------------------------
+//    The document values are the maximum. Slices are rounded up to a power
+//    of two, and stacks scaled by the same ratio, so that shapes of similar
+//    sizes on screen share the same cached mesh.
+{
+    if (lodPixels <= 0)
+        return;
+    scale pixels = ProjectedSize(bounds + where->Offset());
+    if (pixels < 0)
+        return;
+
+    scale wanted = M_PI * pixels / lodPixels;
+    uint lod = MIN_SLICES;
+    while (lod < wanted && lod < slices)
+        lod *= 2;
+    if (lod >= slices)
+        return;
+
+    stacks = (stacks * lod + slices - 1) / slices;
+    if (stacks < MIN_STACKS)
+        stacks = MIN_STACKS;
+    slices = lod;
+}
+
+
+MeshCache::Cache        MeshCache::cache(MeshCache::MAX_BYTES);
+ulong                   MeshCache::vertices = 0;
+ulong                   MeshCache::lastVertices = 0;
 
-    // Disable texture coordinates
-    disableTexCoord(~0ULL);
 
-    // Disable normals
-    if (GL.LightsMask() || where->programId)
+Mesh *MeshCache::Get(const Key &key)
+// ----------------------------------------------------------------------------
+//    Return the cached mesh for the key, building it if necessary
+// ----------------------------------------------------------------------------
+{
+    Mesh *mesh = cache.Find(key);
+    if (mesh)
+        return mesh;
+
+    switch (key.kind)
     {
-        GL.Disable(GL_NORMALIZE);
-        GL.DisableClientState(GL_NORMAL_ARRAY);
+    case SPHERE:
+        mesh = new SphereMesh(key.slices, key.stacks);
+        break;
+    case TORUS:
+        mesh = new TorusMesh(key.slices, key.stacks, key.ratio);
+        break;
+    case CONE:
+        mesh = new ConeMesh(key.ratio, key.slices);
+        break;
+    case CUBE:
+        mesh = new CubeMesh;
+        break;
     }
+    mesh->Pack();
+    return cache.Enter(key, mesh, mesh->packed.Size());
+}
 
-    GL.DisableClientState(GL_VERTEX_ARRAY);
+
+void MeshCache::NewFrame()
+// ----------------------------------------------------------------------------
+//    Record the statistics for the frame that just ended
+// ----------------------------------------------------------------------------
+{
+    cache.NewFrame();
+    lastVertices = vertices;
+    vertices = 0;
 }
 
 
@@ -231,6 +383,7 @@ SphereMesh::SphereMesh(uint slices, uint stacks)
 // ----------------------------------------------------------------------------
 {
     double radius = 0.5;
+    row = 2 * (slices + 1);
     for (uint j = 0; j < stacks; j++)
     {
         GLfloat phi      = M_PI * j / stacks;
@@ -274,34 +427,15 @@ SphereMesh::SphereMesh(uint slices, uint stacks)
 }
 
 
-Sphere::SphereCache Sphere::cache;
-
 void Sphere::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //    Draw the sphere within the bounding box
 // ----------------------------------------------------------------------------
 {
-    Mesh * mesh = NULL;
-    Key key(slices, stacks);
-    SphereCache::iterator found = cache.find(key);
-    if (found == cache.end())
-    {
-        // Prune the map if it gets too big
-        while (cache.size() > MAX_SPHERES)
-        {
-            SphereCache::iterator first = cache.begin();
-            delete (*first).second;
-            cache.erase(first);
-        }
-        mesh = new SphereMesh(slices, stacks);
-        cache[key] = mesh;
-    }
-    else
-    {
-        mesh = (*found).second;
-    }
-
-    MeshBased::Draw(mesh, where);
+    uint sl = slices, st = stacks;
+    LevelOfDetail(where, sl, st);
+    MeshCache::Key key(MeshCache::SPHERE, sl, st, 0.0);
+    MeshBased::Draw(MeshCache::Get(key), where);
 }
 
 
@@ -320,6 +454,7 @@ TorusMesh::TorusMesh(uint slices, uint stacks, double ratio)
     double minRadius = ratio * 0.25;
     double majRadius = 0.25;
     double thickness = 0.25;
+    row = 2 * (slices + 1);
 
     for (uint j = 0; j < stacks; j++) {
         GLfloat phi      = 2 * M_PI * j / stacks;
@@ -364,34 +499,15 @@ TorusMesh::TorusMesh(uint slices, uint stacks, double ratio)
 }
 
 
-Torus::TorusCache Torus::cache;
-
 void Torus::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //    Draw the torus within the bounding box
 // ----------------------------------------------------------------------------
 {
-    Mesh * mesh = NULL;
-    Key key(slices, stacks, ratio);
-    TorusCache::iterator found = cache.find(key);
-    if (found == cache.end())
-    {
-        // Prune the map if it gets too big
-        while (cache.size() > MAX_TORUS)
-        {
-            TorusCache::iterator first = cache.begin();
-            delete (*first).second;
-            cache.erase(first);
-        }
-        mesh = new TorusMesh(slices, stacks, ratio);
-        cache[key] = mesh;
-    }
-    else
-    {
-        mesh = (*found).second;
-    }
-
-    MeshBased::Draw(mesh, where);
+    uint sl = slices, st = stacks;
+    LevelOfDetail(where, sl, st);
+    MeshCache::Key key(MeshCache::TORUS, sl, st, ratio);
+    MeshBased::Draw(MeshCache::Get(key), where);
 }
 
 
@@ -402,13 +518,14 @@ void Torus::Draw(Layout *where)
 //
 // ============================================================================
 
-ConeMesh::ConeMesh(double ratio)
+ConeMesh::ConeMesh(double ratio, uint slices)
 // ----------------------------------------------------------------------------
 //    Construct a (possibly truncated) unit cone - Limit case is a cylinder
 // ----------------------------------------------------------------------------
 {
-    for (double a = 0; a <= 2 * M_PI; a += M_PI / 30)
+    for (uint i = 0; i <= slices; i++)
     {
+        double a = 2 * M_PI * i / slices;
         double ca = cos(a);
         double sa = sin(a);
 
@@ -454,34 +571,412 @@ ConeMesh::ConeMesh(double ratio)
 }
 
 
-Cone::ConeCache Cone::cache;
-
 void Cone::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //    Draw the cone within the bounding box
 // ----------------------------------------------------------------------------
 {
-    Mesh * mesh = NULL;
-    Key key(ratio);
-    ConeCache::iterator found = cache.find(key);
-    if (found == cache.end())
+    uint sl = ConeMesh::CONE_SLICES, st = 1;
+    LevelOfDetail(where, sl, st);
+    MeshCache::Key key(MeshCache::CONE, sl, 0, ratio);
+    MeshBased::Draw(MeshCache::Get(key), where);
+}
+
+
+
+// ============================================================================
+//
+//    Cube mesh
+//
+// ============================================================================
+
+CubeMesh::CubeMesh()
+// ----------------------------------------------------------------------------
+//    Construct a unit cube directly as packed triangles
+// ----------------------------------------------------------------------------
+//    Faces do not share vertices, since their normals differ.
+{
+    static const GLfloat corners[][3] =
+    {
+        {-1, -1, -1}, {-1,  1, -1}, { 1,  1, -1}, { 1, -1, -1},
+        {-1, -1,  1}, { 1, -1,  1}, { 1,  1,  1}, {-1,  1,  1},
+        {-1, -1, -1}, { 1, -1, -1}, { 1, -1,  1}, {-1, -1,  1},
+        {-1,  1, -1}, {-1,  1,  1}, { 1,  1,  1}, { 1,  1, -1},
+        {-1,  1, -1}, {-1, -1, -1}, {-1, -1,  1}, {-1,  1,  1},
+        { 1, -1, -1}, { 1,  1, -1}, { 1,  1,  1}, { 1, -1,  1}
+    };
+    static const GLfloat faceTextures[][2] =
+    {
+        {1, 0}, {1, 1}, {0, 1}, {0, 0},
+        {0, 0}, {1, 0}, {1, 1}, {0, 1},
+        {0, 0}, {1, 0}, {1, 1}, {0, 1},
+        {0, 1}, {0, 0}, {1, 0}, {1, 1},
+        {0, 1}, {0, 0}, {1, 0}, {1, 1},
+        {1, 0}, {1, 1}, {0, 1}, {0, 0}
+    };
+    static const GLfloat faceNormals[][3] =
+    {
+        { 0,  0, -1}, { 0,  0,  1}, { 0, -1,  0},
+        { 0,  1,  0}, {-1,  0,  0}, { 1,  0,  0}
+    };
+
+    VertexArray::Vertices &output = packed.vertices;
+    VertexArray::Indices &indices = packed.indices;
+    for (uint i = 0; i < 24; i++)
+    {
+        const GLfloat *c = corners[i];
+        const GLfloat *n = faceNormals[i / 4];
+        const GLfloat *t = faceTextures[i];
+        output.push_back(PackedVertex(Point3(c[0]/2, c[1]/2, c[2]/2),
+                                      Vector3(n[0], n[1], n[2]),
+                                      Point3(t[0], t[1], 0)));
+    }
+
+    // Each face v0 v1 v2 v3 gives triangles v0 v1 v2, v0 v2 v3
+    for (uint face = 0; face < 6; face++)
     {
-        // Prune the map if it gets too big
-        while (cache.size() > MAX_CONES)
+        GLuint k = 4 * face;
+        GLuint quad[6] = { k, k+1, k+2, k, k+2, k+3 };
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+    triangles = indices.size();
+
+    // One outline loop per face, following the vertices in order
+    for (GLuint i = 0; i < 24; i++)
+        indices.push_back(i);
+    outline = 4;
+}
+
+
+
+// ============================================================================
+//
+//    Instanced shapes
+//
+// ============================================================================
+
+Instances::Buffers Instances::buffers;
+bool Instances::buffersChanged = false;
+QGLShaderProgram *Instances::program = NULL;
+bool Instances::programFailed = false;
+
+
+const Instances::Data &Instances::Values()
+// ----------------------------------------------------------------------------
+//    Return the values from the document or from the module buffer
+// ----------------------------------------------------------------------------
+{
+    if (buffer.empty())
+        return data;
+    Buffers::iterator found = buffers.find(buffer);
+    if (found == buffers.end())
+        return data;            // Empty until the module fills the buffer
+    return (*found).second;
+}
+
+
+Box3 Instances::Bounds(Layout *where)
+// ----------------------------------------------------------------------------
+//    Return the box enclosing all instances
+// ----------------------------------------------------------------------------
+{
+    const Data &values = Values();
+    uint count = values.size() / STRIDE;
+    Box3 result;
+    for (uint i = 0; i < count; i++)
+    {
+        const GLfloat *v = &values[i * STRIDE];
+        result |= Box3(v[0] - v[3]/2, v[1] - v[4]/2, v[2] - v[5]/2,
+                       v[3], v[4], v[5]);
+    }
+    if (count)
+        result += where->Offset();
+    return result;
+}
+
+
+static bool setInstanceColor(Layout *where, const GLfloat *color)
+// ----------------------------------------------------------------------------
+//    Set the fill color of one instance, like Shape::setFillColor
+// ----------------------------------------------------------------------------
+//    Only the color and polygon offset are sent, since the rest of the
+//    state is the same for all instances and was synced before the first.
+{
+    scale v = where->visibility * color[3];
+    Layout::TransparencyCheck(v > 0.0 && v < 1.0 && !where->blendOrShade);
+    if (v > 0.0)
+    {
+        bool render =  where->blendOrShade
+            ? !where->transparency
+            : where->transparency == (v < 1.0);
+        if (render)
         {
-            ConeCache::iterator first = cache.begin();
-            delete (*first).second;
-            cache.erase(first);
+            GL.Color(color[0], color[1], color[2], v);
+            where->PolygonOffset(true);
+            GL.Sync(STATE_color | STATE_polygonOffset);
+            return true;
         }
-        mesh = new ConeMesh(ratio);
-        cache[key] = mesh;
     }
-    else
+    where->PolygonOffset(false);
+    return false;
+}
+
+
+static bool setInstanceLineColor(Layout *where)
+// ----------------------------------------------------------------------------
+//    Set the outline color of one instance, like Shape::setLineColor
+// ----------------------------------------------------------------------------
+{
+    const Color &color = where->LineColor();
+    scale width = where->lineWidth;
+    scale v = where->visibility * color.alpha;
+    bool visible = v > 0.0 && (width > 0.0 || where->extrudeDepth > 0.0);
+    Layout::TransparencyCheck(visible && v < 1.0 && !where->blendOrShade);
+    if (visible)
+    {
+        bool render =  where->blendOrShade
+            ? !where->transparency
+            : where->transparency == (v < 1.0);
+        if (render)
+        {
+            GL.Color(color.red, color.green, color.blue, v);
+            where->PolygonOffset(true);
+            GL.Sync(STATE_color | STATE_polygonOffset);
+            return true;
+        }
+    }
+    where->PolygonOffset(false);
+    return false;
+}
+
+
+void Instances::Draw(Layout *where)
+// ----------------------------------------------------------------------------
+//    Draw all instances with the same mesh arrays
+// ----------------------------------------------------------------------------
+//    Without instanced arrays, or with lights, textures or a document
+//    shader, we issue one indexed draw per instance. The mesh stays in
+//    buffer objects, so each draw only sends a matrix and a color.
+{
+    const Data &values = Values();
+    uint count = values.size() / STRIDE;
+    if (!count)
+        return;
+
+    Mesh *mesh = MeshCache::Get(key);
+    VertexArray &packed = mesh->packed;
+    uint triangles = mesh->triangles;
+    uint lines = packed.indices.size() - triangles;
+    uint loop = mesh->outline ? mesh->outline : lines;
+    Point3 offset = where->Offset();
+
+    GLAllStateKeeper save;
+
+    // Set normals only if we have lights or shaders
+    bool normals = GL.LightsMask() || where->ProgramId();
+    if (normals)
+    {
+        GL.Sync(STATE_lights);
+        GL.Enable(GL_NORMALIZE);
+    }
+
+    packed.Enable(~0ULL, normals);
+    setTexture(where);
+    enableCulling(where);
+
+    if (normals || GL.ActiveTextureUnits() || !DrawInstanced(where, mesh))
     {
-        mesh = (*found).second;
+        GL.Sync();
+        for (uint i = 0; i < count; i++)
+        {
+            const GLfloat *v = &values[i * STRIDE];
+            GLMatrixKeeper saveMatrix;
+            GL.Translate(v[0] + offset.x, v[1] + offset.y, v[2] + offset.z);
+            GL.Scale(v[3], v[4], v[5]);
+            GL.LoadMatrix();
+
+            where->ClearPolygonOffset();
+            if (setInstanceColor(where, v + 6))
+                packed.Render(GL_TRIANGLES, 0, triangles);
+            if (loop && setInstanceLineColor(where))
+                for (uint l = 0; l + loop <= lines; l += loop)
+                    packed.Render(GL_LINE_LOOP, triangles + l, loop);
+        }
     }
+    MeshCache::vertices += count * packed.vertices.size();
+
+    packed.Disable(~0ULL, normals);
+    if (normals)
+        GL.Disable(GL_NORMALIZE);
+}
+
+
+bool Instances::DrawInstanced(Layout *where, Mesh *mesh)
+// ----------------------------------------------------------------------------
+//    Draw all instances with one call per primitive, false if not possible
+// ----------------------------------------------------------------------------
+//    The instance values are given to the shader as instanced arrays, and
+//    the shader discards the instances that do not belong to this pass.
+{
+    uint prg = Program();
+    if (!prg)
+        return false;
+
+    const Data &values = Values();
+    uint count = values.size() / STRIDE;
+    VertexArray &packed = mesh->packed;
+    uint triangles = mesh->triangles;
+    uint lines = packed.indices.size() - triangles;
+    uint loop = mesh->outline ? mesh->outline : lines;
+    Point3 offset = where->Offset();
+
+    // Same pass selection as setInstanceColor, for all instances at once
+    enum { PASS_OPAQUE, PASS_TRANSPARENT, PASS_ALL, PASS_OUTLINE };
+    int pass = where->blendOrShade ? PASS_ALL
+        : where->transparency ? PASS_TRANSPARENT : PASS_OPAQUE;
+    bool transparent = false;
+    bool filled = false;
+    for (uint i = 0; i < count; i++)
+    {
+        scale v = where->visibility * values[i * STRIDE + 9];
+        if (v > 0.0)
+        {
+            transparent |= v < 1.0;
+            filled |= where->blendOrShade
+                ? !where->transparency
+                : where->transparency == (v < 1.0);
+        }
+    }
+    Layout::TransparencyCheck(transparent && !where->blendOrShade);
+
+    // Instance center, size and color, from client memory
+    static const char *names[3] = { "center", "size", "tint" };
+    static const uint sizes[3] = { 3, 3, 4 };
+    GLint attribs[3];
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    for (uint a = 0; a < 3; a++)
+    {
+        attribs[a] = GL.GetAttribLocation(prg, names[a]);
+        if (attribs[a] < 0)
+            continue;
+        glEnableVertexAttribArray(attribs[a]);
+        glVertexAttribPointer(attribs[a], sizes[a], GL_FLOAT, GL_FALSE,
+                              STRIDE * sizeof(GLfloat), &values[3 * a]);
+        glVertexAttribDivisorARB(attribs[a], 1);
+    }
+    VertexArray::Submitted(values.size() * sizeof(GLfloat));
+
+    GL.UseProgram(prg);
+    GL.Uniform(GL.GetUniformLocation(prg, "offset"),
+               (float) offset.x, (float) offset.y, (float) offset.z);
+    GL.Uniform(GL.GetUniformLocation(prg, "visibility"),
+               (float) where->visibility);
+    GL.LoadMatrix();
+
+    where->ClearPolygonOffset();
+    where->PolygonOffset(filled);
+    if (filled)
+    {
+        GL.Uniform(GL.GetUniformLocation(prg, "pass"), pass);
+        packed.Render(GL_TRIANGLES, 0, triangles, count);
+    }
+    if (loop && setInstanceLineColor(where))
+    {
+        const Color &lc = where->LineColor();
+        GL.Uniform(GL.GetUniformLocation(prg, "pass"), (int) PASS_OUTLINE);
+        GL.Uniform(GL.GetUniformLocation(prg, "lineColor"),
+                   (float) lc.red, (float) lc.green, (float) lc.blue,
+                   (float) (lc.alpha * where->visibility));
+        for (uint l = 0; l + loop <= lines; l += loop)
+            packed.Render(GL_LINE_LOOP, triangles + l, loop, count);
+    }
+
+    for (uint a = 0; a < 3; a++)
+    {
+        if (attribs[a] < 0)
+            continue;
+        glVertexAttribDivisorARB(attribs[a], 0);
+        glDisableVertexAttribArray(attribs[a]);
+    }
+    GL.UseProgram(where->ProgramId());
+    return true;
+}
+
+
+uint Instances::Program()
+// ----------------------------------------------------------------------------
+//    Return the shader drawing instances, 0 if not available
+// ----------------------------------------------------------------------------
+{
+    if (!program && !programFailed)
+    {
+        if (!Widget::isGLExtensionAvailable("GL_ARB_instanced_arrays") ||
+            !Widget::isGLExtensionAvailable("GL_ARB_draw_instanced"))
+        {
+            programFailed = true;
+            return 0;
+        }
+
+        program = new QGLShaderProgram();
+        QString path = Application::applicationDirPath();
+        QString vs = path + "/instances.vs";
+        QString fs = path + "/instances.fs";
+
+        bool ok = false;
+        if (program->addShaderFromSourceFile(QGLShader::Vertex, vs))
+        {
+            if (program->addShaderFromSourceFile(QGLShader::Fragment, fs))
+                ok = program->link();
+            else
+                std::cerr << "Error loading shader code: " << +fs << "\n";
+        }
+        else
+        {
+            std::cerr << "Error loading shader code: " << +vs << "\n";
+        }
+        if (!ok)
+        {
+            std::cerr << +program->log();
+            delete program;
+            program = NULL;
+            programFailed = true;
+        }
+    }
+    return program ? program->programId() : 0;
+}
+
+
+void Instances::ContextChanged()
+// ----------------------------------------------------------------------------
+//    Forget the instancing shader, which belongs to the old GL context
+// ----------------------------------------------------------------------------
+{
+    delete program;
+    program = NULL;
+    programFailed = false;
+}
+
+
+bool Instances::SetBuffer(text name, const float *values, uint count)
+// ----------------------------------------------------------------------------
+//    Module interface to set the values of a named instance buffer
+// ----------------------------------------------------------------------------
+//    A null pointer removes the buffer. Values set outside of the evaluation
+//    of the document schedule a redraw, which must not be skipped even if
+//    no layout changed.
+{
+    if (values && count % STRIDE)
+        return false;
+    if (!values)
+        buffers.erase(name);
+    else
+        buffers[name].assign(values, values + count);
 
-    MeshBased::Draw(mesh, where);
+    buffersChanged = true;
+    if (!Widget::TaoExists())
+        if (Widget *widget = Widget::findTaoWidget())
+            widget->update();
+    return true;
 }
 
 TAO_END
@@ -23,6 +23,10 @@
 // ****************************************************************************
 
 #include "shapes.h"
+#include "lru_cache.h"
+#include <map>
+
+class QGLShaderProgram;
 
 TAO_BEGIN
 
@@ -57,10 +61,63 @@ struct Mesh
 // ----------------------------------------------------------------------------
 //   Generic mesh data
 // ----------------------------------------------------------------------------
+//   Meshes are built as quad strips of 'row' vertices, then packed as
+//   indexed triangles, followed by the indices of the whole sequence of
+//   strips used to draw the outline.
 {
+    Mesh(): row(0), triangles(0), outline(0) {}
+
+    void                 Pack();
+
     std::vector<Point3>  vertices;
     std::vector<Vector3> normals;
     std::vector<Point>   textures;
+    VertexArray          packed;        // Interleaved floats used to draw
+    uint                 row;           // Vertices per strip, 0 if only one
+    uint                 triangles;     // Number of indices for triangles
+    uint                 outline;       // Indices per outline loop, 0 if one
+};
+
+
+struct MeshCache
+// ----------------------------------------------------------------------------
+//   Meshes shared by all mesh-based shapes, with a memory budget
+// ----------------------------------------------------------------------------
+//   When the packed meshes use more than MAX_BYTES, the least recently
+//   used ones are evicted. The cache is shared by all widgets, since the
+//   meshes rebuild their buffer objects when the GL context changes.
+{
+    enum Kind { SPHERE, TORUS, CONE, CUBE };
+    enum { MAX_BYTES = 16 * 1024 * 1024 };
+
+    struct Key
+    {
+        Key(Kind kind, uint slices, uint stacks, double ratio)
+            : kind(kind), slices(slices), stacks(stacks), ratio(ratio) {}
+        Kind   kind;
+        uint   slices, stacks;
+        double ratio;
+
+        bool operator<(const Key &o) const
+        {
+            if (kind != o.kind)
+                return kind < o.kind;
+            if (slices != o.slices)
+                return slices < o.slices;
+            if (stacks != o.stacks)
+                return stacks < o.stacks;
+            return ratio < o.ratio;
+        }
+    };
+    typedef LRUCache<Key, Mesh>         Cache;
+
+public:
+    static Mesh *       Get(const Key &key);
+    static void         NewFrame();
+
+public:
+    static Cache        cache;
+    static ulong        vertices, lastVertices;
 };
 
 
@@ -87,7 +144,17 @@ struct ConeMesh : Mesh
 //   A unit-radius sphere, represented as a mesh
 // ----------------------------------------------------------------------------
 {
-    ConeMesh(double r);
+    ConeMesh(double r, uint slices = CONE_SLICES);
+    enum { CONE_SLICES = 60 };
+};
+
+
+struct CubeMesh : Mesh
+// ----------------------------------------------------------------------------
+//   A unit cube, with one outline loop per face
+// ----------------------------------------------------------------------------
+{
+    CubeMesh();
 };
 
 
@@ -100,6 +167,9 @@ struct MeshBased : Cube
         : Cube(bounds), culling(culling) {}
     void Draw(Layout *where) { Cube::Draw(where); }
     void Draw(Mesh *mesh, Layout *where);
+    void LevelOfDetail(Layout *where, uint &slices, uint &stacks);
+
+    enum { MIN_SLICES = 4, MIN_STACKS = 2 };
 
     // Define if mesh needs backface culling
     bool culling;
@@ -117,16 +187,6 @@ struct Sphere : MeshBased
 
 private:
     uint    slices, stacks;
-
-private:
-    // Cache of unit radius spheres
-    // (they differ by the number of subdivisions onhy)
-
-    enum { MAX_SPHERES = 10 };
-    typedef std::pair<uint, uint> Key;
-    typedef std::map<Key, Mesh *> SphereCache;
-
-    static SphereCache cache;
 };
 
 
@@ -142,33 +202,6 @@ struct Torus : MeshBased
 private:
     uint    slices, stacks;
     double  ratio;
-
-private:
-    // Cache of unit radius torus
-    // (they differ by the number of subdivisions and their ratio)
-
-    struct Key
-    {
-        Key(uint slices, uint stacks, double ratio)
-            : slices(slices), stacks(stacks), ratio(ratio) {}
-        uint slices, stacks;
-        double ratio;
-
-        bool operator==(const Key &o) const
-        {
-            return slices == o.slices && stacks == o.stacks && ratio == o.ratio;
-        }
-
-        bool operator<(const Key &o) const
-        {
-            return slices < o.slices || stacks < o.stacks || ratio < o.ratio;
-        }
-    };
-
-    typedef std::map<Key, Mesh *> TorusCache;
-
-    enum { MAX_TORUS = 10 };
-    static TorusCache cache;
 };
 
 
@@ -183,16 +216,42 @@ struct Cone : MeshBased
 
 private:
     double  ratio;
+};
 
-private:
-    // Cache of unit radius cones
-    // (they differ by their ratio onhy)
 
-    enum { MAX_CONES = 10 };
-    typedef double Key;
-    typedef std::map<Key, Mesh *> ConeCache;
+struct Instances : Shape3
+// ----------------------------------------------------------------------------
+//   Draw many copies of a cached mesh, each with its own box and color
+// ----------------------------------------------------------------------------
+//   Each instance is described by STRIDE floats: x, y, z, w, h, d, r, g, b, a.
+//   The values come either from the document, or from a named buffer
+//   filled by a module. One shape and one state save are used for all
+//   instances, and the mesh arrays are only setup once. When the GL
+//   supports instanced arrays, a built-in shader draws all instances at once.
+{
+    typedef std::vector<GLfloat>        Data;
+    typedef std::map<text, Data>        Buffers;
+    enum { STRIDE = 10 };
 
-    static ConeCache cache;
+    Instances(const MeshCache::Key &key): Shape3(), key(key) {}
+    virtual void        Draw(Layout *where);
+    virtual Box3        Bounds(Layout *where);
+    const Data &        Values();
+    bool                DrawInstanced(Layout *where, Mesh *mesh);
+
+    static bool         SetBuffer(text name, const float *data, uint count);
+    static uint         Program();
+    static void         ContextChanged();
+
+public:
+    MeshCache::Key      key;
+    Data                data;           // Values given in the document
+    text                buffer;         // Name of module buffer if not empty
+
+    static Buffers      buffers;
+    static bool         buffersChanged; // Set by modules since last frame
+    static QGLShaderProgram *program;
+    static bool         programFailed;
 };
 
 
@@ -22,6 +22,7 @@
 
 #include "space_layout.h"
 #include "attributes.h"
+#include <list>
 
 TAO_BEGIN
 
@@ -44,6 +45,9 @@ SpaceLayout::~SpaceLayout()
 {
     IFTRACE(justify)
         std::cerr << "<->SpaceLayout::~SpaceLayout "<<this << std::endl;
+
+    // Drop children while the refresh index still exists
+    Clear();
 }
 
 
@@ -57,4 +61,367 @@ Box3 SpaceLayout::Space(Layout *layout)
     return result;
 }
 
+
+
+// ============================================================================
+//
+//    Refresh index
+//
+// ============================================================================
+
+void RefreshIndex::Subscribe(Layout *layout, int type)
+// ----------------------------------------------------------------------------
+//   Record that the layout must be refreshed on the given event type
+// ----------------------------------------------------------------------------
+{
+    if (type != QEvent::Timer)
+        events[type].insert(layout);
+    Changed(layout);
+}
+
+
+void RefreshIndex::Unsubscribe(Layout *layout, int type)
+// ----------------------------------------------------------------------------
+//   Remove the layout from the subscribers for the given event type
+// ----------------------------------------------------------------------------
+{
+    EventMap::iterator found = events.find(type);
+    if (found != events.end())
+    {
+        LayoutSet &layouts = (*found).second;
+        layouts.erase(layout);
+        if (layouts.empty())
+            events.erase(found);
+    }
+    Changed(layout);
+}
+
+
+void RefreshIndex::Schedule(Layout *layout, double from, double to)
+// ----------------------------------------------------------------------------
+//   Move the refresh deadline of a layout, DBL_MAX meaning none
+// ----------------------------------------------------------------------------
+{
+    if (from != DBL_MAX)
+        deadlines.erase(Deadline(from, layout));
+    if (to != DBL_MAX)
+        deadlines.insert(Deadline(to, layout));
+    Changed(layout);
+}
+
+
+void RefreshIndex::Remove(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Remove all subscriptions of the given layout
+// ----------------------------------------------------------------------------
+{
+    LayoutState::qevent_ids &ids = layout->refreshEvents;
+    for (LayoutState::qevent_ids::iterator i = ids.begin(); i != ids.end(); i++)
+        Unsubscribe(layout, *i);
+    Schedule(layout, layout->nextRefresh, DBL_MAX);
+}
+
+
+void RefreshIndex::Insert(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Add all the current subscriptions of the given layout
+// ----------------------------------------------------------------------------
+{
+    LayoutState::qevent_ids &ids = layout->refreshEvents;
+    for (LayoutState::qevent_ids::iterator i = ids.begin(); i != ids.end(); i++)
+        Subscribe(layout, *i);
+    Schedule(layout, DBL_MAX, layout->nextRefresh);
+}
+
+
+bool RefreshIndex::Subscribed(int type)
+// ----------------------------------------------------------------------------
+//   Check if any layout is interested in the given event type
+// ----------------------------------------------------------------------------
+{
+    if (type == QEvent::Timer)
+        return !deadlines.empty();
+    return events.count(type) != 0;
+}
+
+
+LayoutState::qevent_ids RefreshIndex::Events()
+// ----------------------------------------------------------------------------
+//   Return all the event types the tree subscribed to
+// ----------------------------------------------------------------------------
+{
+    LayoutState::qevent_ids result;
+    for (EventMap::iterator e = events.begin(); e != events.end(); e++)
+        result.insert((*e).first);
+    if (!deadlines.empty())
+        result.insert(QEvent::Timer);
+    return result;
+}
+
+
+double RefreshIndex::NextRefresh()
+// ----------------------------------------------------------------------------
+//   Return the earliest refresh deadline in the tree
+// ----------------------------------------------------------------------------
+{
+    if (deadlines.empty())
+        return DBL_MAX;
+    return (*deadlines.begin()).first;
+}
+
+
+void RefreshIndex::Targets(QEvent *event, double now, Layouts &out)
+// ----------------------------------------------------------------------------
+//   Return the layouts that need a refresh for this event, in tree order
+// ----------------------------------------------------------------------------
+//   A layout is dropped if one of its ancestors is also refreshed, since
+//   re-evaluating the ancestor will delete and re-create it. The others
+//   are returned in the order a walk of the whole tree would visit them,
+//   not in the order of their addresses, so that sibling layouts are
+//   always re-evaluated in the same order.
+{
+    LayoutSet candidates;
+    int type = event->type();
+    if (type != QEvent::Timer)
+    {
+        EventMap::iterator found = events.find(type);
+        if (found != events.end())
+            candidates = (*found).second;
+    }
+
+    // An expired deadline triggers a refresh whatever the event
+    for (Deadlines::iterator d = deadlines.begin();
+         d != deadlines.end() && (*d).first <= now;
+         d++)
+        candidates.insert((*d).second);
+
+    LayoutSet selected, onPath;
+    Layout *root = NULL;
+    for (LayoutSet::iterator c = candidates.begin(); c != candidates.end(); c++)
+    {
+        bool nested = false;
+        for (Layout *p = (*c)->Parent(); p && !nested; p = p->Parent())
+            nested = candidates.count(p) != 0;
+        if (nested)
+            continue;
+
+        // Record the layouts on the path from the root to the target
+        selected.insert(*c);
+        for (Layout *p = *c; p; p = p->Parent())
+        {
+            if (!onPath.insert(p).second)
+                break;
+            if (!p->Parent())
+                root = p;
+        }
+    }
+    if (root)
+        InTreeOrder(root, selected, onPath, out);
+
+    // Targets that their parent does not list as children come last
+    if (out.size() < selected.size())
+    {
+        LayoutSet found(out.begin(), out.end());
+        for (LayoutSet::iterator s = selected.begin(); s!=selected.end(); s++)
+            if (!found.count(*s))
+                out.push_back(*s);
+    }
+}
+
+
+void RefreshIndex::InTreeOrder(Layout *layout,
+                               LayoutSet &selected, LayoutSet &onPath,
+                               Layouts &out)
+// ----------------------------------------------------------------------------
+//   Walk the paths leading to selected layouts and add them in visit order
+// ----------------------------------------------------------------------------
+{
+    if (selected.count(layout))
+    {
+        out.push_back(layout);
+        return;
+    }
+
+    Layouts children;
+    layout->ChildLayouts(children);
+    for (Layouts::iterator c = children.begin(); c != children.end(); c++)
+        if (onPath.count(*c))
+            InTreeOrder(*c, selected, onPath, out);
+}
+
+
+
+// ============================================================================
+//
+//    Refresh dependencies
+//
+// ============================================================================
+
+void RefreshIndex::AddName(Layout *layout, text name)
+// ----------------------------------------------------------------------------
+//   Record a new name for a layout
+// ----------------------------------------------------------------------------
+{
+    named[name].insert(layout);
+    dirtyNames.insert(name);
+}
+
+
+void RefreshIndex::AddDep(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Record that the layout got a new refresh_also dependency
+// ----------------------------------------------------------------------------
+{
+    withDeps.insert(layout);
+    newDeps.insert(layout);
+}
+
+
+void RefreshIndex::Register(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Add the names and dependencies of a layout to the graph
+// ----------------------------------------------------------------------------
+{
+    LayoutNames &names = layout->names;
+    for (LayoutNames::iterator n = names.begin(); n != names.end(); n++)
+        AddName(layout, *n);
+    if (layout->deps.size())
+        AddDep(layout);
+}
+
+
+void RefreshIndex::Forget(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Remove a layout from the dependency graph
+// ----------------------------------------------------------------------------
+{
+    LayoutNames &names = layout->names;
+    for (LayoutNames::iterator n = names.begin(); n != names.end(); n++)
+    {
+        NameMap::iterator found = named.find(*n);
+        if (found != named.end())
+        {
+            LayoutSet &layouts = (*found).second;
+            layouts.erase(layout);
+            if (layouts.empty())
+                named.erase(found);
+        }
+    }
+    withDeps.erase(layout);
+    newDeps.erase(layout);
+    changed.erase(layout);
+}
+
+
+void RefreshIndex::Changed(Layout *layout)
+// ----------------------------------------------------------------------------
+//   Record that the refresh events of a layout changed
+// ----------------------------------------------------------------------------
+//   Layouts copying their events into this one must propagate them again,
+//   since a layout that refreshes loses the events it received.
+{
+    if (changed.insert(layout).second)
+    {
+        LayoutNames &names = layout->names;
+        dirtyNames.insert(names.begin(), names.end());
+    }
+}
+
+
+bool RefreshIndex::Affected(Layout *from, LayoutSet &set)
+// ----------------------------------------------------------------------------
+//   Check if the events RefreshOnUp copies from a layout may have changed
+// ----------------------------------------------------------------------------
+{
+    for (Layout *lyo = from; lyo; lyo = lyo->Parent())
+        if (set.count(lyo))
+            return true;
+    return false;
+}
+
+
+void RefreshIndex::PropagateDeps()
+// ----------------------------------------------------------------------------
+//   Copy refresh info along refresh_also edges touching changed layouts
+// ----------------------------------------------------------------------------
+//   Only the edges whose source or target changed are processed. When a
+//   target gets new events, the edges leaving it or its children are
+//   processed in turn, until nothing changes.
+{
+    if (withDeps.empty() || (changed.empty() && newDeps.empty()))
+    {
+        changed.clear();
+        newDeps.clear();
+        dirtyNames.clear();
+        return;
+    }
+
+    std::list<Layout *> work;
+    LayoutSet queued;
+    for (LayoutSet::iterator w = withDeps.begin(); w != withDeps.end(); w++)
+    {
+        Layout *from = *w;
+        bool dirty = newDeps.count(from) || Affected(from, changed);
+        LayoutNames &deps = from->deps;
+        for (LayoutNames::iterator d = deps.begin(); !dirty && d!=deps.end(); d++)
+            dirty = dirtyNames.count(*d) != 0;
+        if (dirty)
+        {
+            work.push_back(from);
+            queued.insert(from);
+        }
+    }
+
+    uint edges = 0;
+    while (!work.empty())
+    {
+        Layout *from = work.front();
+        work.pop_front();
+        queued.erase(from);
+
+        LayoutNames &deps = from->deps;
+        for (LayoutNames::iterator d = deps.begin(); d != deps.end(); d++)
+        {
+            NameMap::iterator found = named.find(*d);
+            if (found == named.end())
+                continue;
+
+            LayoutSet &targets = (*found).second;
+            for (LayoutSet::iterator t = targets.begin(); t != targets.end(); t++)
+            {
+                Layout *to = *t;
+                edges++;
+                IFTRACE(layoutevents)
+                    std::cerr << "Refresh dependency: from {"
+                              << from->PrettyId()
+                              << "} to {" << to->PrettyId()
+                              << " name " << (*d) << "}\n";
+                if (!to->RefreshOnUp(from))
+                    continue;
+
+                // Edges leaving 'to' or its children must be processed again
+                LayoutSet target;
+                target.insert(to);
+                for (LayoutSet::iterator w = withDeps.begin();
+                     w != withDeps.end(); w++)
+                {
+                    if (!queued.count(*w) && Affected(*w, target))
+                    {
+                        work.push_back(*w);
+                        queued.insert(*w);
+                    }
+                }
+            }
+        }
+    }
+
+    IFTRACE(layoutevents)
+        std::cerr << "Refresh dependencies resolved visiting " << edges
+                  << " edge(s) of " << withDeps.size() << " layout(s)\n";
+
+    changed.clear();
+    newDeps.clear();
+    dirtyNames.clear();
+}
+
 TAO_END
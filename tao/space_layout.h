@@ -24,9 +24,62 @@
 
 #include "layout.h"
 #include "justification.h"
+#include <map>
+#include <set>
 
 TAO_BEGIN
 
+struct RefreshIndex
+// ----------------------------------------------------------------------------
+//   Layouts that subscribed to refresh events, kept by the root layout
+// ----------------------------------------------------------------------------
+//   The index is maintained by Layout::RefreshOn, NoRefreshOn and Clear,
+//   so that an event only visits the layouts that asked for it.
+//   It also records the refresh_also dependency graph between named
+//   layouts, and which layouts changed since dependencies were last checked.
+{
+    typedef std::set<Layout *>                  LayoutSet;
+    typedef std::map<int, LayoutSet>            EventMap;
+    typedef std::pair<double, Layout *>         Deadline;
+    typedef std::set<Deadline>                  Deadlines;
+    typedef std::map<text, LayoutSet>           NameMap;
+
+public:
+    void                Subscribe(Layout *layout, int type);
+    void                Unsubscribe(Layout *layout, int type);
+    void                Schedule(Layout *layout, double from, double to);
+    void                Remove(Layout *layout);
+    void                Insert(Layout *layout);
+    bool                Subscribed(int type);
+    LayoutState::qevent_ids Events();
+    double              NextRefresh();
+    void                Targets(QEvent *event, double now, Layouts &out);
+
+    // Refresh dependencies (refresh_also)
+    void                AddName(Layout *layout, text name);
+    void                AddDep(Layout *layout);
+    void                Register(Layout *layout);
+    void                Forget(Layout *layout);
+    void                Changed(Layout *layout);
+    void                PropagateDeps();
+
+protected:
+    bool                Affected(Layout *layout, LayoutSet &set);
+    void                InTreeOrder(Layout *layout,
+                                    LayoutSet &selected, LayoutSet &onPath,
+                                    Layouts &out);
+
+public:
+    EventMap            events;         // Layouts by event type (not timer)
+    Deadlines           deadlines;      // Refresh deadlines, earliest first
+    NameMap             named;          // Layouts by name
+    LayoutSet           withDeps;       // Layouts with refresh_also
+    LayoutSet           changed;        // Events changed since last check
+    LayoutSet           newDeps;        // Deps added since last check
+    LayoutNames         dirtyNames;     // Names to re-check
+};
+
+
 struct SpaceLayout : Layout
 // ----------------------------------------------------------------------------
 //   Layout objects in 3D space
@@ -37,11 +90,15 @@ struct SpaceLayout : Layout
 
     virtual Box3        Space(Layout *layout);
     virtual SpaceLayout*NewChild()      { return new SpaceLayout(*this); }
+    virtual RefreshIndex *RootIndex()   { return parent ? NULL : &index; }
 
 public:
     // Space requested for the layout
     Box3                space;
     Justification       alongX, alongY, alongZ;
+
+    // Refresh subscriptions for the tree, only used in the root layout
+    RefreshIndex        index;
 };
 
 TAO_END
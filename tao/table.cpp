@@ -172,8 +172,8 @@ void Table::Draw(Layout *where)
             {
                 XL::Save<Point3> zeroOffset(offset, Point3());
                 Box3 bb = d->Space(this);
-                pos.x += (columnWidth[c]-bb.Width() ) * cell->alongX.centering;
-                pos.y += (rowHeight[r]-bb.Height()) * cell->alongY.centering;
+                pos.x += (columnWidth[c]-bb.Width() ) * cell->AlongX().centering;
+                pos.y += (rowHeight[r]-bb.Height()) * cell->AlongY().centering;
             }
 
             if (fi != fills.end())
@@ -241,8 +241,8 @@ void Table::DrawSelection(Layout *where)
             {
                 XL::Save<Point3> zeroOffset(offset, Point3());
                 Box3 bb = d->Space(this);
-                pos.x += (columnWidth[c]-bb.Width() ) * cell->alongX.centering;
-                pos.y += (rowHeight[r]-bb.Height()) * cell->alongY.centering;
+                pos.x += (columnWidth[c]-bb.Width() ) * cell->AlongX().centering;
+                pos.y += (rowHeight[r]-bb.Height()) * cell->AlongY().centering;
             }
 
             if (d)
@@ -302,8 +302,8 @@ void Table::Identify(Layout *where)
             {
                 XL::Save<Point3> zeroOffset(offset, Point3());
                 Box3 bb = d->Space(this);
-                pos.x += (columnWidth[c]-bb.Width() ) * cell->alongX.centering;
-                pos.y += (rowHeight[r]-bb.Height()) * cell->alongY.centering;
+                pos.x += (columnWidth[c]-bb.Width() ) * cell->AlongX().centering;
+                pos.y += (rowHeight[r]-bb.Height()) * cell->AlongY().centering;
             }
 
             if (d)
@@ -85,6 +85,7 @@ HEADERS +=     activity.h \
     documentation.h \
     drag.h \
     drawing.h \
+    drawing_arena.h \
     error_message_dialog.h \
     examples_menu.h \
     file_monitor.h \
@@ -104,6 +105,7 @@ HEADERS +=     activity.h \
     license.h \
     license_dialog.h \
     lighting.h \
+    lru_cache.h \
     manipulator.h \
     menuinfo.h \
     module_info_dialog.h \
@@ -133,6 +135,7 @@ HEADERS +=     activity.h \
     table.h \
     tao_main.h \
     tao_tree.h \
+    tesselator.h \
     text_drawing.h \
     html_converter.h \
     texture.h \
@@ -141,6 +144,7 @@ HEADERS +=     activity.h \
     transforms.h \
     tree_cloning.h \
     update_application.h \
+    vertex_array.h \
     widget.h \
     widget_surface.h \
     window.h \
@@ -174,6 +178,7 @@ SOURCES += \
     documentation.cpp \
     drag.cpp \
     drawing.cpp \
+    drawing_arena.cpp \
     error_message_dialog.cpp \
     examples_menu.cpp \
     file_monitor.cpp \
@@ -220,6 +225,7 @@ SOURCES += \
     svg.cpp \
     table.cpp \
     tao_main.cpp \
+    tesselator.cpp \
     text_drawing.cpp \
     html_converter.cpp \
     texture.cpp \
@@ -229,6 +235,7 @@ SOURCES += \
     tree_cloning.cpp \
     update_application.cpp \
     version.cpp \
+    vertex_array.cpp \
     widget.cpp \
     widget_surface.cpp \
     window.cpp
@@ -620,5 +627,6 @@ qttranslations.files = $$[QT_INSTALL_TRANSLATIONS]/qt_fr.qm $$[QT_INSTALL_TRANSL
 INSTALLS += qttranslations
 
 shaders.path = $$APPINST
-shaders.files = lighting.vs lighting.fs
+shaders.files = lighting.vs lighting.fs glyph_sdf.vs glyph_sdf.fs \
+                instances.vs instances.fs
 INSTALLS += shaders
@@ -0,0 +1,1071 @@
+// ****************************************************************************
+//  tesselator.cpp                                                  Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Polygon tesselator writing triangles into flat vertex / index arrays
+//
+//     The contours are projected in their plane, and swept twice by a line
+//     moving along v. The first sweep splits the edges where they cross,
+//     so that edges only meet at vertices. The second sweep keeps the
+//     edges crossing the line sorted from left to right, with the winding
+//     number of the region on the right of each of them. Regions that are
+//     inside according to the winding rule are cut into polygons that are
+//     monotone along v, which are triangulated as their vertices arrive.
+//
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tesselator.h"
+#include <algorithm>
+#include <cmath>
+
+
+TAO_BEGIN
+
+Tesselator::Tesselator(GLenum winding)
+// ----------------------------------------------------------------------------
+//   Create an empty tesselator for the given winding rule
+// ----------------------------------------------------------------------------
+    : winding(winding), output(NULL), triangles(NULL), flip(1), flatness(0),
+      count(0)
+{}
+
+
+void Tesselator::BeginContour()
+// ----------------------------------------------------------------------------
+//   Start a new closed contour
+// ----------------------------------------------------------------------------
+{
+    contours.push_back(input.size());
+}
+
+
+void Tesselator::Vertex3(const Point3 &position, const Point3 &texture)
+// ----------------------------------------------------------------------------
+//   Add a vertex to the current contour
+// ----------------------------------------------------------------------------
+{
+    if (contours.empty())
+        contours.push_back(0);
+    input.push_back(Vertex(position, texture));
+}
+
+
+void Tesselator::Clear()
+// ----------------------------------------------------------------------------
+//   Forget all contours, but keep the memory for the next polygon
+// ----------------------------------------------------------------------------
+{
+    input.clear();
+    contours.clear();
+    u.clear();
+    v.clear();
+    edges.clear();
+    flat.clear();
+    sources.clear();
+    pieces.clear();
+    events.clear();
+}
+
+
+static inline coord component(const Point3 &p, uint axis)
+// ----------------------------------------------------------------------------
+//   Return the x, y or z component of a point
+// ----------------------------------------------------------------------------
+{
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+
+struct SweepOrder
+// ----------------------------------------------------------------------------
+//   Sort vertices along v, then along u
+// ----------------------------------------------------------------------------
+{
+    typedef std::vector<coord> Coords;
+    SweepOrder(const Coords &u, const Coords &v): u(u), v(v) {}
+    bool operator() (uint a, uint b) const
+    {
+        return v[a] < v[b] || (v[a] == v[b] && u[a] < u[b]);
+    }
+    const Coords &u, &v;
+};
+
+
+struct EdgeStartsBefore
+// ----------------------------------------------------------------------------
+//   Sort edges by their lower vertex, then from left to right above it
+// ----------------------------------------------------------------------------
+{
+    typedef std::vector<coord> Coords;
+    EdgeStartsBefore(const Coords &u, const Coords &v): u(u), v(v) {}
+    template <class Edge>
+    bool operator() (const Edge &a, const Edge &b) const
+    {
+        uint al = a.lower, bl = b.lower;
+        if (v[al] != v[bl])
+            return v[al] < v[bl];
+        if (u[al] != u[bl])
+            return u[al] < u[bl];
+        return a.slope < b.slope;
+    }
+    const Coords &u, &v;
+};
+
+
+template <class Edges>
+struct EdgeEndsBefore
+// ----------------------------------------------------------------------------
+//   Sort edge indices by the v of their upper vertex
+// ----------------------------------------------------------------------------
+{
+    typedef std::vector<coord> Coords;
+    EdgeEndsBefore(const Edges &edges, const Coords &v): edges(edges), v(v) {}
+    bool operator() (uint a, uint b) const
+    {
+        return v[edges[a].upper] < v[edges[b].upper];
+    }
+    const Edges &edges;
+    const Coords &v;
+};
+
+
+struct CrossesLater
+// ----------------------------------------------------------------------------
+//   Order crossings in a heap, with the next one in sweep order on top
+// ----------------------------------------------------------------------------
+{
+    template <class Crossing>
+    bool operator() (const Crossing &a, const Crossing &b) const
+    {
+        return a.v > b.v || (a.v == b.v && a.u > b.u);
+    }
+};
+
+
+bool Tesselator::Inside(int w)
+// ----------------------------------------------------------------------------
+//   Check if a region with the given winding number is inside the polygon
+// ----------------------------------------------------------------------------
+{
+    switch (winding)
+    {
+    case GLU_TESS_WINDING_ODD:          return w & 1;
+    case GLU_TESS_WINDING_NONZERO:      return w != 0;
+    case GLU_TESS_WINDING_POSITIVE:     return w > 0;
+    case GLU_TESS_WINDING_NEGATIVE:     return w < 0;
+    case GLU_TESS_WINDING_ABS_GEQ_TWO:  return w >= 2 || w <= -2;
+    }
+    return false;
+}
+
+
+void Tesselator::Project(int &flip)
+// ----------------------------------------------------------------------------
+//   Project the input in the plane of the contours
+// ----------------------------------------------------------------------------
+//   The normal of the plane is computed with Newell's method, and we drop
+//   its largest component. 'flip' is set to -1 if the contours are
+//   oriented clockwise around that component.
+{
+    uint count = input.size();
+    uint contourCount = contours.size();
+    Vector3 normal(0, 0, 0);
+    for (uint c = 0; c < contourCount; c++)
+    {
+        uint first = contours[c];
+        uint last = c + 1 < contourCount ? contours[c+1] : count;
+        for (uint i = first; i < last; i++)
+        {
+            const Point3 &p = input[i].position;
+            const Point3 &q = input[i + 1 < last ? i + 1 : first].position;
+            normal.x += (p.y - q.y) * (p.z + q.z);
+            normal.y += (p.z - q.z) * (p.x + q.x);
+            normal.z += (p.x - q.x) * (p.y + q.y);
+        }
+    }
+
+    // When the contours enclose no area, e.g. a figure eight, the normal
+    // is null, and we drop the component along which they are flattest
+    if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+    {
+        Point3 lo = input[0].position, hi = lo;
+        for (uint i = 1; i < count; i++)
+        {
+            const Point3 &p = input[i].position;
+            lo.x = std::min(lo.x, p.x); hi.x = std::max(hi.x, p.x);
+            lo.y = std::min(lo.y, p.y); hi.y = std::max(hi.y, p.y);
+            lo.z = std::min(lo.z, p.z); hi.z = std::max(hi.z, p.z);
+        }
+        normal = Vector3(1 / (hi.x - lo.x), 1 / (hi.y - lo.y),
+                         1 / (hi.z - lo.z));
+    }
+
+    uint axis = 2;
+    coord nx = fabs(normal.x), ny = fabs(normal.y), nz = fabs(normal.z);
+    if (nx > ny && nx > nz)
+        axis = 0;
+    else if (ny > nz)
+        axis = 1;
+    flip = component(normal, axis) < 0 ? -1 : 1;
+
+    uint uAxis = (axis + 1) % 3;
+    uint vAxis = (axis + 2) % 3;
+    u.resize(count);
+    v.resize(count);
+    for (uint i = 0; i < count; i++)
+    {
+        u[i] = component(input[i].position, uAxis);
+        v[i] = component(input[i].position, vAxis);
+    }
+}
+
+
+void Tesselator::Connect(coord epsilon)
+// ----------------------------------------------------------------------------
+//   Sort the vertices in sweep order and build the edges between them
+// ----------------------------------------------------------------------------
+//   Vertices less than epsilon above a level are moved onto it, so that
+//   edges that are almost horizontal become horizontal.
+{
+    uint count = input.size();
+    uint contourCount = contours.size();
+    order.resize(count);
+    same.resize(count);
+    for (uint i = 0; i < count; i++)
+        order[i] = same[i] = i;
+    SweepOrder before(u, v);
+    std::sort(order.begin(), order.end(), before);
+    coord level = v[order[0]];
+    bool moved = false;
+    for (uint i = 1; i < count; i++)
+    {
+        coord &at = v[order[i]];
+        if (at - level > epsilon)
+            level = at;
+        else if (at != level)
+            at = level, moved = true;
+    }
+    if (moved)
+        std::sort(order.begin(), order.end(), before);
+
+    // Build edges, with the direction relative to 'flip'. Horizontal
+    // edges go in the sweep order, i.e. towards increasing u.
+    for (uint c = 0; c < contourCount; c++)
+    {
+        uint first = contours[c];
+        uint last = c + 1 < contourCount ? contours[c+1] : count;
+        for (uint i = first; i < last; i++)
+        {
+            uint j = i + 1 < last ? i + 1 : first;
+            if (u[i] == u[j] && v[i] == v[j])
+                continue;
+
+            Edge edge;
+            bool up = before(i, j);
+            edge.lower = up ? i : j;
+            edge.upper = up ? j : i;
+            edge.bottom = edge.lower;
+            edge.direction = up ? -flip : flip;
+            if (v[i] == v[j])
+            {
+                edge.slope = 0;
+                flat.push_back(edge);
+            }
+            else
+            {
+                edge.slope = (u[edge.upper] - u[edge.lower]) /
+                    (v[edge.upper] - v[edge.lower]);
+                edges.push_back(edge);
+            }
+        }
+    }
+}
+
+
+inline coord Tesselator::U(const Edge &edge, coord at)
+// ----------------------------------------------------------------------------
+//   Position of a non-horizontal input edge along u for the given v
+// ----------------------------------------------------------------------------
+{
+    return u[edge.lower] + edge.slope * (at - v[edge.lower]);
+}
+
+
+inline coord Tesselator::Orient(uint a, uint b, uint c)
+// ----------------------------------------------------------------------------
+//   Twice the signed area of a triangle, positive if counter-clockwise
+// ----------------------------------------------------------------------------
+{
+    return (u[b] - u[a]) * (v[c] - v[a]) - (v[b] - v[a]) * (u[c] - u[a]);
+}
+
+
+void Tesselator::Intersections(coord epsilon)
+// ----------------------------------------------------------------------------
+//   Split the edges at crossings and at the vertices they go through
+// ----------------------------------------------------------------------------
+//   The sweep line stops at each v where there are vertices, and at each
+//   crossing. The edges crossing the line are kept from left to right,
+//   and only edges that become neighbours are checked for a crossing, as
+//   in the Bentley-Ottmann algorithm. Points on the line closer than
+//   epsilon become a single vertex, where edges are split. This gives
+//   the pieces, which only meet at their ends, and the events, i.e. the
+//   vertices in sweep order.
+{
+    uint count = input.size();
+    uint edgeCount = edges.size(), flatCount = flat.size();
+    std::sort(edges.begin(), edges.end(), EdgeStartsBefore(u, v));
+    std::sort(flat.begin(), flat.end(), EdgeStartsBefore(u, v));
+    ends.resize(edgeCount);
+    for (uint e = 0; e < edgeCount; e++)
+        ends[e] = e;
+    std::sort(ends.begin(), ends.end(), EdgeEndsBefore<Edges>(edges, v));
+    slot.assign(edgeCount, NONE);
+    spanning.clear();
+    crossings.clear();
+
+    uint nextVertex = 0, nextEdge = 0, nextEnd = 0, nextFlat = 0;
+    while (nextVertex < count)
+    {
+        coord level = v[order[nextVertex]];
+        while (!crossings.empty() && crossings.front().v < level - epsilon)
+            Cross(NextCrossing(), epsilon);
+
+        // Collect the vertices on the line, the edges close to them, the
+        // edges crossing horizontal edges on the line, and the edges that
+        // cross so close to the line that it is the same
+        points.clear();
+        checks.clear();
+        for (; nextVertex < count && v[order[nextVertex]] == level;
+             nextVertex++)
+        {
+            uint vertex = order[nextVertex];
+            points.push_back(Point(u[vertex], vertex, NONE));
+            Near(level, u[vertex] - epsilon, u[vertex] + epsilon);
+        }
+        for (uint f = nextFlat; f < flatCount && v[flat[f].lower] == level;
+             f++)
+            Near(level, u[flat[f].lower], u[flat[f].upper]);
+        while (!crossings.empty() && crossings.front().v <= level)
+        {
+            Crossing crossing = NextCrossing();
+            uint left = crossing.left, right = crossing.right;
+            if (slot[left] == NONE || slot[right] != slot[left] + 1)
+                continue;
+            coord ul = U(edges[left], level), ur = U(edges[right], level);
+            Near(level, std::min(ul, ur) - epsilon,
+                 std::max(ul, ur) + epsilon);
+        }
+        std::sort(points.begin(), points.end());
+
+        // Merge close points into vertices, and split edges there
+        uint levelStart = events.size();
+        uint pointCount = points.size();
+        for (uint p = 0; p < pointCount; )
+        {
+            uint end = p + 1;
+            while (end < pointCount &&
+                   points[end].u - points[end-1].u <= epsilon)
+                end++;
+            uint vertex = NONE;
+            for (uint q = p; q < end && vertex == NONE; q++)
+                vertex = points[q].vertex;
+            if (vertex == NONE)
+                vertex = NewVertex(edges[points[p].edge], points[p].u, level);
+            uint lo = NONE, hi = 0;
+            for (uint q = p; q < end; q++)
+            {
+                if (points[q].vertex != NONE)
+                {
+                    same[points[q].vertex] = vertex;
+                    continue;
+                }
+                uint e = points[q].edge;
+                Split(edges[e], vertex);
+                lo = std::min(lo, slot[e]);
+                hi = std::max(hi, slot[e] + 1);
+            }
+            if (hi > lo + 1)
+                Reorder(lo, hi);
+            events.push_back(vertex);
+            p = end;
+        }
+
+        // Split horizontal edges at the vertices they contain
+        uint levelEnd = events.size();
+        for (; nextFlat < flatCount && v[flat[nextFlat].lower] == level;
+             nextFlat++)
+        {
+            Edge &edge = flat[nextFlat];
+            uint lower = same[edge.lower];
+            uint upper = same[edge.upper];
+            uint e = levelStart;
+            while (e < levelEnd && events[e] != lower)
+                e++;
+            for (; e + 1 < levelEnd && events[e] != upper; e++)
+                pieces.push_back(Piece(events[e], events[e+1],
+                                       edge.direction));
+        }
+
+        // Remove the edges ending here. Edges on each side of a gap are
+        // new neighbours.
+        uint spanCount = spanning.size();
+        uint removed = spanCount;
+        for (; nextEnd < edgeCount && v[edges[ends[nextEnd]].upper] == level;
+             nextEnd++)
+        {
+            uint e = ends[nextEnd];
+            Split(edges[e], same[edges[e].upper]);
+            removed = std::min(removed, slot[e]);
+            slot[e] = NONE;
+        }
+        uint kept = removed;
+        bool gap = removed < spanCount;
+        for (uint s = removed; s < spanCount; s++)
+        {
+            uint e = spanning[s];
+            if (slot[e] == NONE)
+            {
+                gap = true;
+                continue;
+            }
+            if (gap && kept > 0)
+                checks.push_back(spanning[kept-1]);
+            gap = false;
+            spanning[kept] = e;
+            slot[e] = kept++;
+        }
+        spanning.resize(kept);
+
+        // Insert the edges starting here, after the edges going through
+        // the same vertex with a lower slope
+        for (; nextEdge < edgeCount && v[edges[nextEdge].lower] == level;
+             nextEdge++)
+        {
+            Edge &edge = edges[nextEdge];
+            edge.bottom = same[edge.lower];
+            coord at = u[edge.bottom];
+            uint s = Lower(level, at - epsilon);
+            uint spanCount = spanning.size();
+            while (s < spanCount &&
+                   U(edges[spanning[s]], level) <= at + epsilon &&
+                   edges[spanning[s]].slope < edge.slope)
+                s++;
+            spanning.insert(spanning.begin() + s, nextEdge);
+            for (uint t = s; t <= spanCount; t++)
+                slot[spanning[t]] = t;
+            if (s > 0)
+                checks.push_back(spanning[s-1]);
+            checks.push_back(nextEdge);
+        }
+
+        // Check the new neighbours for crossings above the line
+        uint checkCount = checks.size();
+        for (uint c = 0; c < checkCount; c++)
+        {
+            uint s = slot[checks[c]];
+            if (s != NONE && s + 1 < spanning.size())
+                Check(spanning[s], spanning[s+1], level);
+        }
+    }
+}
+
+
+uint Tesselator::Lower(coord level, coord at)
+// ----------------------------------------------------------------------------
+//   Return the index of the first spanning edge at or after 'at'
+// ----------------------------------------------------------------------------
+{
+    uint lo = 0, hi = spanning.size();
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        if (U(edges[spanning[mid]], level) < at)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+void Tesselator::Near(coord level, coord from, coord to)
+// ----------------------------------------------------------------------------
+//   Add the edges going through the level between 'from' and 'to'
+// ----------------------------------------------------------------------------
+{
+    uint spanCount = spanning.size();
+    for (uint s = Lower(level, from); s < spanCount; s++)
+    {
+        Edge &edge = edges[spanning[s]];
+        coord at = U(edge, level);
+        if (at > to)
+            break;
+        if (v[edge.upper] != level)
+            points.push_back(Point(at, NONE, spanning[s]));
+    }
+}
+
+
+void Tesselator::Check(uint left, uint right, coord level)
+// ----------------------------------------------------------------------------
+//   Record where two neighbour edges cross above the level, if they do
+// ----------------------------------------------------------------------------
+//   Edges that rounding left in the wrong order cross at the level.
+//   Edges that meet where one of them ends are split at that vertex.
+{
+    const Edge &a = edges[left];
+    const Edge &b = edges[right];
+    coord closing = a.slope - b.slope;
+    if (closing <= 0)
+        return;
+    coord distance = U(b, level) - U(a, level);
+    coord at = level + std::max(distance, coord(0)) / closing;
+    if (at >= v[a.upper] || at >= v[b.upper])
+        return;
+    coord where = (U(a, at) + U(b, at)) / 2;
+    crossings.push_back(Crossing(at, where, left, right));
+    std::push_heap(crossings.begin(), crossings.end(), CrossesLater());
+}
+
+
+void Tesselator::Cross(const Crossing &crossing, coord epsilon)
+// ----------------------------------------------------------------------------
+//   Split neighbour edges where they cross, and swap them
+// ----------------------------------------------------------------------------
+//   The crossing is ignored if the edges are no longer neighbours, e.g.
+//   because they were already swapped. Other edges going through the
+//   same point are split there too, and all of them are sorted by slope.
+{
+    uint lo = slot[crossing.left];
+    if (lo == NONE || slot[crossing.right] != lo + 1)
+        return;
+
+    coord level = crossing.v, at = crossing.u;
+    uint hi = lo + 2, spanCount = spanning.size();
+    while (lo > 0 && fabs(U(edges[spanning[lo-1]], level) - at) <= epsilon)
+        lo--;
+    while (hi < spanCount &&
+           fabs(U(edges[spanning[hi]], level) - at) <= epsilon)
+        hi++;
+
+    uint vertex = NewVertex(edges[crossing.left], at, level);
+    events.push_back(vertex);
+    for (uint s = lo; s < hi; s++)
+        Split(edges[spanning[s]], vertex);
+    checks.clear();
+    Reorder(lo, hi);
+    uint checkCount = checks.size();
+    for (uint c = 0; c < checkCount; c++)
+    {
+        uint s = slot[checks[c]];
+        if (s + 1 < spanCount)
+            Check(spanning[s], spanning[s+1], level);
+    }
+}
+
+
+void Tesselator::Reorder(uint lo, uint hi)
+// ----------------------------------------------------------------------------
+//   Sort spanning edges going through the same vertex by slope
+// ----------------------------------------------------------------------------
+//   This gives their order above the vertex. The edges on each side of
+//   them may have new neighbours.
+{
+    for (uint s = lo + 1; s < hi; s++)
+    {
+        uint moving = spanning[s];
+        uint t = s;
+        for (; t > lo && edges[moving].slope < edges[spanning[t-1]].slope; t--)
+            spanning[t] = spanning[t-1];
+        spanning[t] = moving;
+    }
+    for (uint s = lo; s < hi; s++)
+        slot[spanning[s]] = s;
+    if (lo > 0)
+        checks.push_back(spanning[lo-1]);
+    checks.push_back(spanning[hi-1]);
+}
+
+
+Tesselator::Crossing Tesselator::NextCrossing()
+// ----------------------------------------------------------------------------
+//   Remove the next crossing in sweep order from the heap
+// ----------------------------------------------------------------------------
+{
+    Crossing next = crossings.front();
+    std::pop_heap(crossings.begin(), crossings.end(), CrossesLater());
+    crossings.pop_back();
+    return next;
+}
+
+
+uint Tesselator::NewVertex(const Edge &edge, coord atU, coord atV)
+// ----------------------------------------------------------------------------
+//   Create a vertex at a crossing on the given edge
+// ----------------------------------------------------------------------------
+{
+    coord du = u[edge.upper] - u[edge.lower];
+    coord dv = v[edge.upper] - v[edge.lower];
+    Source source;
+    source.lower = edge.lower;
+    source.upper = edge.upper;
+    source.t = fabs(du) > fabs(dv) ? (atU - u[edge.lower]) / du
+                                   : (atV - v[edge.lower]) / dv;
+    source.t = std::max(coord(0), std::min(coord(1), source.t));
+    sources.push_back(source);
+
+    uint index = u.size();
+    u.push_back(atU);
+    v.push_back(atV);
+    same.push_back(index);
+    return index;
+}
+
+
+void Tesselator::Split(Edge &edge, uint vertex)
+// ----------------------------------------------------------------------------
+//   Record the piece of an edge up to the vertex
+// ----------------------------------------------------------------------------
+{
+    if (edge.bottom != vertex)
+        pieces.push_back(Piece(edge.bottom, vertex, edge.direction));
+    edge.bottom = vertex;
+}
+
+
+void Tesselator::SortByAngle(uint vertex, Indices &list)
+// ----------------------------------------------------------------------------
+//   Sort pieces starting at the vertex from left to right
+// ----------------------------------------------------------------------------
+//   All pieces go up in the sweep order, so their directions are within
+//   a half-plane, and the piece on the left of another one is the one
+//   that a clockwise rotation brings onto the other one.
+{
+    uint n = list.size();
+    for (uint i = 1; i < n; i++)
+    {
+        uint moving = list[i];
+        uint j = i;
+        for (; j > 0; j--)
+        {
+            uint other = list[j-1];
+            if (Orient(vertex, pieces[other].upper, pieces[moving].upper) <= 0)
+                break;
+            list[j] = other;
+        }
+        list[j] = moving;
+    }
+}
+
+
+uint Tesselator::Position(uint vertex)
+// ----------------------------------------------------------------------------
+//   Return the number of active pieces on the left of a vertex
+// ----------------------------------------------------------------------------
+{
+    uint lo = 0, hi = active.size();
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        Piece &piece = pieces[active[mid].piece];
+        if (Orient(piece.lower, piece.upper, vertex) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+int Tesselator::NewPoly(uint bottom)
+// ----------------------------------------------------------------------------
+//   Start a monotone polygon at its lowest vertex
+// ----------------------------------------------------------------------------
+{
+    int index;
+    if (freePolys.empty())
+    {
+        index = polys.size();
+        polys.push_back(Poly());
+    }
+    else
+    {
+        index = freePolys.back();
+        freePolys.pop_back();
+    }
+    Poly &poly = polys[index];
+    poly.stack.clear();
+    poly.stack.push_back(bottom);
+    poly.side = 0;
+    return index;
+}
+
+
+void Tesselator::Add(int index, uint vertex, int side)
+// ----------------------------------------------------------------------------
+//   Add a vertex to the left or right chain of a monotone polygon
+// ----------------------------------------------------------------------------
+//   This is the usual stack algorithm: the stack holds a reflex chain.
+//   A vertex on the other chain sees all of it, a vertex on the same
+//   chain cuts the ears it can see.
+{
+    Poly &poly = polys[index];
+    Indices &stack = poly.stack;
+    if (poly.side == side || poly.side == 0)
+    {
+        while (stack.size() >= 2)
+        {
+            uint top = stack.back();
+            uint below = stack[stack.size() - 2];
+            coord area = Orient(below, top, vertex);
+            if (side == LEFT ? area >= 0 : area <= 0)
+                break;
+            if (side == LEFT)
+                Triangle(below, vertex, top);
+            else
+                Triangle(below, top, vertex);
+            stack.pop_back();
+        }
+        stack.push_back(vertex);
+    }
+    else
+    {
+        uint top = stack.back();
+        for (uint i = 0; i + 1 < stack.size(); i++)
+        {
+            if (poly.side == LEFT)
+                Triangle(stack[i], vertex, stack[i+1]);
+            else
+                Triangle(stack[i], stack[i+1], vertex);
+        }
+        stack.clear();
+        stack.push_back(top);
+        stack.push_back(vertex);
+    }
+    poly.side = side;
+}
+
+
+void Tesselator::Close(int index, uint vertex)
+// ----------------------------------------------------------------------------
+//   Add the top vertex of a monotone polygon, which sees the whole stack
+// ----------------------------------------------------------------------------
+{
+    Poly &poly = polys[index];
+    Indices &stack = poly.stack;
+    for (uint i = 0; i + 1 < stack.size(); i++)
+    {
+        if (poly.side == LEFT)
+            Triangle(stack[i], vertex, stack[i+1]);
+        else
+            Triangle(stack[i], stack[i+1], vertex);
+    }
+    freePolys.push_back(index);
+}
+
+
+void Tesselator::AddLeft(Active &region, uint vertex)
+// ----------------------------------------------------------------------------
+//   Add a vertex on the left boundary of a region that is inside
+// ----------------------------------------------------------------------------
+//   A region has two polygons when it was formed by two regions merging
+//   at a vertex. The next vertex is joined to that one, which ends the
+//   polygon on the side of the boundary.
+{
+    if (region.right >= 0)
+    {
+        Close(region.left, vertex);
+        region.left = region.right;
+        region.right = -1;
+    }
+    Add(region.left, vertex, LEFT);
+}
+
+
+void Tesselator::AddRight(Active &region, uint vertex)
+// ----------------------------------------------------------------------------
+//   Add a vertex on the right boundary of a region that is inside
+// ----------------------------------------------------------------------------
+{
+    if (region.right >= 0)
+    {
+        Close(region.right, vertex);
+        region.right = -1;
+    }
+    Add(region.left, vertex, RIGHT);
+}
+
+
+void Tesselator::Sweep()
+// ----------------------------------------------------------------------------
+//   Sweep the pieces to build monotone polygons in the inside regions
+// ----------------------------------------------------------------------------
+//   At each vertex, the pieces ending there are replaced with those that
+//   start there. Regions between ending pieces are complete. The regions
+//   on the left and right of the vertex continue above it, or merge if no
+//   piece starts there. A region split by a vertex inside it is cut along
+//   a diagonal joining the vertex to the last vertex of its polygon.
+{
+    active.clear();
+    polys.clear();
+    freePolys.clear();
+
+    uint eventCount = events.size();
+    for (uint e = 0; e < eventCount; e++)
+    {
+        uint vertex = events[e];
+        starting.clear();
+        for (uint p = firstPiece[vertex]; p < firstPiece[vertex+1]; p++)
+            starting.push_back(p);
+
+        // Find the pieces ending at the vertex
+        uint activeCount = active.size();
+        uint first = activeCount, last = activeCount;
+        for (uint a = 0; a < activeCount; a++)
+        {
+            if (pieces[active[a].piece].upper == vertex)
+            {
+                if (first == activeCount)
+                    first = a;
+                last = a + 1;
+            }
+        }
+        bool ending = first < last;
+        if (!ending)
+        {
+            if (starting.empty())
+                continue;
+            first = last = Position(vertex);
+        }
+
+        // Pieces between those ending here were not split by rounding
+        for (uint a = first; a < last; a++)
+        {
+            Piece piece = pieces[active[a].piece];
+            if (piece.upper != vertex)
+            {
+                starting.push_back(pieces.size());
+                pieces.push_back(Piece(vertex, piece.upper, piece.direction));
+            }
+        }
+        SortByAngle(vertex, starting);
+
+        // Update the regions touching the vertex
+        int w = first > 0 ? active[first-1].winding : 0;
+        bool leftInside = first > 0 && Inside(w);
+        int carry = -1;
+        if (ending)
+        {
+            if (leftInside)
+                AddRight(active[first-1], vertex);
+            for (uint a = first; a + 1 < last; a++)
+            {
+                if (Inside(active[a].winding))
+                {
+                    Close(active[a].left, vertex);
+                    if (active[a].right >= 0)
+                        Close(active[a].right, vertex);
+                }
+            }
+            Active &right = active[last-1];
+            if (Inside(right.winding))
+            {
+                AddLeft(right, vertex);
+                carry = right.left;
+            }
+        }
+        else if (leftInside)
+        {
+            Active &region = active[first-1];
+            if (region.right >= 0)
+            {
+                Add(region.left, vertex, RIGHT);
+                Add(region.right, vertex, LEFT);
+                carry = region.right;
+                region.right = -1;
+            }
+            else
+            {
+                uint top = polys[region.left].stack.back();
+                int side = polys[region.left].side;
+                int cut = NewPoly(top);
+                if (side == RIGHT)
+                {
+                    Add(cut, vertex, LEFT);
+                    Add(region.left, vertex, RIGHT);
+                    carry = cut;
+                }
+                else
+                {
+                    Add(cut, vertex, RIGHT);
+                    Add(region.left, vertex, LEFT);
+                    carry = region.left;
+                    region.left = cut;
+                }
+            }
+        }
+
+        // Create the active entries for the pieces starting here
+        fresh.clear();
+        uint startCount = starting.size();
+        for (uint s = 0; s < startCount; s++)
+        {
+            Active entry;
+            entry.piece = starting[s];
+            w += pieces[entry.piece].direction;
+            entry.winding = w;
+            entry.left = entry.right = -1;
+            if (s + 1 < startCount)
+            {
+                if (Inside(w))
+                    entry.left = NewPoly(vertex);
+            }
+            else if (Inside(w))
+            {
+                entry.left = carry >= 0 ? carry : NewPoly(vertex);
+                carry = -1;
+            }
+            fresh.push_back(entry);
+        }
+        if (carry >= 0)
+        {
+            if (startCount == 0 && leftInside)
+                active[first-1].right = carry;
+            else
+                Close(carry, vertex);
+        }
+
+        active.erase(active.begin() + first, active.begin() + last);
+        active.insert(active.begin() + first, fresh.begin(), fresh.end());
+    }
+
+    // Release the polygons that rounding may have left open
+    uint activeCount = active.size();
+    for (uint a = 0; a < activeCount; a++)
+    {
+        if (active[a].left >= 0)
+            freePolys.push_back(active[a].left);
+        if (active[a].right >= 0)
+            freePolys.push_back(active[a].right);
+    }
+}
+
+
+void Tesselator::Triangle(uint a, uint b, uint c)
+// ----------------------------------------------------------------------------
+//   Output a counter-clockwise triangle, unless it is flat
+// ----------------------------------------------------------------------------
+//   Triangles along a line may have a tiny area of either sign, which is
+//   why we drop those thinner than the tolerance.
+{
+    if (Orient(a, b, c) <= flatness)
+        return;
+    uint ia = OutputVertex(a);
+    uint ib = OutputVertex(b);
+    uint ic = OutputVertex(c);
+    triangles->push_back(ia);
+    triangles->push_back(flip > 0 ? ib : ic);
+    triangles->push_back(flip > 0 ? ic : ib);
+    count++;
+}
+
+
+uint Tesselator::OutputVertex(uint vertex)
+// ----------------------------------------------------------------------------
+//   Return the index of a vertex in the output, adding it the first time
+// ----------------------------------------------------------------------------
+{
+    int &index = outputIndex[vertex];
+    if (index >= 0)
+        return index;
+
+    index = output->size();
+    uint inputCount = input.size();
+    if (vertex < inputCount)
+    {
+        output->push_back(input[vertex]);
+    }
+    else
+    {
+        const Source &source = sources[vertex - inputCount];
+        const Vertex &lower = input[source.lower];
+        const Vertex &upper = input[source.upper];
+        coord t = source.t;
+        Point3 position = lower.position + t*(upper.position-lower.position);
+        Point3 texture = lower.texture + t * (upper.texture - lower.texture);
+        output->push_back(Vertex(position, texture));
+    }
+    return index;
+}
+
+
+uint Tesselator::Tesselate(Vertices &outputVertices, Indices &outputIndices)
+// ----------------------------------------------------------------------------
+//   Append the triangles for the current contours, return their number
+// ----------------------------------------------------------------------------
+{
+    uint inputCount = input.size();
+    if (inputCount < 3)
+        return 0;
+
+    flip = 1;
+    Project(flip);
+
+    // Scale the tolerance on the size of the input
+    coord umin = u[0], umax = u[0], vmin = v[0], vmax = v[0];
+    for (uint i = 1; i < inputCount; i++)
+    {
+        umin = std::min(umin, u[i]);
+        umax = std::max(umax, u[i]);
+        vmin = std::min(vmin, v[i]);
+        vmax = std::max(vmax, v[i]);
+    }
+    coord extent = std::max(umax - umin, vmax - vmin);
+    coord epsilon = extent * 1e-9;
+    if (epsilon <= 0)
+        return 0;
+    flatness = epsilon * extent;
+    Connect(epsilon);
+    Intersections(epsilon);
+
+    // Merge pieces joining the same vertices, and index them by vertex
+    std::sort(pieces.begin(), pieces.end());
+    uint kept = 0;
+    uint pieceCount = pieces.size();
+    for (uint p = 0; p < pieceCount; p++)
+    {
+        if (kept && pieces[kept-1].lower == pieces[p].lower &&
+            pieces[kept-1].upper == pieces[p].upper)
+            pieces[kept-1].direction += pieces[p].direction;
+        else
+            pieces[kept++] = pieces[p];
+        if (pieces[kept-1].direction == 0)
+            kept--;
+    }
+    pieces.erase(pieces.begin() + kept, pieces.end());
+    uint vertexCount = u.size();
+    firstPiece.assign(vertexCount + 1, 0);
+    for (uint p = 0; p < kept; p++)
+        firstPiece[pieces[p].lower + 1]++;
+    for (uint i = 0; i < vertexCount; i++)
+        firstPiece[i+1] += firstPiece[i];
+
+    output = &outputVertices;
+    triangles = &outputIndices;
+    count = 0;
+    outputIndex.assign(vertexCount, -1);
+    Sweep();
+    output = NULL;
+    triangles = NULL;
+    return count;
+}
+
+TAO_END
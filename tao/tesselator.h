@@ -0,0 +1,183 @@
+#ifndef TESSELATOR_H
+#define TESSELATOR_H
+// ****************************************************************************
+//  tesselator.h                                                    Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Polygon tesselator writing triangles into flat vertex / index arrays
+//
+//     Unlike the GLU tesselator, it does not use callbacks and has no
+//     global state, so different instances can run concurrently, e.g.
+//     on worker threads. It supports the GLU winding rules, and handles
+//     self-intersecting contours and holes. Like GLU, it splits the
+//     contours into monotone polygons with a sweep line, so the number
+//     of triangles is about the number of vertices.
+//
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tao.h"
+#include "base.h"
+#include "coords3d.h"
+#include "tao_gl.h"
+#include "tao_glu.h"
+#include <vector>
+
+
+TAO_BEGIN
+
+struct Tesselator
+// ----------------------------------------------------------------------------
+//   Split planar contours into triangles according to a winding rule
+// ----------------------------------------------------------------------------
+//   The winding rule is one of the GLU_TESS_WINDING_xxx values.
+//   Like GLU, the tesselator computes the plane of the contours and
+//   orients the triangles so that the total area of the input is positive.
+{
+    struct Vertex
+    {
+        Vertex(const Point3 &position, const Point3 &texture)
+            : position(position), texture(texture) {}
+        Point3          position;
+        Point3          texture;
+    };
+    typedef std::vector<Vertex>     Vertices;
+    typedef std::vector<uint>       Indices;
+
+public:
+    Tesselator(GLenum winding = GLU_TESS_WINDING_ODD);
+
+    void                BeginContour();
+    void                Vertex3(const Point3 &position, const Point3 &texture);
+    void                Clear();
+    uint                Tesselate(Vertices &output, Indices &triangles);
+
+public:
+    GLenum              winding;
+
+protected:
+    enum { NONE = ~0U };
+    enum { LEFT = -1, RIGHT = 1 };
+    struct Edge
+    {
+        uint            lower, upper;   // Input vertices, in sweep order
+        uint            bottom;         // Where the part not yet split starts
+        int             direction;      // Winding change when crossing it
+        coord           slope;          // Change of u along v
+    };
+    struct Piece
+    {
+        Piece(uint lower, uint upper, int direction)
+            : lower(lower), upper(upper), direction(direction) {}
+        uint            lower, upper;   // Vertices, in sweep order
+        int             direction;
+        bool operator<(const Piece &o) const
+        {
+            return lower < o.lower || (lower == o.lower && upper < o.upper);
+        }
+    };
+    struct Source
+    {
+        uint            lower, upper;   // Input edge containing a crossing
+        coord           t;              // Position of the crossing on it
+    };
+    struct Crossing
+    {
+        Crossing(coord v, coord u, uint left, uint right)
+            : v(v), u(u), left(left), right(right) {}
+        coord           v, u;
+        uint            left, right;    // Edges crossing there
+    };
+    struct Point
+    {
+        Point(coord u, uint vertex, uint edge)
+            : u(u), vertex(vertex), edge(edge) {}
+        coord           u;
+        uint            vertex, edge;   // One of them is NONE
+        bool operator<(const Point &o) const { return u < o.u; }
+    };
+    struct Active
+    {
+        uint            piece;
+        int             winding;        // Winding number right of the piece
+        int             left, right;    // Polygons right of the piece
+    };
+    struct Poly
+    {
+        Indices         stack;          // Vertices not triangulated yet
+        int             side;           // Chain of the top of the stack
+    };
+    typedef std::vector<Edge>       Edges;
+    typedef std::vector<Piece>      Pieces;
+    typedef std::vector<Source>     Sources;
+    typedef std::vector<Crossing>   Crossings;
+    typedef std::vector<Point>      Points;
+    typedef std::vector<Active>     Actives;
+    typedef std::vector<Poly>       Polys;
+    typedef std::vector<coord>      Coords;
+    typedef std::vector<int>        Ints;
+
+    bool                Inside(int windingNumber);
+    void                Project(int &flip);
+    void                Connect(coord epsilon);
+    coord               U(const Edge &edge, coord v);
+    coord               Orient(uint a, uint b, uint c);
+    void                Intersections(coord epsilon);
+    uint                Lower(coord level, coord at);
+    void                Near(coord level, coord from, coord to);
+    void                Check(uint left, uint right, coord level);
+    void                Cross(const Crossing &crossing, coord epsilon);
+    void                Reorder(uint lo, uint hi);
+    Crossing            NextCrossing();
+    uint                NewVertex(const Edge &edge, coord u, coord v);
+    void                Split(Edge &edge, uint vertex);
+    void                Sweep();
+    uint                Position(uint vertex);
+    void                SortByAngle(uint vertex, Indices &list);
+    int                 NewPoly(uint bottom);
+    void                Add(int poly, uint vertex, int side);
+    void                Close(int poly, uint vertex);
+    void                AddLeft(Active &region, uint vertex);
+    void                AddRight(Active &region, uint vertex);
+    void                Triangle(uint a, uint b, uint c);
+    uint                OutputVertex(uint vertex);
+
+protected:
+    Vertices            input;          // Vertices of all contours
+    Indices             contours;       // Index of first vertex of contours
+    Coords              u, v;           // Vertices projected in the plane
+    Edges               edges, flat;    // Non-horizontal and horizontal
+    Indices             order;          // Input vertices in sweep order
+    Indices             same;           // Vertex each vertex was merged in
+    Sources             sources;        // Vertices created at crossings
+    Pieces              pieces;         // Edges split at every vertex
+    Indices             events;         // Vertices of pieces in sweep order
+    Indices             firstPiece;     // First piece starting at vertex
+    Indices             ends;           // Edges in the order they end
+    Indices             spanning;       // Edges crossing the sweep line
+    Indices             slot;           // Index of each edge in spanning
+    Indices             checks;         // Edges with a new right neighbour
+    Crossings           crossings;      // Heap of crossings above the line
+    Points              points;         // Points on the current level
+    Actives             active;         // Pieces crossing the sweep line
+    Indices             starting;       // Pieces starting at a vertex
+    Actives             fresh;          // Active entries for these pieces
+    Polys               polys;          // Monotone polygons being built
+    Indices             freePolys;
+    Ints                outputIndex;    // Output index of each vertex
+    Vertices *          output;         // Where we write the triangles
+    Indices *           triangles;
+    int                 flip;
+    coord               flatness;       // Area of triangles we drop
+    uint                count;
+};
+
+TAO_END
+
+#endif // TESSELATOR_H
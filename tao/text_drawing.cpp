@@ -99,24 +99,29 @@ void TextSplit::Draw(Layout *where)
     bool        hasLine    = setLineColor(where) || where->extrudeDepth > 0;
     bool        hasTexture = setTexture(where);
     GlyphCache &glyphs     = widget->glyphs();
-    scale       fontSize   = where->font.pointSizeF();
+    scale       fontSize   = where->Font().pointSizeF();
     bool        tooBig     = fontSize > glyphs.maxFontSize;
     bool        tooSmall   = fontSize < glyphs.minFontSize &&
                              TaoApp->hasGLMultisample;
-    bool        badSize    = tooBig || tooSmall;
+    bool        badSize    = (tooBig || tooSmall) && !glyphs.sdf;
     Point3      offset0    = where->Offset();
     IFTRACE(justify)
         std::cerr << "<->TextSplit::Draw(Layout *" << where
                   <<") [" << this
                   << "] offset0 :" << offset0 // << " font " << +font.toString()
-                  << " Layout font " << +where->font.toString()
-                  << " Layout color " << where->fillColor
+                  << " Layout font " << +where->Font().toString()
+                  << " Layout color " << where->FillColor()
                   << std::endl
                   << *this << std::endl;
 
     // Check if we activated new texture units
     glyphs.CheckActiveLayout(where);
 
+    // Distance field glyphs can draw flat outlines with a shader
+    if (hasLine && glyphs.sdf && where->extrudeDepth <= 0 &&
+        where->FillColor().alpha > 0 && GlyphCache::DistanceProgram())
+        hasLine = false;
+
     if (!hasLine && !hasTexture && !badSize && cacheEnabled)
         DrawCached(where);
     else
@@ -136,34 +141,34 @@ void TextSplit::Draw(Layout *where)
 
 void TextSplit::AddGlyph(coord x, coord y, coord z,
                          GlyphCacheEntry &glyph, GlyphCache &glyphs,
-                         quads_t &quads, texCoords_t &texCoords)
+                         quads_t &quads)
 // ----------------------------------------------------------------------------
 //   Enter a glyph when generating a cached rendering
 // ----------------------------------------------------------------------------
 {
-    // Enter the geometry coordinates
+    // Compute the geometry coordinates
     coord charX1 = x + glyph.bounds.lower.x;
     coord charX2 = x + glyph.bounds.upper.x;
     coord charY1 = y - glyph.bounds.lower.y;
     coord charY2 = y - glyph.bounds.upper.y;
-    quads.push_back(Point3(charX1, charY1, z));
-    quads.push_back(Point3(charX2, charY1, z));
-    quads.push_back(Point3(charX2, charY2, z));
-    quads.push_back(Point3(charX1, charY2, z));
 
-    // Enter the texture coordinates
+    // Compute the texture coordinates
     Point &texL = glyph.texture.lower;
     Point &texU = glyph.texture.upper;
-    int tw = glyphs.Width(), th = glyphs.Height();
-    texCoords.push_back(Point(texL.x/tw, texL.y/th));
-    texCoords.push_back(Point(texU.x/tw, texL.y/th));
-    texCoords.push_back(Point(texU.x/tw, texU.y/th));
-    texCoords.push_back(Point(texL.x/tw, texU.y/th));
+    int tw = glyphs.Width(glyph.page), th = glyphs.Height(glyph.page);
+    coord texX1 = texL.x / tw, texX2 = texU.x / tw;
+    coord texY1 = texL.y / th, texY2 = texU.y / th;
+
+    // Enter the interleaved vertices
+    vertices_t &vertices = quads[glyph.page];
+    vertices.push_back(GlyphVertex(charX1, charY1, z, texX1, texY1));
+    vertices.push_back(GlyphVertex(charX2, charY1, z, texX2, texY1));
+    vertices.push_back(GlyphVertex(charX2, charY2, z, texX2, texY2));
+    vertices.push_back(GlyphVertex(charX1, charY2, z, texX1, texY2));
 }
 
 
-void TextSplit::DrawGlyphs(Layout *where,
-                           quads_t &quads, texCoords_t &texCoords)
+void TextSplit::DrawGlyphs(Layout *where, quads_t &quads)
 // ----------------------------------------------------------------------------
 //    Draw the glyphs in the texture coordinates
 // ----------------------------------------------------------------------------
@@ -171,34 +176,78 @@ void TextSplit::DrawGlyphs(Layout *where,
     // Check if there's anything to draw
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
 
-    uint count = quads.size();
-    if (count && setFillColor(where))
+    if (!quads.empty() && setFillColor(where))
     {
-        // Bind the glyph texture
-        GL.BindTexture(GL_TEXTURE_2D, glyphs.Texture());
-        if (font.pointSizeF() < glyphs.minFontSizeForAntialiasing)
-        {
-            GL.TexParameter(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            GL.TexParameter(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        }
         GL.Enable(GL_TEXTURE_2D);
         if (TaoApp->hasGLMultisample)
             GL.Enable(GL_MULTISAMPLE);
 
         // Ensure that the last active texture unit is 0. Fix #1918.
         GL.ClientActiveTexture(GL_TEXTURE0);
-
-        // Draw a list of rectangles with the textures
-        GL.VertexPointer(3, GL_DOUBLE, 0, &quads[0].x);
-        GL.TexCoordPointer(2, GL_DOUBLE, 0, &texCoords[0].x);
         GL.EnableClientState(GL_VERTEX_ARRAY);
         GL.EnableClientState(GL_TEXTURE_COORD_ARRAY);
 
         // Load model view matrix
         GL.LoadMatrix();
-        GL.DrawArrays(GL_QUADS, 0, count);
+
+        // Distance fields are drawn with a shader, or with an alpha test
+        uint sdfProgram = 0;
+        if (glyphs.sdf)
+        {
+            if (!where->ProgramId())
+                sdfProgram = GlyphCache::DistanceProgram();
+            if (sdfProgram)
+            {
+                const Color &lc = where->LineColor();
+                scale lw = where->lineWidth;
+                scale la = lc.alpha * where->visibility;
+                if (la <= 0)
+                    lw = 0;
+                GL.UseProgram(sdfProgram);
+                GL.Uniform(GL.GetUniformLocation(sdfProgram, "glyphs"), 0);
+                GL.Uniform(GL.GetUniformLocation(sdfProgram, "outlineWidth"),
+                           (float) glyphs.DistanceWidth(font, lw));
+                GL.Uniform(GL.GetUniformLocation(sdfProgram, "outlineColor"),
+                           (float) lc.red, (float) lc.green, (float) lc.blue,
+                           (float) la);
+            }
+            else
+            {
+                GL.Enable(GL_ALPHA_TEST);
+                GL.AlphaFunc(GL_GEQUAL, 0.5);
+            }
+        }
+
+        // Draw the rectangles of each atlas page with its texture
+        GLsizei stride = sizeof(GlyphVertex);
+        for (quads_t::iterator q = quads.begin(); q != quads.end(); q++)
+        {
+            vertices_t &vertices = (*q).second;
+            uint count = vertices.size();
+
+            // Bind the glyph texture
+            GL.BindTexture(GL_TEXTURE_2D, glyphs.Texture((*q).first));
+            if (font.pointSizeF() < glyphs.minFontSizeForAntialiasing &&
+                !glyphs.sdf)
+            {
+                GL.TexParameter(GL_TEXTURE_2D,
+                                GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                GL.TexParameter(GL_TEXTURE_2D,
+                                GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            }
+
+            GL.VertexPointer(3, GL_FLOAT, stride, vertices[0].position);
+            GL.TexCoordPointer(2, GL_FLOAT, stride, vertices[0].texture);
+            GL.DrawArrays(GL_QUADS, 0, count);
+            VertexArray::Submitted(count * sizeof(GlyphVertex));
+        }
+
+        if (sdfProgram)
+            GL.UseProgram(where->ProgramId());
+        else if (glyphs.sdf)
+            GL.Disable(GL_ALPHA_TEST);
 
         GL.DisableClientState(GL_VERTEX_ARRAY);
         GL.DisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -219,14 +268,14 @@ void TextSplit::DrawCached(Layout *where)
     text        str      = ttree->value;
     bool        canSel   = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel      = widget->textSelection();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     coord       x        = pos.x;
     coord       y        = pos.y;
     coord       z        = pos.z;
 
     GlyphCache::GlyphEntry  glyph;
-    std::vector<Point3>     quads;
-    std::vector<Point>      texCoords;
+    quads_t                 quads;
 
     // Cases where we can't select
     if (canSel)
@@ -240,7 +289,7 @@ void TextSplit::DrawCached(Layout *where)
     }
 
     // Compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Loop over all characters in the text span
     uint i, max = str.length();
@@ -260,16 +309,16 @@ void TextSplit::DrawCached(Layout *where)
         else
         {
             // Find the glyph in the glyph cache
-            if (!glyphs.Find(font, unicode, glyph, true))
+            if (!glyphs.Find(font, fontKey, unicode, glyph, true))
                 continue;
 
             uint glyphWidth = glyph.advance + spread;
-            AddGlyph(x, y, z, glyph, glyphs, quads, texCoords);            
+            AddGlyph(x, y, z, glyph, glyphs, quads);            
             x += glyphWidth;
         }
     }
 
-    DrawGlyphs(where, quads, texCoords);
+    DrawGlyphs(where, quads);
     where->offset = Point3(x, y, z);
 }
 
@@ -286,14 +335,14 @@ void TextSplitRTL::DrawCached(Layout *where)
     text        str      = ttree->value;
     bool        canSel   = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel      = widget->textSelection();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     coord       x        = pos.x;
     coord       y        = pos.y;
     coord       z        = pos.z;
 
     GlyphCache::GlyphEntry  glyph;
-    std::vector<Point3>     quads;
-    std::vector<Point>      texCoords;
+    quads_t                 quads;
 
     // Cases where we can't select
     if (canSel)
@@ -307,7 +356,7 @@ void TextSplitRTL::DrawCached(Layout *where)
     }
 
     // Compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Loop over all characters in the text span
     uint i, max = str.length();
@@ -327,17 +376,17 @@ void TextSplitRTL::DrawCached(Layout *where)
         else
         {
             // Find the glyph in the glyph cache, create it otherwise
-            if (!glyphs.Find(font, unicode, glyph, true))
+            if (!glyphs.Find(font, fontKey, unicode, glyph, true))
                 continue;
 
             uint glyphWidth = glyph.advance + spread;
             x -= glyphWidth;
-            AddGlyph(x, y, z, glyph, glyphs, quads, texCoords);            
+            AddGlyph(x, y, z, glyph, glyphs, quads);            
         }
     }
 
     // Check if there's anything to draw
-    DrawGlyphs(where, quads, texCoords);
+    DrawGlyphs(where, quads);
     where->offset = Point3(x, y, z);
 }
 
@@ -354,14 +403,14 @@ void TextSplitArabic::DrawCached(Layout *where)
     text        str      = ttree->value;
     bool        canSel   = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel      = widget->textSelection();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     coord       x        = pos.x;
     coord       y        = pos.y;
     coord       z        = pos.z;
 
     GlyphCache::GlyphEntry  glyph;
-    std::vector<Point3>     quads;
-    std::vector<Point>      texCoords;
+    quads_t                 quads;
 
     // Cases where we can't select
     if (canSel)
@@ -375,7 +424,7 @@ void TextSplitArabic::DrawCached(Layout *where)
     }
 
     // Compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Loop over all characters in the text span
     uint max = str.length();
@@ -383,13 +432,13 @@ void TextSplitArabic::DrawCached(Layout *where)
     text rtlText = str.substr(start, size);
 
     // Find the glyph in the glyph cache
-    if (!glyphs.Find(font, rtlText, glyph, true))
+    if (!glyphs.Find(font, fontKey, rtlText, glyph, true))
         return;
 
     uint glyphWidth = glyph.advance + spread;
     x -= glyphWidth;
-    AddGlyph(x, y, z, glyph, glyphs, quads, texCoords);
-    DrawGlyphs(where, quads, texCoords);
+    AddGlyph(x, y, z, glyph, glyphs, quads);
+    DrawGlyphs(where, quads);
     where->offset = Point3(x, y, z);
 }
 
@@ -406,7 +455,8 @@ void TextSplit::DrawDirect(Layout *where)
     text        str      = ttree->value;
     bool        canSel   = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel      = widget->textSelection();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     coord       x        = pos.x;
     coord       y        = pos.y;
     coord       z        = pos.z;
@@ -415,7 +465,7 @@ void TextSplit::DrawDirect(Layout *where)
     bool        rtl      = IsRTL();
 
     // Disable drawing of lines if we don't see them.
-    if (where->lineColor.alpha <= 0)
+    if (where->LineColor().alpha <= 0)
         lw = 0;
 
     if (canSel)
@@ -431,7 +481,7 @@ void TextSplit::DrawDirect(Layout *where)
     GlyphCache::GlyphEntry  glyph;
 
     // Find length of text span and compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Loop over all characters in the text span
     for (i = start; i < max && i < end; i = XL::Utf8Next(str, i))
@@ -450,7 +500,7 @@ void TextSplit::DrawDirect(Layout *where)
         else
         {
             // Find the glyph in the glyph cache
-            if (!glyphs.Find(font, unicode, glyph, true, true, lw))
+            if (!glyphs.Find(font, fontKey, unicode, glyph, true, true, lw))
                 continue;
 
             if (rtl)
@@ -521,14 +571,15 @@ void TextSplitArabic::DrawDirect(Layout *where)
     text        str      = ttree->value;
     bool        canSel   = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel      = widget->textSelection();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     coord       x        = pos.x;
     coord       y        = pos.y;
     coord       z        = pos.z;
     scale       lw       = where->lineWidth;
 
     // Disable drawing of lines if we don't see them.
-    if (where->lineColor.alpha <= 0)
+    if (where->LineColor().alpha <= 0)
         lw = 0;
 
     if (canSel)
@@ -548,11 +599,11 @@ void TextSplitArabic::DrawDirect(Layout *where)
 
 
     // Find length of text span and compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Find the glyph in the glyph cache
     GlyphCache::GlyphEntry  glyph;
-    if (glyphs.Find(font, rtlText, glyph, true, true, lw))
+    if (glyphs.Find(font, fontKey, rtlText, glyph, true, true, lw))
     {
         x -= glyph.advance + spread;
 
@@ -618,7 +669,8 @@ void TextSplit::DrawSelection(Layout *where)
     Text *      ttree        = source;
     text        str          = ttree->value;
     bool        canSel       = ttree->Position() != XL::Tree::NOWHERE;
-    QFont      &font         = where->font;
+    QFont       font         = where->Font();
+    uint64      fontKey      = where->FontKey();
     Point3      pos          = where->offset;
     coord       x            = pos.x;
     coord       y            = pos.y;
@@ -644,7 +696,7 @@ void TextSplit::DrawSelection(Layout *where)
     }
 
     // Find length of text span and compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Loop over all characters in the text span
     uint i, next = 0, max = str.length();
@@ -657,7 +709,7 @@ void TextSplit::DrawSelection(Layout *where)
             charId = where->CharacterId();
 
         // Fetch data about that glyph
-        if (!glyphs.Find(font, unicode, glyph, false))
+        if (!glyphs.Find(font, fontKey, unicode, glyph, false))
             continue;
 
         if (sel && canSel)
@@ -770,6 +822,19 @@ void TextSplit::DrawSelection(Layout *where)
 }
 
 
+static inline void setQuad(GLfloat quad[4][3],
+                           coord x1, coord y1, coord x2, coord y2, coord z)
+// ----------------------------------------------------------------------------
+//   Set the corners of a selection quad
+// ----------------------------------------------------------------------------
+{
+    quad[0][0] = x1;    quad[0][1] = y1;    quad[0][2] = z;
+    quad[1][0] = x2;    quad[1][1] = y1;    quad[1][2] = z;
+    quad[2][0] = x2;    quad[2][1] = y2;    quad[2][2] = z;
+    quad[3][0] = x1;    quad[3][1] = y2;    quad[3][2] = z;
+}
+
+
 void TextSplit::Identify(Layout *where)
 // ----------------------------------------------------------------------------
 //   Draw and identify the bounding boxes for the various characters
@@ -782,7 +847,8 @@ void TextSplit::Identify(Layout *where)
     bool        canSel    = ttree->Position() != XL::Tree::NOWHERE;
     TextSelect *sel       = widget->textSelection();
     uint        charId    = ~0U;
-    QFont      &font      = where->font;
+    QFont       font      = where->Font();
+    uint64      fontKey   = where->FontKey();
     Point3      pos       = where->offset;
     coord       x         = pos.x;
     coord       y         = pos.y;
@@ -800,7 +866,7 @@ void TextSplit::Identify(Layout *where)
     coord       charY2    = y;
 
     GlyphCache::GlyphEntry  glyph;
-    Point3                  quad[4];
+    GLfloat                 quad[4][3];
 
     // A number of cases where we can't select text
     if (canSel)
@@ -814,13 +880,13 @@ void TextSplit::Identify(Layout *where)
     }
 
     // Find length of text span and compute per-char spread
-    float spread = where->alongX.perSolid;
+    float spread = where->AlongX().perSolid;
 
     // Load model view matrix
     GL.LoadMatrix();
 
     // Prepare to draw with the quad
-    GL.VertexPointer(3, GL_DOUBLE, 0, &quad[0].x);
+    GL.VertexPointer(3, GL_FLOAT, 0, quad);
     GL.EnableClientState(GL_VERTEX_ARRAY);
 
     // Loop over all characters in the text span
@@ -834,7 +900,7 @@ void TextSplit::Identify(Layout *where)
             charId = where->CharacterId();
 
         // Fetch data about that glyph
-        if (!glyphs.Find(font, unicode, glyph, false))
+        if (!glyphs.Find(font, fontKey, unicode, glyph, false))
             continue;
 
         if (canSel)
@@ -848,10 +914,7 @@ void TextSplit::Identify(Layout *where)
         charY1 = y - sd;
         charY2 = y - sd + sh;
 
-        quad[0] = Point3(charX1, charY1, z);
-        quad[1] = Point3(charX2, charY1, z);
-        quad[2] = Point3(charX2, charY2, z);
-        quad[3] = Point3(charX1, charY2, z);
+        setQuad(quad, charX1, charY1, charX2, charY2, z);
         GL.DrawArrays(GL_QUADS, 0, 4);
 
         // Advance to next character
@@ -877,7 +940,7 @@ void TextSplit::Identify(Layout *where)
         charId++;
         GL.LoadName((charId & ~Widget::SELECTION_MASK) |
                     Widget::CHARACTER_SELECTED);
-        if (glyphs.Find(font, ' ', glyph, false))
+        if (glyphs.Find(font, fontKey, ' ', glyph, false))
         {
             sd = descent;
             sh = height;
@@ -886,10 +949,7 @@ void TextSplit::Identify(Layout *where)
             charY1 = y - sd;
             charY2 = y - sd + sh;
 
-            quad[0] = Point3(charX1, charY1, z);
-            quad[1] = Point3(charX2, charY1, z);
-            quad[2] = Point3(charX2, charY2, z);
-            quad[3] = Point3(charX1, charY2, z);
+            setQuad(quad, charX1, charY1, charX2, charY2, z);
             GL.DrawArrays(GL_QUADS, 0, 4);
         }
     }
@@ -910,10 +970,10 @@ void TextSplit::Draw(GraphicPath &path, Layout *l)
     IFTRACE(justify)
         std::cerr << "->TextSplit::Draw (GraphicPath &path, Layout *"
                   << l << ") [" << this << "] layout font"
-                  << +l->font.toString() << "\n"
+                  << +l->Font().toString() << "\n"
                   << *this << "\n";
     Point3 position = path.position;
-    QFontMetricsF fm(l->font);
+    QFontMetricsF fm(l->Font());
     QPainterPath qt;
 
     QString str = +source->value.substr(start, end - start);
@@ -921,14 +981,14 @@ void TextSplit::Draw(GraphicPath &path, Layout *l)
     while (index >= 0)
     {
         QString fragment = str.left(index);
-        qt.addText(position.x, -position.y, l->font, fragment);
+        qt.addText(position.x, -position.y, l->Font(), fragment);
         position.x = 0;
         position.y -= fm.height();
         str = str.mid(index+1);
         index = str.indexOf(QChar('\n'));
     }
 
-    qt.addText(position.x, -position.y, l->font, str);
+    qt.addText(position.x, -position.y, l->Font(), str);
     position.x += fm.width(str);
 
     path.addQtPath(qt, -1);
@@ -947,7 +1007,8 @@ Box3 TextSplit::Bounds(Layout *where)
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
     text        str      = source->value;
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     Box3        result;
     scale       ascent   = glyphs.Ascent(font);
     scale       descent  = glyphs.Descent(font);
@@ -967,7 +1028,7 @@ Box3 TextSplit::Bounds(Layout *where)
         bool  newLine  = unicode == '\n';
 
         // Find the glyph in the glyph cache
-        if (!glyphs.Find(font, unicode, glyph, true))
+        if (!glyphs.Find(font, fontKey, unicode, glyph, true))
             continue;
 
         if (where->extrudeDepth > 0 && where->extrudeRadius > 0)
@@ -1016,7 +1077,8 @@ Box3 TextSplit::Space(Layout *where)
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
     text        str      = source->value;
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     Box3        result;
     scale       ascent   = glyphs.Ascent(font);
     scale       descent  = glyphs.Descent(font);
@@ -1040,7 +1102,7 @@ Box3 TextSplit::Space(Layout *where)
         bool  newLine  = unicode == '\n';
 
         // Find the glyph in the glyph cache
-        if (!glyphs.Find(font, unicode, glyph, true))
+        if (!glyphs.Find(font, fontKey, unicode, glyph, true))
             continue;
 
         if (where->extrudeDepth > 0 && where->extrudeRadius > 0)
@@ -1097,7 +1159,8 @@ Box3 TextSplitArabic::Bounds(Layout *where)
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
     text        str      = source->value;
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     Box3        result;
     Point3      pos      = where->offset;
     coord       x        = pos.x;
@@ -1110,7 +1173,7 @@ Box3 TextSplitArabic::Bounds(Layout *where)
     text rtlText = str.substr(start, size);
 
     // Find the glyph in the glyph cache
-    if (glyphs.Find(font, rtlText, glyph, true))
+    if (glyphs.Find(font, fontKey, rtlText, glyph, true))
     {
         if (where->extrudeDepth > 0 && where->extrudeRadius > 0)
             glyphs.ScaleDown(glyph, 1, where->extrudeRadius);
@@ -1140,7 +1203,8 @@ Box3 TextSplitArabic::Space(Layout *where)
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
     text        str      = source->value;
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     Box3        result;
     scale       ascent   = glyphs.Ascent(font);
     scale       descent  = glyphs.Descent(font);
@@ -1162,7 +1226,7 @@ Box3 TextSplitArabic::Space(Layout *where)
     text rtlText = str.substr(start, size);
 
     // Find the glyph in the glyph cache
-    if (glyphs.Find(font, rtlText, glyph, true))
+    if (glyphs.Find(font, fontKey, rtlText, glyph, true))
     {
         if (where->extrudeDepth > 0 && where->extrudeRadius > 0)
             glyphs.ScaleDown(glyph, 1, where->extrudeRadius);
@@ -1247,7 +1311,8 @@ scale TextSplit::TrailingSpaceSize(Layout *where)
 {
     Widget     *widget   = where->Display();
     GlyphCache &glyphs   = widget->glyphs();
-    QFont      &font     = where->font;
+    QFont       font     = where->Font();
+    uint64      fontKey  = where->FontKey();
     text        str      = source->value;
     uint        pos      = str.length();
     Box3        box;
@@ -1264,7 +1329,7 @@ scale TextSplit::TrailingSpaceSize(Layout *where)
         // Find the glyph in the glyph cache
         GlyphCache::GlyphEntry  glyph;
         uint  unicode  = XL::Utf8Code(str, pos);
-        if (!glyphs.Find(font, unicode, glyph, true))
+        if (!glyphs.Find(font, fontKey, unicode, glyph, true))
             continue;
         // Enter the geometry coordinates
         coord charX1 = glyph.bounds.lower.x;
@@ -1282,7 +1347,7 @@ scale TextSplit::TrailingSpaceSize(Layout *where)
         result = 0;
     IFTRACE(justify)
         std::cerr << "<->TextSplit::TrailingSpaceSize[" << this << "] font "
-                  << +where->font.toString() <<" returns " << result<< " for\n"
+                  << +where->Font().toString() <<" returns " << result<< " for\n"
                   << *this << "\n";
 
    return result;
@@ -29,6 +29,7 @@
 #include "tree.h"
 #include <QFont>
 #include <QTextCursor>
+#include <map>
 
 TAO_BEGIN
 
@@ -63,13 +64,12 @@ protected:
                                                Widget * widget,
                                                uint     position);
 
-    // Quads management
-    typedef std::vector<Point3> quads_t;
-    typedef std::vector<Point>  texCoords_t;
+    // Quads management, grouped by glyph atlas page
+    typedef std::vector<GlyphVertex> vertices_t;
+    typedef std::map<uint, vertices_t> quads_t;
     void AddGlyph(coord x, coord y, coord z,
-                  GlyphCacheEntry &entry, GlyphCache &glyphs,
-                  quads_t &quads, texCoords_t &texCoords);
-    void DrawGlyphs(Layout *where, quads_t &quads, texCoords_t &texCoords);
+                  GlyphCacheEntry &entry, GlyphCache &glyphs, quads_t &quads);
+    void DrawGlyphs(Layout *where, quads_t &quads);
 
 public:
     Text_p              source;
@@ -36,8 +36,9 @@ void Transform::Draw(Layout *where)
 {
     Color line(1.0, 0.0, 0.0, 0.5);
     Color fill(0.0, 0.7, 1.0, 0.5);
-    XL::Save<Color> saveLine(where->lineColor, line);
-    XL::Save<Color> saveFill(where->fillColor, fill);
+    LayoutColorState &colors = where->ColorState();
+    XL::Save<Color> saveLine(colors.lineColor, line);
+    XL::Save<Color> saveFill(colors.fillColor, fill);
     Box3 cubeBox(-25, -25, -25, 50, 50, 50);
     Cube cube(cubeBox);
     cube.Draw(where);
@@ -80,6 +81,17 @@ void Rotation::Draw(Layout *where)
 {
     // BUG? fmod required to avoid incorrect rotations with large values
     // (>1290000000)
+    amount = fmod(amount, 360.0);
+    Apply(where, amount, xaxis, yaxis, zaxis);
+}
+
+
+void Rotation::Apply(Layout *where, coord amount, coord xaxis, coord yaxis,
+                     coord zaxis)
+// ----------------------------------------------------------------------------
+//    Apply a rotation, also used when replaying compiled layouts
+// ----------------------------------------------------------------------------
+{
     amount = fmod(amount, 360.0);
     double amod90 = fmod(amount, 90.0);
     if (amod90 < -0.01 || amod90 > 0.01)
@@ -106,6 +118,15 @@ void Translation::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 {
     (void) where;
+    Apply(xaxis, yaxis, zaxis);
+}
+
+
+void Translation::Apply(coord xaxis, coord yaxis, coord zaxis)
+// ----------------------------------------------------------------------------
+//    Apply a translation, also used when replaying compiled layouts
+// ----------------------------------------------------------------------------
+{
     GL.Translate(xaxis, yaxis, zaxis);
     if (zaxis != 0.0)
         GL.HasPixelBlur(true);
@@ -116,6 +137,15 @@ void Scale::Draw(Layout *where)
 // ----------------------------------------------------------------------------
 //    Scale in a drawing
 // ----------------------------------------------------------------------------
+{
+    Apply(where, xaxis, yaxis, zaxis);
+}
+
+
+void Scale::Apply(Layout *where, scale xaxis, scale yaxis, scale zaxis)
+// ----------------------------------------------------------------------------
+//    Apply a scale change, also used when replaying compiled layouts
+// ----------------------------------------------------------------------------
 {
     if (where->offset != Vector3())
     {
@@ -56,6 +56,7 @@ struct Rotation : Transform
     Rotation(coord a, coord x, coord y, coord z):
         Transform(), amount(a), xaxis(x), yaxis(y), zaxis(z) {}
     virtual void Draw(Layout *where);
+    static void Apply(Layout *where, coord a, coord x, coord y, coord z);
     coord amount, xaxis, yaxis, zaxis;
 };
 
@@ -68,6 +69,7 @@ struct Translation : Transform
     Translation(coord x, coord y, coord z):
         Transform(), xaxis(x), yaxis(y), zaxis(z) {}
     virtual void Draw(Layout *where);
+    static void Apply(coord x, coord y, coord z);
     coord xaxis, yaxis, zaxis;
 };
 
@@ -80,6 +82,7 @@ struct Scale : Transform
     Scale(scale x, scale y, scale z):
         Transform(), xaxis(x), yaxis(y), zaxis(z) {}
     virtual void Draw(Layout *where);
+    static void Apply(Layout *where, scale x, scale y, scale z);
     scale xaxis, yaxis, zaxis;
 };
 
@@ -0,0 +1,298 @@
+// ****************************************************************************
+//  vertex_array.cpp                                                Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Compact interleaved vertex formats used to submit geometry to OpenGL
+//
+//
+//
+//
+//
+//
+//
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "vertex_array.h"
+#include "opengl_state.h"
+#include <cstddef>
+
+
+TAO_BEGIN
+
+ulong VertexArray::submitted = 0;
+ulong VertexArray::uploaded = 0;
+ulong VertexArray::lastSubmitted = 0;
+ulong VertexArray::lastUploaded = 0;
+uint  VertexArray::contexts = 0;
+
+
+VertexArray::VertexArray()
+// ----------------------------------------------------------------------------
+//   Create an empty array in client memory
+// ----------------------------------------------------------------------------
+    : vertexBuffer(0), indexBuffer(0), context(0), resident(false)
+{}
+
+
+VertexArray::~VertexArray()
+// ----------------------------------------------------------------------------
+//   Release the buffer objects
+// ----------------------------------------------------------------------------
+{
+    ReleaseBuffers();
+}
+
+
+void VertexArray::Clear()
+// ----------------------------------------------------------------------------
+//   Forget all vertices, but keep the memory for the next use
+// ----------------------------------------------------------------------------
+{
+    ReleaseBuffers();
+    vertices.clear();
+    indices.clear();
+    resident = false;
+}
+
+
+void VertexArray::ReleaseBuffers()
+// ----------------------------------------------------------------------------
+//   Delete the buffer objects if they belong to the current context
+// ----------------------------------------------------------------------------
+//   Buffers created in a context that no longer exists are simply dropped.
+{
+    if (context == contexts)
+    {
+        if (vertexBuffer)
+            GL.DeleteBuffers(1, &vertexBuffer);
+        if (indexBuffer)
+            GL.DeleteBuffers(1, &indexBuffer);
+    }
+    vertexBuffer = 0;
+    indexBuffer = 0;
+}
+
+
+void VertexArray::Upload()
+// ----------------------------------------------------------------------------
+//   Copy the data in buffer objects if the GL supports them
+// ----------------------------------------------------------------------------
+{
+    resident = true;
+    ReleaseBuffers();
+    if (vertices.empty() || !GL.HasBuffers())
+        return;
+
+    ulong vsize = vertices.size() * sizeof(PackedVertex);
+    GL.GenBuffers(1, &vertexBuffer);
+    GL.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    GL.BufferData(GL_ARRAY_BUFFER, vsize, &vertices[0], GL_STATIC_DRAW);
+    GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+    uploaded += vsize;
+
+    if (!indices.empty())
+    {
+        ulong isize = indices.size() * sizeof(GLuint);
+        GL.GenBuffers(1, &indexBuffer);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        GL.BufferData(GL_ELEMENT_ARRAY_BUFFER, isize, &indices[0],
+                      GL_STATIC_DRAW);
+        GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        uploaded += isize;
+    }
+    context = contexts;
+}
+
+
+void VertexArray::Enable(uint64 textureUnits, bool normals)
+// ----------------------------------------------------------------------------
+//   Setup the vertex, normal and texture coordinates arrays
+// ----------------------------------------------------------------------------
+{
+    if (vertices.empty())
+        return;
+
+    // Recreate the buffers if they were lost with the previous context
+    if (resident && (!vertexBuffer || context != contexts))
+        Upload();
+
+    // Offsets in the buffer object, or addresses in client memory
+    size_t base = 0;
+    if (vertexBuffer)
+    {
+        GL.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        if (indexBuffer)
+            GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    }
+    else
+    {
+        base = (size_t) &vertices[0];
+    }
+
+    GLsizei stride = sizeof(PackedVertex);
+    size_t position = base + offsetof(PackedVertex, position);
+    size_t normal = base + offsetof(PackedVertex, normal);
+    size_t texture = base + offsetof(PackedVertex, texture);
+    GL.VertexPointer(3, GL_FLOAT, stride, (const GLvoid *) position);
+    GL.EnableClientState(GL_VERTEX_ARRAY);
+    if (normals)
+    {
+        GL.NormalPointer(GL_FLOAT, stride, (const GLvoid *) normal);
+        GL.EnableClientState(GL_NORMAL_ARRAY);
+    }
+
+    // Activate texture coordinates for all used units
+    textureUnits &= GL.ActiveTextureUnits();
+    for (uint i = 0; i < GL.MaxTextureCoords(); i++)
+    {
+        if (textureUnits & (1ULL << i))
+        {
+            GL.ClientActiveTexture(GL_TEXTURE0 + i);
+            GL.EnableClientState(GL_TEXTURE_COORD_ARRAY);
+            GL.TexCoordPointer(3, GL_FLOAT, stride, (const GLvoid *) texture);
+        }
+    }
+}
+
+
+void VertexArray::Render(GLenum mode)
+// ----------------------------------------------------------------------------
+//   Draw all the vertices with the arrays setup by Enable()
+// ----------------------------------------------------------------------------
+{
+    Render(mode, 0, indices.empty() ? vertices.size() : indices.size());
+}
+
+
+void VertexArray::Render(GLenum mode, uint first, uint count)
+// ----------------------------------------------------------------------------
+//   Draw a range of the indices, or of the vertices if there are no indices
+// ----------------------------------------------------------------------------
+//   The traffic for client memory counts each vertex once per draw call,
+//   which is what the driver has to copy in the worst case.
+{
+    if (!count)
+        return;
+
+    uint used = count;
+    if (indices.empty())
+    {
+        GL.DrawArrays(mode, first, count);
+    }
+    else
+    {
+        // With an index buffer, the index data is an offset in the buffer
+        const GLvoid *idata = indexBuffer
+            ? (const GLvoid *) (first * sizeof(GLuint))
+            : (const GLvoid *) (&indices[0] + first);
+        GL.DrawElements(mode, count, GL_UNSIGNED_INT, idata);
+        if (!indexBuffer)
+            submitted += count * sizeof(GLuint);
+        if (used > vertices.size())
+            used = vertices.size();
+    }
+    if (!vertexBuffer)
+        submitted += used * sizeof(PackedVertex);
+}
+
+
+void VertexArray::Render(GLenum mode, uint first, uint count, uint instances)
+// ----------------------------------------------------------------------------
+//   Draw a range of the indices several times in a single call
+// ----------------------------------------------------------------------------
+//   This requires GL_ARB_draw_instanced. The per-instance values are
+//   given to the current shader by the caller, with instanced arrays.
+{
+    if (!count || !instances || indices.empty())
+        return;
+
+    const GLvoid *idata = indexBuffer
+        ? (const GLvoid *) (first * sizeof(GLuint))
+        : (const GLvoid *) (&indices[0] + first);
+    GL.Sync();
+    glDrawElementsInstancedARB(mode, count, GL_UNSIGNED_INT, idata, instances);
+
+    uint used = count;
+    if (!indexBuffer)
+        submitted += count * sizeof(GLuint);
+    if (used > vertices.size())
+        used = vertices.size();
+    if (!vertexBuffer)
+        submitted += used * sizeof(PackedVertex);
+}
+
+
+void VertexArray::Disable(uint64 textureUnits, bool normals)
+// ----------------------------------------------------------------------------
+//   Disable the arrays enabled by Enable()
+// ----------------------------------------------------------------------------
+{
+    if (vertices.empty())
+        return;
+
+    GL.DisableClientState(GL_VERTEX_ARRAY);
+    if (normals)
+        GL.DisableClientState(GL_NORMAL_ARRAY);
+
+    textureUnits &= GL.ActiveTextureUnits();
+    for (uint i = 0; i < GL.MaxTextureCoords(); i++)
+    {
+        if (textureUnits & (1ULL << i))
+        {
+            GL.ClientActiveTexture(GL_TEXTURE0 + i);
+            GL.DisableClientState(GL_TEXTURE_COORD_ARRAY);
+        }
+    }
+
+    // Restore the client active texture
+    GL.ClientActiveTexture(GL_TEXTURE0);
+
+    if (vertexBuffer)
+    {
+        GL.BindBuffer(GL_ARRAY_BUFFER, 0);
+        if (indexBuffer)
+            GL.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+
+void VertexArray::Draw(GLenum mode, uint64 textureUnits, bool normals)
+// ----------------------------------------------------------------------------
+//   Draw all the vertices
+// ----------------------------------------------------------------------------
+{
+    Enable(textureUnits, normals);
+    Render(mode);
+    Disable(textureUnits, normals);
+}
+
+
+ulong VertexArray::Size()
+// ----------------------------------------------------------------------------
+//   Return the number of bytes used by the vertices and indices
+// ----------------------------------------------------------------------------
+{
+    return vertices.size() * sizeof(PackedVertex)
+        +  indices.size() * sizeof(GLuint);
+}
+
+
+void VertexArray::NewFrame()
+// ----------------------------------------------------------------------------
+//   Record the traffic for the frame that just ended and restart counting
+// ----------------------------------------------------------------------------
+{
+    lastSubmitted = submitted;
+    lastUploaded = uploaded;
+    submitted = 0;
+    uploaded = 0;
+}
+
+TAO_END
@@ -0,0 +1,121 @@
+#ifndef VERTEX_ARRAY_H
+#define VERTEX_ARRAY_H
+// ****************************************************************************
+//  vertex_array.h                                                  Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Compact interleaved vertex formats used to submit geometry to OpenGL
+//
+//     Geometry is computed in double precision, but OpenGL converts it to
+//     single precision anyway. Packing it once into interleaved floats
+//     halves the memory traffic of each draw call, and lets static data
+//     such as meshes live in buffer objects.
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tao.h"
+#include "base.h"
+#include "coords3d.h"
+#include "tao_gl.h"
+#include <vector>
+
+
+TAO_BEGIN
+
+struct PackedVertex
+// ----------------------------------------------------------------------------
+//   Position, normal and texture coordinates of a vertex as floats
+// ----------------------------------------------------------------------------
+//   Texture coordinates keep three components because paths pass the
+//   position normalized to their bounds, including along z.
+{
+    PackedVertex() {}
+    PackedVertex(const Point3 &p, const Vector3 &n, const Point3 &t)
+    {
+        position[0] = p.x;  position[1] = p.y;  position[2] = p.z;
+        normal[0]   = n.x;  normal[1]   = n.y;  normal[2]   = n.z;
+        texture[0]  = t.x;  texture[1]  = t.y;  texture[2]  = t.z;
+    }
+
+    GLfloat             position[3];
+    GLfloat             normal[3];
+    GLfloat             texture[3];
+};
+
+
+struct GlyphVertex
+// ----------------------------------------------------------------------------
+//   Position and texture coordinates of a glyph quad corner
+// ----------------------------------------------------------------------------
+{
+    GlyphVertex(coord x, coord y, coord z, coord s, coord t)
+    {
+        position[0] = x;    position[1] = y;    position[2] = z;
+        texture[0]  = s;    texture[1]  = t;
+    }
+
+    GLfloat             position[3];
+    GLfloat             texture[2];
+};
+
+
+struct VertexArray
+// ----------------------------------------------------------------------------
+//   Interleaved vertices and optional indices, possibly in buffer objects
+// ----------------------------------------------------------------------------
+//   The client copy is kept after upload, so that the buffers can be
+//   recreated transparently when the GL context changes.
+{
+    typedef std::vector<PackedVertex>   Vertices;
+    typedef std::vector<GLuint>         Indices;
+
+public:
+    VertexArray();
+    ~VertexArray();
+
+    void                Clear();
+    void                Upload();
+    void                Enable(uint64 textureUnits, bool normals = true);
+    void                Render(GLenum mode);
+    void                Render(GLenum mode, uint first, uint count);
+    void                Render(GLenum mode, uint first, uint count,
+                               uint instances);
+    void                Disable(uint64 textureUnits, bool normals = true);
+    void                Draw(GLenum mode, uint64 textureUnits,
+                             bool normals = true);
+    bool                Empty()         { return vertices.empty(); }
+    ulong               Size();
+
+public:
+    Vertices            vertices;
+    Indices             indices;        // If empty, draw vertices in order
+
+protected:
+    void                ReleaseBuffers();
+
+protected:
+    GLuint              vertexBuffer;
+    GLuint              indexBuffer;
+    uint                context;        // Context the buffers belong to
+    bool                resident;       // Keep the data in buffer objects
+
+public:
+    static void         Submitted(ulong bytes)  { submitted += bytes; }
+    static void         ContextChanged()        { contexts++; }
+    static void         NewFrame();
+
+public:
+    static ulong        submitted, uploaded;
+    static ulong        lastSubmitted, lastUploaded;
+    static uint         contexts;
+};
+
+TAO_END
+
+#endif // VERTEX_ARRAY_H
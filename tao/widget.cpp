@@ -61,6 +61,7 @@
 #include "undo.h"
 #include "serializer.h"
 #include "binpack.h"
+#include "drawing_arena.h"
 #include "normalize.h"
 #include "error_message_dialog.h"
 #include "group_layout.h"
@@ -255,6 +256,7 @@ Widget::Widget(QWidget *parent, SourceFile *sf)
       dfltRefresh(0.0), idleTimer(this),
       pageStartTime(DBL_MAX), frozenTime(DBL_MAX), startTime(DBL_MAX),
       currentTime(DBL_MAX), stats(), frameCounter(0),
+      skipUnchangedFrames(true), framesSkipped(0),
       nextSave(now()), nextSync(nextSave),
 #ifndef CFG_NOGIT
       nextCommit(nextSave),
@@ -505,6 +507,7 @@ Widget::Widget(Widget &o, const QGLFormat &format)
       startTime(o.startTime),
       currentTime(o.currentTime), stats(o.stats.isEnabled()),
       frameCounter(o.frameCounter),
+      skipUnchangedFrames(o.skipUnchangedFrames), framesSkipped(0),
       nextSave(o.nextSave), nextSync(o.nextSync),
 #ifndef CFG_NOGIT
       nextCommit(o.nextCommit),
@@ -597,6 +600,10 @@ Widget::Widget(Widget &o, const QGLFormat &format)
     // clear them here so that textures or GL lists created with the
     // previous context are not re-used with the new.
     TextureCache::instance()->clear();
+    ShapeMesh::Clear();
+    VertexArray::ContextChanged();
+    GlyphCache::ContextChanged();
+    Instances::ContextChanged();
     if (o.watermark)
         GL.DeleteTextures(1, &o.watermark);
 
@@ -1033,6 +1040,15 @@ void Widget::draw()
     stats.end(Statistics::DRAW);
     stats.end(Statistics::FRAME);
     frameCounter++;
+    DrawingArena::NewFrame();
+    Layout::NewFrame();
+    ShapeMesh::NewFrame();
+    VertexArray::NewFrame();
+    MeshCache::NewFrame();
+    ExtrusionCache::cache.NewFrame();
+    OutlineCache::cache.NewFrame();
+    TesselationCache::cache.NewFrame();
+    glyphCache.NewFrame();
 
     // Remember number of elements drawn for GL selection buffer capacity
     if (maxId < id + 100 || maxId > 2 * (id + 100))
@@ -1275,6 +1291,24 @@ bool Widget::refreshNow(QEvent *event)
         space->CheckRefreshDeps();
     }
 
+    // Instance values set by modules change the frame but not the layouts
+    if (Instances::buffersChanged)
+    {
+        Instances::buffersChanged = false;
+        changed = true;
+    }
+
+    // Nothing to redraw if a timer or user event did not change any layout
+    if (!changed && event && skipUnchangedFrames && !transitionStartTime &&
+        (event->type() == QEvent::Timer || event->type() >= QEvent::User) &&
+        !stats.isEnabled(Statistics::TO_SCREEN))
+    {
+        IFTRACE(layoutevents)
+            std::cerr << "Nothing changed, frame skipped\n";
+        framesSkipped++;
+        return changed;
+    }
+
     if (!inOfflineRendering)
     {
         // Redraw all
@@ -1385,6 +1419,9 @@ bool Widget::RenderingTransparencyAPI()
 // ----------------------------------------------------------------------------
 {
     Widget *widget = findTaoWidget();
+
+    // The module draws differently in each pass, don't skip the second one
+    Layout::TransparencyCheck(true);
     return widget->layout->transparency;
 }
 
@@ -1560,12 +1597,14 @@ void Widget::processProgramEvents()
 //   Process registered program events
 // ----------------------------------------------------------------------------
 {
-    LayoutState::qevent_ids refreshEvents = space->RefreshEvents();
     IFTRACE(layoutevents)
-            std::cerr << "Program events: "
-            << LayoutState::ToText(refreshEvents) << "\n";
+    {
+        LayoutState::qevent_ids refreshEvents = space->RefreshEvents();
+        std::cerr << "Program events: "
+                  << LayoutState::ToText(refreshEvents) << "\n";
+    }
     // Trigger mouse tracking only if needed
-    bool mouseTracking = (refreshEvents.count(QEvent::MouseMove) != 0);
+    bool mouseTracking = space->HasRefreshEvent(QEvent::MouseMove);
     if (mouseTracking)
         setMouseTracking(true);
     // Make sure refresh timer is restarted if needed
@@ -2980,12 +3019,12 @@ uint Widget::showGlErrors()
 }
 
 
-QFont &Widget::currentFont()
+const QFont &Widget::currentFont()
 // ----------------------------------------------------------------------------
 //   Return the font currently in use (the one in the current layout)
 // ----------------------------------------------------------------------------
 {
-    return layout->font;
+    return layout->Font();
 }
 
 
@@ -3808,8 +3847,7 @@ void Widget::mouseMoveEvent(QMouseEvent *event)
     if (cursor().shape() == Qt::BlankCursor)
     {
         setCursor(savedCursorShape);
-        LayoutState::qevent_ids refreshEvents = space->RefreshEvents();
-        bool mouseTracking = (refreshEvents.count(QEvent::MouseMove) != 0);
+        bool mouseTracking = space->HasRefreshEvent(QEvent::MouseMove);
         if (!mouseTracking)
             setMouseTracking(false);
         if (bAutoHideCursor)
@@ -5365,6 +5403,66 @@ void Widget::printStatistics()
     RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17 - 17);
     RasterText::printf("Program memory %5dK reserved %5dK used %5dK freed",
                        tot>>10, alloc>>10, freed>>10);
+
+    // Display drawing allocation statistics for the last frame
+    const DrawingArena::Stats &da = DrawingArena::LastFrame();
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17 - 17 - 17);
+    RasterText::printf("Drawings %6lu live %5luK used %5luK reserved, "
+                       "frame %5lu new %5luK %5lu freed",
+                       DrawingArena::LiveObjects(),
+                       DrawingArena::LiveBytes()>>10,
+                       DrawingArena::Reserved()>>10,
+                       da.objects, da.bytes>>10, da.freed);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17 - 17 - 17 - 17);
+    RasterText::printf("Layouts skipped in transparent pass %5u",
+                       Layout::lastTransparentSkipped);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17 - 17 - 17 - 17 - 17);
+    RasterText::printf("Layouts culled %5u drawn %5u",
+                       Layout::lastLayoutsCulled, Layout::lastLayoutsDrawn);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*6);
+    RasterText::printf("Shape meshes %4u %5luK, frame %5u hits %5u misses",
+                       ShapeMesh::cache.Count(), ShapeMesh::cache.bytes >> 10,
+                       ShapeMesh::cache.lastHits, ShapeMesh::cache.lastMisses);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*7);
+    RasterText::printf("Vertex data per frame %6luK submitted %6luK uploaded",
+                       VertexArray::lastSubmitted >> 10,
+                       VertexArray::lastUploaded >> 10);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*8);
+    RasterText::printf("Mesh cache %4u meshes %5luK, frame %7lu vertices",
+                       MeshCache::cache.Count(),
+                       MeshCache::cache.bytes >> 10, MeshCache::lastVertices);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*9);
+    RasterText::printf("Extrusions %4u %5luK, frame %5u hits %5u misses",
+                       ExtrusionCache::cache.Count(),
+                       ExtrusionCache::cache.bytes >> 10,
+                       ExtrusionCache::cache.lastHits,
+                       ExtrusionCache::cache.lastMisses);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*10);
+    RasterText::printf("Outlines %6u %5luK, frame %5u hits %5u misses",
+                       OutlineCache::cache.Count(),
+                       OutlineCache::cache.bytes >> 10,
+                       OutlineCache::cache.lastHits,
+                       OutlineCache::cache.lastMisses);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*11);
+    RasterText::printf("Tesselations %2u %5luK, frame %5u hits %5u misses",
+                       TesselationCache::cache.Count(),
+                       TesselationCache::cache.bytes >> 10,
+                       TesselationCache::cache.lastHits,
+                       TesselationCache::cache.lastMisses);
+
+    RasterText::moveTo(vx + 20, vy + vh - 20 - 10 - 17*12);
+    RasterText::printf("Glyph atlas %3u pages, frame %5lu rasterized "
+                       "%5lu evicted %5lu loaded",
+                       glyphCache.PageCount(), glyphCache.lastRasterized,
+                       glyphCache.lastEvicted, glyphCache.lastLoaded);
 }
 
 
@@ -5482,7 +5580,15 @@ void Widget::logStatistics()
         if (printHeader)
         {
             std::cout << "Time;PageNum;FPS;Exec;MaxExec;Draw;MaxDraw;GC;MaxGC;"
-                         "Select;MaxSelect";
+                         "Select;MaxSelect;Drawings;DrawingBytes;"
+                         "TransparentSkipped;LayoutsCulled;LayoutsDrawn;"
+                         "FramesSkipped;ShapeMeshHits;ShapeMeshMisses;"
+                         "ShapeMeshBytes;VertexBytes;VertexUploadBytes;"
+                         "MeshCacheBytes;MeshVertices;ExtrusionHits;"
+                         "ExtrusionMisses;ExtrusionBytes;OutlineHits;"
+                         "OutlineMisses;OutlineBytes;TesselationHits;"
+                         "TesselationMisses;TesselationBytes;GlyphPages;"
+                         "GlyphsRasterized;GlyphsEvicted;GlyphsLoaded";
             if (XL::MAIN->options.threaded_gc)
                 std::cout << ";GCWait;MaxGCWait";
 #ifdef MACOSX_DISPLAYLINK
@@ -5501,7 +5607,33 @@ void Widget::logStatistics()
                   << stats.averageTimePerFrame(Statistics::GC) << ";"
                   << stats.maxTime(Statistics::GC) << ";"
                   << stats.averageTimePerFrame(Statistics::SELECT) << ";"
-                  << stats.maxTime(Statistics::SELECT);
+                  << stats.maxTime(Statistics::SELECT) << ";"
+                  << DrawingArena::LastFrame().objects << ";"
+                  << DrawingArena::LastFrame().bytes << ";"
+                  << Layout::lastTransparentSkipped << ";"
+                  << Layout::lastLayoutsCulled << ";"
+                  << Layout::lastLayoutsDrawn << ";"
+                  << framesSkipped << ";"
+                  << ShapeMesh::cache.lastHits << ";"
+                  << ShapeMesh::cache.lastMisses << ";"
+                  << ShapeMesh::cache.bytes << ";"
+                  << VertexArray::lastSubmitted << ";"
+                  << VertexArray::lastUploaded << ";"
+                  << MeshCache::cache.bytes << ";"
+                  << MeshCache::lastVertices << ";"
+                  << ExtrusionCache::cache.lastHits << ";"
+                  << ExtrusionCache::cache.lastMisses << ";"
+                  << ExtrusionCache::cache.bytes << ";"
+                  << OutlineCache::cache.lastHits << ";"
+                  << OutlineCache::cache.lastMisses << ";"
+                  << OutlineCache::cache.bytes << ";"
+                  << TesselationCache::cache.lastHits << ";"
+                  << TesselationCache::cache.lastMisses << ";"
+                  << TesselationCache::cache.bytes << ";"
+                  << glyphCache.PageCount() << ";"
+                  << glyphCache.lastRasterized << ";"
+                  << glyphCache.lastEvicted << ";"
+                  << glyphCache.lastLoaded;
 
         if (XL::MAIN->options.threaded_gc)
         {
@@ -5610,13 +5742,13 @@ void Widget::saveSelectionColorAndFont(Layout *where)
 {
     if (where && where->id)
     {
-        selectionColor["line_color"] = where->lineColor;
-        selectionColor["color"] = where->fillColor;
-        selectionFont = where->font;
+        selectionColor["line_color"] = where->LineColor();
+        selectionColor["color"] = where->FillColor();
+        selectionFont = where->Font();
         IFTRACE (fonts)
         {
             std::cerr << "Widget::saveSelectionColorAndFont(" << where->id
-                    << ") font : " << +where->font.toString() << std::endl;
+                    << ") font : " << +where->Font().toString() << std::endl;
         }
     }
 }
@@ -5914,9 +6046,9 @@ static inline void resetLayout(Layout *where)
     if (where)
     {
         where->lineWidth = 1;
-        where->lineColor = Color(0,0,0,0);
-        where->fillColor = Color(0,1,0,0.8);
-        where->programId = 0;
+        where->ColorState().lineColor = Color(0,0,0,0);
+        where->ColorState().fillColor = Color(0,1,0,0.8);
+        where->ColorState().programId = 0;
     }
 }
 
@@ -7118,7 +7250,7 @@ Tree_p Widget::rotate(Tree_p self, Real_p ra, Real_p rx, Real_p ry, Real_p rz)
 {
     // Check that matrix mode is modelview
     if (GL.matrixMode == GL_MODELVIEW)
-        layout->model.Rotate(ra, rx, ry, rz);
+        layout->TransformState().model.Rotate(ra, rx, ry, rz);
 
     layout->Add(new Rotation(ra, rx, ry, rz));
     return XL::xl_true;
@@ -7159,7 +7291,7 @@ Tree_p Widget::translate(Tree_p self, Real_p tx, Real_p ty, Real_p tz)
 {
     // Check that matrix mode is modelview
     if (GL.matrixMode == GL_MODELVIEW)
-        layout->model.Translate(tx, ty, tz);
+        layout->TransformState().model.Translate(tx, ty, tz);
 
     layout->Add(new Translation(tx, ty, tz));
     return XL::xl_true;
@@ -7200,7 +7332,7 @@ Tree_p Widget::rescale(Tree_p self, Real_p sx, Real_p sy, Real_p sz)
 {
     // Check that matrix mode is modelview
     if (GL.matrixMode == GL_MODELVIEW)
-        layout->model.Scale(sx, sy, sz);
+        layout->TransformState().model.Scale(sx, sy, sz);
 
     layout->Add(new Scale(sx, sy, sz));
     return XL::xl_true;
@@ -7483,6 +7615,30 @@ Real_p Widget::defaultCurveSteps(Tree_p self, scale min, scale incr, scale max)
 }
 
 
+Real_p Widget::levelOfDetail(Tree_p self, scale pixels)
+// ----------------------------------------------------------------------------
+//   Set the pixels per subdivision for curved shapes, returns previous one
+// ----------------------------------------------------------------------------
+{
+    scale prev = Shape::lodPixels;
+    if (pixels >= 0.0)
+        Shape::lodPixels = pixels;
+    return new Real(prev, self->Position());
+}
+
+
+Real_p Widget::curveFlatness(Tree_p self, scale pixels)
+// ----------------------------------------------------------------------------
+//   Set the maximum error when flattening curves, returns previous one
+// ----------------------------------------------------------------------------
+{
+    scale prev = GraphicPath::flatness;
+    if (pixels >= 0.0)
+        GraphicPath::flatness = pixels;
+    return new Real(prev, self->Position());
+}
+
+
 double Widget::optimalDefaultRefresh()
 // ----------------------------------------------------------------------------
 //    Set default refresh for best results
@@ -7663,8 +7819,7 @@ Name_p Widget::autoHideCursor(XL::Tree_p self, bool ah)
     else
     {
         setCursor(savedCursorShape);
-        LayoutState::qevent_ids refreshEvents = space->RefreshEvents();
-        bool mouseTracking = (refreshEvents.count(QEvent::MouseMove) != 0);
+        bool mouseTracking = space->HasRefreshEvent(QEvent::MouseMove);
         if (!mouseTracking)
             setMouseTracking(false);
     }
@@ -8139,7 +8294,8 @@ Infix_p Widget::currentModelMatrix(Tree_p self)
 //   Return the current model matrix converting from object to world space
 // ----------------------------------------------------------------------------
 {
-    Tree *result = xl_real_list(self, 16, layout->model.Data(false));
+    Matrix4 model = layout->Model();
+    Tree *result = xl_real_list(self, 16, model.Data(false));
     return result->AsInfix();
 }
 
@@ -8275,6 +8431,86 @@ XL::Integer_p  Widget::polygonOffset(Tree_p self,
 }
 
 
+Integer_p Widget::transparentLayoutsSkipped(Tree_p self)
+// ----------------------------------------------------------------------------
+//   The number of opaque layouts skipped in the transparent pass last frame
+// ----------------------------------------------------------------------------
+{
+    return new Integer(Layout::lastTransparentSkipped);
+}
+
+
+Name_p Widget::compileLayouts(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable drawing from compiled command streams
+// ----------------------------------------------------------------------------
+{
+    bool old = Layout::compileDrawings;
+    Layout::compileDrawings = enable;
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
+Name_p Widget::cullLayouts(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable view frustum culling of layouts
+// ----------------------------------------------------------------------------
+{
+    bool old = Layout::cullLayouts;
+    Layout::cullLayouts = enable;
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
+Integer_p Widget::layoutsDrawn(Tree_p self)
+// ----------------------------------------------------------------------------
+//   The number of layouts found in the view and drawn in the last frame
+// ----------------------------------------------------------------------------
+{
+    return new Integer(Layout::lastLayoutsDrawn);
+}
+
+
+Integer_p Widget::layoutsCulled(Tree_p self)
+// ----------------------------------------------------------------------------
+//   The number of layouts found outside of the view in the last frame
+// ----------------------------------------------------------------------------
+{
+    return new Integer(Layout::lastLayoutsCulled);
+}
+
+
+Integer_p Widget::layoutStateCopies(Tree_p self)
+// ----------------------------------------------------------------------------
+//   The number of copies of state shared between layouts in the last frame
+// ----------------------------------------------------------------------------
+{
+    return new Integer(LayoutSharedState::lastCopies);
+}
+
+
+Name_p Widget::skipUnchanged(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable skipping redraws when refresh events change nothing
+// ----------------------------------------------------------------------------
+{
+    bool old = skipUnchangedFrames;
+    skipUnchangedFrames = enable;
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
+Name_p Widget::cacheShapeMeshes(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable drawing 2D shapes from shared meshes
+// ----------------------------------------------------------------------------
+{
+    bool old = ShapeMesh::enabled;
+    ShapeMesh::enabled = enable;
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
 #if defined(Q_OS_MACX)
 #include <OpenGL.h>
 #endif
@@ -9320,7 +9556,7 @@ Tree_p Widget::shaderSet(Context *context, Tree_p self, Tree_p code)
 //   Evaluate the code argument as an assignment for the current shader
 // ----------------------------------------------------------------------------
 {
-    GLuint programId = layout->programId;
+    GLuint programId = layout->ProgramId();
     if (!programId)
     {
         Ooops("No shader program for $1", self);
@@ -10363,6 +10599,126 @@ Tree_p Widget::cone(Tree_p self,
 }
 
 
+static inline bool instance_list(Tree *tree)
+// ----------------------------------------------------------------------------
+//   Check if a tree is an infix separating values in a list
+// ----------------------------------------------------------------------------
+{
+    if (Infix *infix = tree->AsInfix())
+        return infix->name == "," || infix->name == ";" || infix->name == "\n";
+    return false;
+}
+
+
+static bool instance_values(Context *context, Tree_p values,
+                            Instances::Data &data)
+// ----------------------------------------------------------------------------
+//   Append the numbers in a comma-separated list of values to data
+// ----------------------------------------------------------------------------
+//   We loop on the right of the list rather than recurse on it, so that
+//   long lists don't exhaust the stack. Only nested lists are recursive.
+{
+    while (values)
+    {
+        Tree_p value = values;
+        if (Block *block = values->AsBlock())
+        {
+            values = block->child;
+            continue;
+        }
+        if (instance_list(values))
+        {
+            Infix *infix = values->AsInfix();
+            value = infix->left;
+            values = infix->right;
+        }
+        else
+        {
+            values = NULL;
+        }
+
+        // Evaluate expressions, which may return a number or a list
+        if (!value->IsConstant() && !value->AsBlock() && !instance_list(value))
+        {
+            value = context->Evaluate(value);
+            if (value->AsInfix() && !instance_list(value))
+                return false;
+        }
+
+        if (value->AsBlock() || instance_list(value))
+        {
+            if (!values)
+                values = value;
+            else if (!instance_values(context, value, data))
+                return false;
+        }
+        else if (XL::Real *asReal = value->AsReal())
+        {
+            data.push_back(asReal->value);
+        }
+        else if (XL::Integer *asInteger = value->AsInteger())
+        {
+            data.push_back(asInteger->value);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+Tree_p Widget::instances(Context *context, Tree_p self, text shape,
+                         Integer_p slices, Integer_p stacks, double ratio,
+                         Tree_p values)
+// ----------------------------------------------------------------------------
+//   Many copies of a 3D shape with their own position, size and color
+// ----------------------------------------------------------------------------
+//   The values are either a list with x, y, z, w, h, d, r, g, b, a for each
+//   instance, or the name of a buffer filled by a module.
+{
+    uint sl = slices, st = stacks;
+    if (sl < MeshBased::MIN_SLICES)
+        sl = MeshBased::MIN_SLICES;
+    if (st < MeshBased::MIN_STACKS)
+        st = MeshBased::MIN_STACKS;
+
+    MeshCache::Key key(MeshCache::CUBE, 0, 0, 0.0);
+    if (shape == "sphere")
+        key = MeshCache::Key(MeshCache::SPHERE, sl, st, 0.0);
+    else if (shape == "torus")
+        key = MeshCache::Key(MeshCache::TORUS, sl, st, ratio);
+    else if (shape == "cone")
+        key = MeshCache::Key(MeshCache::CONE, sl, 0, ratio);
+    else if (shape == "cylinder")
+        key = MeshCache::Key(MeshCache::CONE, sl, 0, 1.0);
+    else if (shape != "cube")
+    {
+        Ooops("Unknown instance shape $2 for $1", self).Arg(shape);
+        return XL::xl_false;
+    }
+
+    Instances *instances = new Instances(key);
+    if (!values->IsConstant() && !values->AsInfix() && !values->AsBlock())
+        values = context->Evaluate(values);
+    if (Text *name = values->AsText())
+    {
+        instances->buffer = name->value;
+    }
+    else if (!instance_values(context, values, instances->data) ||
+             instances->data.size() % Instances::STRIDE)
+    {
+        delete instances;
+        Ooops("Malformed instance values for $1: $2", self, values);
+        return XL::xl_false;
+    }
+
+    layout->Add(instances);
+    return XL::xl_true;
+}
+
+
 bool Widget::addControlBox(Real *x, Real *y, Real *z,
                            Real *w, Real *h, Real *d)
 // ----------------------------------------------------------------------------
@@ -10653,11 +11009,12 @@ Tree_p Widget::font(Context *context, Tree_p self,
 //   Select a font family
 // ----------------------------------------------------------------------------
 {
-    QFont &font = layout->font;
-    FontParsingAction parseFont(context, font);
+    // Parsing may evaluate code that changes the layout's text state
+    FontParsingAction parseFont(context, layout->Font());
     descr1->Do(parseFont);
     if (descr2)
         descr2->Do(parseFont);
+    QFont &font = layout->TextState().font;
     font = parseFont.font;
     layout->Add(new FontChange(font));
     if (fontFileMgr)
@@ -10690,8 +11047,8 @@ Tree_p Widget::fontSize(Tree_p self, double size)
 //   Select a font size
 // ----------------------------------------------------------------------------
 {
-    layout->font.setPointSizeF(fontSizeAdjust(size));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setPointSizeF(fontSizeAdjust(size));
+    layout->Add(new FontChange(layout->Font()));
     return XL::xl_true;
 }
 
@@ -10701,7 +11058,7 @@ Tree_p Widget::fontPlain(Tree_p self)
 //   Select whether this is italic or not
 // ----------------------------------------------------------------------------
 {
-    QFont &font = layout->font;
+    QFont &font = layout->TextState().font;
     font.setStyle(QFont::StyleNormal);
     font.setWeight(QFont::Normal);
     font.setStretch(QFont::Unstretched);
@@ -10731,8 +11088,8 @@ Tree_p Widget::fontItalic(Tree_p self, scale amount)
 //   Qt italic values range from 0 (Normal) to 2 (Oblique)
 {
     amount = clamp(amount, 0, 2);
-    layout->font.setStyle(QFont::Style(amount));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setStyle(QFont::Style(amount));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -10744,8 +11101,8 @@ Tree_p Widget::fontBold(Tree_p self, scale amount)
 //   Qt weight values range from 0 to 99 with 50 = regular
 {
     amount = clamp(amount, 0, 99);
-    layout->font.setWeight(/*QFont::Weight*/(amount));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setWeight(/*QFont::Weight*/(amount));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -10756,8 +11113,8 @@ Tree_p Widget::fontUnderline(Tree_p self, scale amount)
 // ----------------------------------------------------------------------------
 //    Qt doesn't support setting the size of the underline, it's on or off
 {
-    layout->font.setUnderline(bool(amount));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setUnderline(bool(amount));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -10768,8 +11125,8 @@ Tree_p Widget::fontOverline(Tree_p self, scale amount)
 // ----------------------------------------------------------------------------
 //    Qt doesn't support setting the size of the overline, it's on or off
 {
-    layout->font.setOverline(bool(amount));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setOverline(bool(amount));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -10780,8 +11137,8 @@ Tree_p Widget::fontStrikeout(Tree_p self, scale amount)
 // ----------------------------------------------------------------------------
 //    Qt doesn't support setting the size of the strikeout, it's on or off
 {
-    layout->font.setStrikeOut(bool(amount));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setStrikeOut(bool(amount));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -10793,8 +11150,8 @@ Tree_p Widget::fontStretch(Tree_p self, scale amount)
 //    Qt font stretch ranges from 0 to 4000, with 100 = 100%.
 {
     amount = clamp(amount, 0, 40);
-    layout->font.setStretch(int(amount * 100));
-    layout->Add(new FontChange(layout->font));
+    layout->TextState().font.setStretch(int(amount * 100));
+    layout->Add(new FontChange(layout->Font()));
     return self;
 }
 
@@ -11105,12 +11462,55 @@ Tree_p Widget::glyphCacheScaling(Tree_p self, double scaling, double minAASize)
 }
 
 
+Tree_p Widget::glyphCachePages(Tree_p self, uint maxPages, uint pageSize)
+// ----------------------------------------------------------------------------
+//   Change the number and size of the glyph atlas pages
+// ----------------------------------------------------------------------------
+{
+    if (maxPages < 1)
+        maxPages = 1;
+    glyphCache.maxPages = maxPages;
+    glyphCache.pageSize = pageSize;
+    return XL::xl_true;
+}
+
+
+Name_p Widget::glyphCacheDistanceField(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable distance field glyphs in the glyph cache
+// ----------------------------------------------------------------------------
+{
+    bool old = glyphCache.sdf;
+    if (old != enable)
+    {
+        glyphCache.Clear();
+        glyphCache.sdf = enable;
+    }
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
+Name_p Widget::glyphCacheDisk(Tree_p self, bool enable)
+// ----------------------------------------------------------------------------
+//   Enable or disable the storage of cached glyphs on disk
+// ----------------------------------------------------------------------------
+{
+    bool old = glyphCache.diskCache;
+    if (old != enable)
+    {
+        glyphCache.Clear();
+        glyphCache.diskCache = enable;
+    }
+    return old ? XL::xl_true : XL::xl_false;
+}
+
+
 Integer_p Widget::glyphCacheTexture(Tree_p self)
 // ----------------------------------------------------------------------------
 //   Return a texture corresponding to the glyph cache contents
 // ----------------------------------------------------------------------------
 {
-    uint textureID = glyphCache.Texture();
+    uint textureID = glyphCache.Texture(0);
     layout->Add(new FillTexture(textureID, GL_TEXTURE_RECTANGLE_ARB));
     return new Integer(textureID, self->Position());
 }
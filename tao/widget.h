@@ -197,7 +197,7 @@ public:
     void        identifySelection();
     void        updateSelection();
     uint        showGlErrors();
-    QFont &     currentFont();
+    const QFont &currentFont();
     QPrinter *  currentPrinter() { return printer; }
     double      printerScaling() { return (printer
                                            ? printOverscaling
@@ -467,6 +467,8 @@ public:
     Tree_p      defaultRefresh(Tree_p self, double delay);
     Real_p      refreshTime(Tree_p self);
     Real_p      defaultCurveSteps(Tree_p self,scale min,scale incr,scale max);
+    Real_p      levelOfDetail(Tree_p self, scale pixels);
+    Real_p      curveFlatness(Tree_p self, scale pixels);
     Tree_p      postEvent(int eventType, bool once = false);
     Integer_p   registerUserEvent(text name);
     Name_p      addLayoutName(text name);
@@ -530,6 +532,14 @@ public:
     Name_p      enableStereoscopyText(Tree_p self, text name);
     Integer_p   polygonOffset(Tree_p self,
                               double f0, double f1, double u0, double u1);
+    Integer_p   transparentLayoutsSkipped(Tree_p self);
+    Name_p      compileLayouts(Tree_p self, bool enable);
+    Name_p      cullLayouts(Tree_p self, bool enable);
+    Integer_p   layoutsDrawn(Tree_p self);
+    Integer_p   layoutsCulled(Tree_p self);
+    Integer_p   layoutStateCopies(Tree_p self);
+    Name_p      skipUnchanged(Tree_p self, bool enable);
+    Name_p      cacheShapeMeshes(Tree_p self, bool enable);
     Name_p      enableVSync(Tree_p self, bool enable);
     double      optimalDefaultRefresh();
     bool        VSyncEnabled();
@@ -708,6 +718,9 @@ public:
     Tree_p      cone(Tree_p self, Real_p cx, Real_p cy, Real_p cz,
                      Real_p w, Real_p h, Real_p d,
                      double ratio);
+    Tree_p      instances(Context *context, Tree_p self, text shape,
+                          Integer_p nslices, Integer_p nstacks, double ratio,
+                          Tree_p values);
 
     // Text and font
     Tree_p      textBox(Context *context, Tree_p self,
@@ -752,6 +765,9 @@ public:
     Name_p      enableGlyphCache(Tree_p self, bool enable);
     Tree_p      glyphCacheSizeRange(Tree_p self, double min, double max);
     Tree_p      glyphCacheScaling(Tree_p self, double scaling, double minSize);
+    Tree_p      glyphCachePages(Tree_p self, uint maxPages, uint pageSize);
+    Name_p      glyphCacheDistanceField(Tree_p self, bool enable);
+    Name_p      glyphCacheDisk(Tree_p self, bool enable);
     Integer_p   glyphCacheTexture(Tree_p self);
     Text_p      unicodeChar(Tree_p self, int code);
     Text_p      unicodeCharText(Tree_p self, text code);
@@ -1144,6 +1160,8 @@ private:
     double                pageStartTime, frozenTime, startTime, currentTime;
     Statistics            stats;
     longlong              frameCounter;
+    bool                  skipUnchangedFrames;
+    ulonglong             framesSkipped;
     ulonglong             nextSave, nextSync;
 #ifndef CFG_NOGIT
     ulonglong             nextCommit, nextPull;
@@ -19,6 +19,10 @@ function runOneTest()
     #echo "$testName/$testName.ddd"
     eval "$TAO $testName/$testName.ddd"
     res=$?
+    if [[ $res != 0 ]] ;
+    then
+        echo "$testName: exited with status $res"
+    fi
     if [[ -f $testName/$testName.ddd-orig ]] ;
     then
         lastRun = findLastRun $testName
@@ -0,0 +1,47 @@
+# ******************************************************************************
+#  tesselator.pro                                                    Tao project
+# ******************************************************************************
+# File Description:
+# Qt build file for the tesselator correctness and speed test
+#
+# The test triangulates shapes and text outlines with both the GLU
+# tesselator and ours, checks both results against the winding rule,
+# and compares triangle counts and timings.
+# ******************************************************************************
+# This software is licensed under the GNU General Public License v3.
+# See file COPYING for details.
+# (C) 2013 Taodyne SAS
+# ******************************************************************************
+
+include(../../main.pri)
+
+TEMPLATE = app
+TARGET   = tesselator_test
+CONFIG  += console
+CONFIG  -= app_bundle
+QT      += opengl
+greaterThan(QT_MAJOR_VERSION, 4) { QT += widgets }
+
+INC = . \
+    ../../tao \
+    ../../tao/xlr/xlr/include \
+    ../../tao/include \
+    ../../tao/include/tao
+DEPENDPATH  += $$INC
+INCLUDEPATH += $$INC
+
+HEADERS += ../../tao/tesselator.h
+SOURCES += tesselator_test.cpp \
+    ../../tao/tesselator.cpp
+
+linux-g++* {
+    LIBS += -lGLU
+}
+macx {
+    LIBS += -framework OpenGL
+}
+win32 {
+    SOURCES += ../../tao/include/tao/GL/glew.c
+    DEFINES += GLEW_STATIC
+    LIBS += -lglu32 -lopengl32
+}
@@ -0,0 +1,705 @@
+// ****************************************************************************
+//  tesselator_test.cpp                                             Tao project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Check the built-in tesselator against GLU, and compare their speed
+//
+//     The outlines are those of the 2D shapes in shapes.cpp, of overlapping
+//     and self-intersecting contours, and of text. For each outline and
+//     winding rule, points sampled in the bounding box must be covered by
+//     exactly one triangle if their winding number is inside, and by none
+//     otherwise. Triangles must have the same orientation as with GLU.
+//
+//     Run with: qmake && make && ./tesselator_test
+//
+// ****************************************************************************
+// This software is licensed under the GNU General Public License v3.
+// See file COPYING for details.
+//  (C) 2013 Taodyne SAS
+// ****************************************************************************
+
+#include "tesselator.h"
+#include <QPainterPath>
+#include <QFont>
+#include <QTime>
+#if QT_VERSION >= 0x050000
+#include <QGuiApplication>
+typedef QGuiApplication Application;
+#else
+#include <QApplication>
+typedef QApplication Application;
+#endif
+#include <algorithm>
+#include <deque>
+#include <cstdio>
+#include <cmath>
+
+#ifndef CALLBACK
+#define CALLBACK
+#endif
+
+using namespace Tao;
+
+typedef std::vector<Point3>     Contour;
+typedef std::vector<Contour>    Outline;
+typedef Tesselator::Vertices    Vertices;
+typedef Tesselator::Indices     Indices;
+
+static const GLenum windings[] =
+{
+    GLU_TESS_WINDING_ODD,
+    GLU_TESS_WINDING_NONZERO,
+    GLU_TESS_WINDING_POSITIVE,
+    GLU_TESS_WINDING_NEGATIVE,
+    GLU_TESS_WINDING_ABS_GEQ_TWO
+};
+static const char *windingNames[] =
+{
+    "odd", "nonzero", "positive", "negative", "abs_geq_two"
+};
+
+
+
+// ============================================================================
+//
+//    Outlines
+//
+// ============================================================================
+
+static void arc(Contour &c, coord cx, coord cy, coord rx, coord ry,
+                coord a0, coord a1, uint steps)
+// ----------------------------------------------------------------------------
+//   Add points on an elliptic arc, including both ends
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i <= steps; i++)
+    {
+        coord a = a0 + (a1 - a0) * i / steps;
+        c.push_back(Point3(cx + rx * cos(a), cy + ry * sin(a), 0));
+    }
+}
+
+
+static Contour polygon(const coord *xy, uint count)
+// ----------------------------------------------------------------------------
+//   Build a contour from a list of coordinates
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    for (uint i = 0; i < count; i++)
+        c.push_back(Point3(xy[2*i], xy[2*i+1], 0));
+    return c;
+}
+
+
+static Contour roundedRectangle(coord x, coord y, coord w, coord h, coord r)
+// ----------------------------------------------------------------------------
+//   Rounded rectangle, as in RoundedRectangle::Draw
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    arc(c, x + w - r, y + r,     r, r, -M_PI_2, 0,        16);
+    arc(c, x + w - r, y + h - r, r, r, 0,       M_PI_2,   16);
+    arc(c, x + r,     y + h - r, r, r, M_PI_2,  M_PI,     16);
+    arc(c, x + r,     y + r,     r, r, M_PI,    3*M_PI_2, 16);
+    return c;
+}
+
+
+static Contour star(uint p, coord r, coord cx, coord cy, coord size)
+// ----------------------------------------------------------------------------
+//   Star with p branches and a ratio r of radii, as in Star::Draw
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    coord a = 0, da = M_PI / p;
+    for (uint i = 0; i < p; i++)
+    {
+        c.push_back(Point3(cx - size * sin(a), cy + size * cos(a), 0));
+        a += da;
+        c.push_back(Point3(cx - r*size * sin(a), cy + r*size * cos(a), 0));
+        a += da;
+    }
+    return c;
+}
+
+
+static Contour starPolygon(uint p, uint q, coord cx, coord cy, coord size)
+// ----------------------------------------------------------------------------
+//   Self-intersecting star polygon {p/q}, drawn in a single stroke
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    for (uint i = 0; i < p; i++)
+    {
+        coord a = 2 * M_PI * i * q / p;
+        c.push_back(Point3(cx - size * sin(a), cy + size * cos(a), 0));
+    }
+    return c;
+}
+
+
+static Contour circle(coord cx, coord cy, coord r, uint steps, bool cw=false)
+// ----------------------------------------------------------------------------
+//   Circle, counter-clockwise unless specified otherwise
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    arc(c, cx, cy, r, r, 0, 2 * M_PI, steps);
+    c.pop_back();
+    if (cw)
+        std::reverse(c.begin(), c.end());
+    return c;
+}
+
+
+static Contour gear(uint teeth, coord cx, coord cy, coord r)
+// ----------------------------------------------------------------------------
+//   Gear with trapezoidal teeth, ten vertices per tooth
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    coord da = 2 * M_PI / teeth;
+    for (uint t = 0; t < teeth; t++)
+    {
+        coord a = t * da;
+        arc(c, cx, cy, r, r, a, a + 0.35 * da, 3);
+        arc(c, cx, cy, 1.15*r, 1.15*r, a + 0.5 * da, a + 0.85 * da, 3);
+    }
+    return c;
+}
+
+
+static Contour randomPolygon(uint count, uint seed)
+// ----------------------------------------------------------------------------
+//   Polygon with random vertices, which crosses itself a lot
+// ----------------------------------------------------------------------------
+{
+    Contour c;
+    for (uint i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        coord x = (seed >> 8 & 0xFFFF) * 200.0 / 65536;
+        seed = seed * 1103515245 + 12345;
+        coord y = (seed >> 8 & 0xFFFF) * 200.0 / 65536;
+        c.push_back(Point3(x, y, 0));
+    }
+    return c;
+}
+
+
+static void textOutline(Outline &outline, const QString &text)
+// ----------------------------------------------------------------------------
+//   Outline of a text, flattened by Qt
+// ----------------------------------------------------------------------------
+{
+    QPainterPath path;
+    path.addText(0, 0, QFont("Arial", 72), text);
+    QList<QPolygonF> polygons = path.toSubpathPolygons();
+    for (int p = 0; p < polygons.size(); p++)
+    {
+        const QPolygonF &polygon = polygons[p];
+        Contour c;
+        for (int i = 0; i < polygon.size(); i++)
+            c.push_back(Point3(polygon[i].x(), -polygon[i].y(), 0));
+        if (c.size() > 1 && c.front() == c.back())
+            c.pop_back();
+        if (c.size() >= 3)
+            outline.push_back(c);
+    }
+}
+
+
+struct Shape
+// ----------------------------------------------------------------------------
+//   An outline to tesselate
+// ----------------------------------------------------------------------------
+{
+    Shape(const char *name): name(name) {}
+    const char *name;
+    Outline     outline;
+};
+typedef std::vector<Shape> Shapes;
+
+
+static void buildShapes(Shapes &shapes)
+// ----------------------------------------------------------------------------
+//   Create the outlines we test
+// ----------------------------------------------------------------------------
+{
+    static const coord rectangle[] = { 0,0, 200,0, 200,100, 0,100 };
+    static const coord arrow[] = { 0,35, 140,35, 140,0, 200,50,
+                                   140,100, 140,65, 0,65 };
+    static const coord doubleArrow[] = { 0,50, 60,0, 60,35, 140,35, 140,0,
+                                         200,50, 140,100, 140,65, 60,65,
+                                         60,100 };
+    static const coord triangle[] = { 0,0, 200,0, 100,150 };
+    static const coord callout[] = { 0,0, 200,0, 200,100, 80,100,
+                                     30,160, 50,100, 0,100 };
+    static const coord comb[] = { 0,0, 100,0, 100,100, 90,100, 90,10,
+                                  80,10, 80,100, 70,100, 70,10, 60,10,
+                                  60,100, 50,100, 50,10, 40,10, 40,100,
+                                  30,100, 30,10, 20,10, 20,100, 10,100,
+                                  10,10, 0,10 };
+    static const coord bowtie[] = { 0,0, 100,100, 100,0, 0,100 };
+    static const coord left[] = { 0,0, 100,0, 100,100, 0,100 };
+    static const coord right[] = { 100,0, 200,0, 200,100, 100,100 };
+    static const coord overlap[] = { 50,50, 150,50, 150,150, 50,150 };
+    static const coord corner[] = { 100,100, 200,100, 200,200, 100,200 };
+    static const coord junction[] = { 100,50, 180,20, 180,80 };
+    static const coord duplicates[] = { 0,0, 0,0, 100,0, 200,0, 200,0,
+                                        200,100, 100,100, 0,100, 0,50 };
+
+    shapes.push_back(Shape("rectangle"));
+    shapes.back().outline.push_back(polygon(rectangle, 4));
+
+    shapes.push_back(Shape("triangle"));
+    shapes.back().outline.push_back(polygon(triangle, 3));
+
+    shapes.push_back(Shape("rounded_rectangle"));
+    shapes.back().outline.push_back(roundedRectangle(0, 0, 200, 100, 30));
+
+    shapes.push_back(Shape("ellipse"));
+    {
+        Contour c;
+        arc(c, 100, 50, 100, 50, 0, 2 * M_PI, 64);
+        c.pop_back();
+        shapes.back().outline.push_back(c);
+    }
+
+    shapes.push_back(Shape("ellipse_arc"));
+    {
+        Contour c;
+        c.push_back(Point3(100, 50, 0));
+        arc(c, 100, 50, 100, 50, M_PI/6, 3*M_PI/2, 48);
+        shapes.back().outline.push_back(c);
+    }
+
+    shapes.push_back(Shape("arrow"));
+    shapes.back().outline.push_back(polygon(arrow, 7));
+
+    shapes.push_back(Shape("double_arrow"));
+    shapes.back().outline.push_back(polygon(doubleArrow, 10));
+
+    shapes.push_back(Shape("star"));
+    shapes.back().outline.push_back(star(7, 0.4, 100, 100, 100));
+
+    shapes.push_back(Shape("star_polygon"));
+    shapes.back().outline.push_back(starPolygon(7, 3, 100, 100, 100));
+
+    shapes.push_back(Shape("pentagram"));
+    shapes.back().outline.push_back(starPolygon(5, 2, 100, 100, 100));
+
+    shapes.push_back(Shape("speech_balloon"));
+    shapes.back().outline.push_back(roundedRectangle(0, 0, 200, 100, 20));
+    {
+        static const coord tail[] = { 60,80, 100,80, 20,180 };
+        shapes.back().outline.push_back(polygon(tail, 3));
+    }
+
+    shapes.push_back(Shape("callout"));
+    shapes.back().outline.push_back(polygon(callout, 7));
+
+    shapes.push_back(Shape("comb"));
+    shapes.back().outline.push_back(polygon(comb, 22));
+
+    shapes.push_back(Shape("bowtie"));
+    shapes.back().outline.push_back(polygon(bowtie, 4));
+
+    shapes.push_back(Shape("shared_edge"));
+    shapes.back().outline.push_back(polygon(left, 4));
+    shapes.back().outline.push_back(polygon(right, 4));
+
+    shapes.push_back(Shape("overlapping_squares"));
+    shapes.back().outline.push_back(polygon(left, 4));
+    shapes.back().outline.push_back(polygon(overlap, 4));
+
+    shapes.push_back(Shape("touching_squares"));
+    shapes.back().outline.push_back(polygon(left, 4));
+    shapes.back().outline.push_back(polygon(corner, 4));
+
+    shapes.push_back(Shape("t_junction"));
+    shapes.back().outline.push_back(polygon(left, 4));
+    shapes.back().outline.push_back(polygon(junction, 3));
+
+    shapes.push_back(Shape("duplicate_points"));
+    shapes.back().outline.push_back(polygon(duplicates, 9));
+
+    for (uint r = 0; r < 4; r++)
+    {
+        shapes.push_back(Shape("random_polygon"));
+        shapes.back().outline.push_back(randomPolygon(40, 1 + r));
+    }
+
+    shapes.push_back(Shape("ring"));
+    shapes.back().outline.push_back(circle(100, 100, 100, 64));
+    shapes.back().outline.push_back(circle(100, 100, 60, 64, true));
+
+    shapes.push_back(Shape("gear_300"));
+    shapes.back().outline.push_back(gear(30, 100, 100, 100));
+
+    shapes.push_back(Shape("circles_50"));
+    for (uint i = 0; i < 50; i++)
+    {
+        coord a = i * 2.39996;
+        coord r = 8 * sqrt(coord(i + 1));
+        shapes.back().outline.push_back(circle(100 + r * cos(a),
+                                               100 + r * sin(a), 30, 62));
+    }
+
+    shapes.push_back(Shape("glyph_at"));
+    textOutline(shapes.back().outline, "@");
+
+    shapes.push_back(Shape("glyph_g"));
+    textOutline(shapes.back().outline, "g");
+
+    shapes.push_back(Shape("text"));
+    textOutline(shapes.back().outline, "Tao3D @&%gB8");
+}
+
+
+
+// ============================================================================
+//
+//    Tesselation with GLU and with the built-in tesselator
+//
+// ============================================================================
+
+struct GLUOutput
+// ----------------------------------------------------------------------------
+//   Triangles produced by GLU
+// ----------------------------------------------------------------------------
+{
+    std::deque<Point3>  points;         // Input and combined vertices
+    std::vector<Point3> triangles;      // Three points per triangle
+};
+
+
+static void CALLBACK gluVertex(GLvoid *data, GLvoid *output)
+// ----------------------------------------------------------------------------
+//   Record a vertex of a triangle
+// ----------------------------------------------------------------------------
+{
+    ((GLUOutput *) output)->triangles.push_back(*(Point3 *) data);
+}
+
+
+static void CALLBACK gluCombine(GLdouble coords[3], void *[4], GLfloat [4],
+                                void **data, void *output)
+// ----------------------------------------------------------------------------
+//   Create a vertex where edges cross
+// ----------------------------------------------------------------------------
+{
+    GLUOutput *out = (GLUOutput *) output;
+    out->points.push_back(Point3(coords[0], coords[1], coords[2]));
+    *data = &out->points.back();
+}
+
+
+static void CALLBACK gluEdgeFlag(GLboolean)
+// ----------------------------------------------------------------------------
+//   Having an edge flag callback makes GLU output only triangles
+// ----------------------------------------------------------------------------
+{}
+
+
+typedef void (CALLBACK *GluCallback)();
+
+static uint runGLU(GLUtesselator *tess, const Outline &outline,
+                   GLenum winding, GLUOutput &out)
+// ----------------------------------------------------------------------------
+//   Tesselate with GLU, return the number of triangles
+// ----------------------------------------------------------------------------
+{
+    out.points.clear();
+    out.triangles.clear();
+    gluTessProperty(tess, GLU_TESS_WINDING_RULE, winding);
+    gluTessBeginPolygon(tess, &out);
+    for (uint c = 0; c < outline.size(); c++)
+    {
+        gluTessBeginContour(tess);
+        for (uint i = 0; i < outline[c].size(); i++)
+        {
+            out.points.push_back(outline[c][i]);
+            Point3 &p = out.points.back();
+            gluTessVertex(tess, &p.x, &p);
+        }
+        gluTessEndContour(tess);
+    }
+    gluTessEndPolygon(tess);
+    return out.triangles.size() / 3;
+}
+
+
+static uint runTao(Tesselator &tess, const Outline &outline,
+                   Vertices &vertices, Indices &indices)
+// ----------------------------------------------------------------------------
+//   Tesselate with the built-in tesselator, return the number of triangles
+// ----------------------------------------------------------------------------
+{
+    tess.Clear();
+    vertices.clear();
+    indices.clear();
+    for (uint c = 0; c < outline.size(); c++)
+    {
+        tess.BeginContour();
+        for (uint i = 0; i < outline[c].size(); i++)
+            tess.Vertex3(outline[c][i], outline[c][i]);
+    }
+    return tess.Tesselate(vertices, indices);
+}
+
+
+
+// ============================================================================
+//
+//    Checking the coverage of the triangles
+//
+// ============================================================================
+
+static bool inside(GLenum winding, int w)
+// ----------------------------------------------------------------------------
+//   Reference winding rule
+// ----------------------------------------------------------------------------
+{
+    switch (winding)
+    {
+    case GLU_TESS_WINDING_ODD:          return w & 1;
+    case GLU_TESS_WINDING_NONZERO:      return w != 0;
+    case GLU_TESS_WINDING_POSITIVE:     return w > 0;
+    case GLU_TESS_WINDING_NEGATIVE:     return w < 0;
+    case GLU_TESS_WINDING_ABS_GEQ_TWO:  return w >= 2 || w <= -2;
+    }
+    return false;
+}
+
+
+static bool windingNumber(const Outline &outline, coord x, coord y,
+                          coord margin, int &w)
+// ----------------------------------------------------------------------------
+//   Compute the winding number, return false if too close to an edge
+// ----------------------------------------------------------------------------
+{
+    w = 0;
+    for (uint c = 0; c < outline.size(); c++)
+    {
+        const Contour &contour = outline[c];
+        uint n = contour.size();
+        for (uint i = 0; i < n; i++)
+        {
+            const Point3 &a = contour[i];
+            const Point3 &b = contour[(i + 1) % n];
+            coord dx = b.x - a.x, dy = b.y - a.y;
+            coord len2 = dx*dx + dy*dy;
+            coord t = len2 > 0 ? ((x-a.x)*dx + (y-a.y)*dy) / len2 : 0;
+            t = t < 0 ? 0 : t > 1 ? 1 : t;
+            coord ex = a.x + t*dx - x, ey = a.y + t*dy - y;
+            if (ex*ex + ey*ey < margin*margin)
+                return false;
+
+            coord cross = dx * (y - a.y) - dy * (x - a.x);
+            if (a.y <= y && b.y > y && cross > 0)
+                w++;
+            else if (a.y > y && b.y <= y && cross < 0)
+                w--;
+        }
+    }
+    return true;
+}
+
+
+static coord area(const Point3 &a, const Point3 &b, const Point3 &c)
+// ----------------------------------------------------------------------------
+//   Twice the signed area of a triangle in the xy plane
+// ----------------------------------------------------------------------------
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+
+static uint covering(const std::vector<Point3> &triangles, coord x, coord y)
+// ----------------------------------------------------------------------------
+//   Count the triangles containing a point
+// ----------------------------------------------------------------------------
+{
+    Point3 p(x, y, 0);
+    uint count = 0;
+    for (uint t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        const Point3 &a = triangles[t];
+        const Point3 &b = triangles[t+1];
+        const Point3 &c = triangles[t+2];
+        coord s = area(a, b, c) < 0 ? -1 : 1;
+        if (s * area(a, b, p) > 0 && s * area(b, c, p) > 0 &&
+            s * area(c, a, p) > 0)
+            count++;
+    }
+    return count;
+}
+
+
+static uint check(const char *who, const Outline &outline, GLenum winding,
+                  const std::vector<Point3> &triangles)
+// ----------------------------------------------------------------------------
+//   Check coverage on sample points, return the number of errors
+// ----------------------------------------------------------------------------
+{
+    coord x0 = 1e30, y0 = 1e30, x1 = -1e30, y1 = -1e30;
+    for (uint c = 0; c < outline.size(); c++)
+    {
+        for (uint i = 0; i < outline[c].size(); i++)
+        {
+            const Point3 &p = outline[c][i];
+            x0 = std::min(x0, p.x); x1 = std::max(x1, p.x);
+            y0 = std::min(y0, p.y); y1 = std::max(y1, p.y);
+        }
+    }
+    coord margin = std::max(x1 - x0, y1 - y0) * 1e-4;
+
+    // Like GLU, wind around the normal giving a positive total area
+    coord total = 0;
+    for (uint c = 0; c < outline.size(); c++)
+    {
+        const Contour &contour = outline[c];
+        uint n = contour.size();
+        for (uint i = 0; i < n; i++)
+        {
+            const Point3 &a = contour[i];
+            const Point3 &b = contour[(i + 1) % n];
+            total += a.x * b.y - a.y * b.x;
+        }
+    }
+    int sign = total < 0 ? -1 : 1;
+
+    uint errors = 0;
+    uint seed = 12345;
+    const uint SAMPLES = 64;
+    for (uint j = 0; j < SAMPLES; j++)
+    {
+        for (uint i = 0; i < SAMPLES; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            coord jx = (seed >> 8 & 0xFFFF) / 65536.0;
+            seed = seed * 1103515245 + 12345;
+            coord jy = (seed >> 8 & 0xFFFF) / 65536.0;
+            coord x = x0 + (x1 - x0) * (i + jx) / SAMPLES;
+            coord y = y0 + (y1 - y0) * (j + jy) / SAMPLES;
+            int w;
+            if (!windingNumber(outline, x, y, margin, w))
+                continue;
+            uint expected = inside(winding, sign * w) ? 1 : 0;
+            uint count = covering(triangles, x, y);
+            if (count != expected)
+            {
+                if (errors < 3)
+                    fprintf(stderr, "  %s: point (%g, %g) winding %d "
+                            "covered %u times\n", who, x, y, w, count);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+
+static int orientation(const std::vector<Point3> &triangles, uint &mixed)
+// ----------------------------------------------------------------------------
+//   Return the orientation of the triangles, count those not following it
+// ----------------------------------------------------------------------------
+{
+    int positive = 0, negative = 0;
+    for (uint t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        coord a = area(triangles[t], triangles[t+1], triangles[t+2]);
+        if (a > 0)
+            positive++;
+        else if (a < 0)
+            negative++;
+    }
+    mixed = std::min(positive, negative);
+    return positive >= negative ? 1 : -1;
+}
+
+
+
+// ============================================================================
+//
+//    Main entry point
+//
+// ============================================================================
+
+int main(int argc, char **argv)
+// ----------------------------------------------------------------------------
+//   Run all the checks and timings, return the number of failures
+// ----------------------------------------------------------------------------
+{
+    Application app(argc, argv);
+    Shapes shapes;
+    buildShapes(shapes);
+
+    GLUtesselator *glu = gluNewTess();
+    gluTessCallback(glu, GLU_TESS_VERTEX_DATA, (GluCallback) gluVertex);
+    gluTessCallback(glu, GLU_TESS_COMBINE_DATA, (GluCallback) gluCombine);
+    gluTessCallback(glu, GLU_TESS_EDGE_FLAG, (GluCallback) gluEdgeFlag);
+
+    Tesselator tess;
+    Vertices vertices;
+    Indices indices;
+    GLUOutput gluOutput;
+    std::vector<Point3> taoTriangles;
+    uint failures = 0;
+
+    printf("%-20s %-12s %8s %10s %8s %10s %s\n", "shape", "winding",
+           "glu_tri", "glu_us", "tao_tri", "tao_us", "status");
+    for (uint s = 0; s < shapes.size(); s++)
+    {
+        const Shape &shape = shapes[s];
+        for (uint w = 0; w < sizeof(windings) / sizeof(windings[0]); w++)
+        {
+            GLenum winding = windings[w];
+            tess.winding = winding;
+            uint gluCount = runGLU(glu, shape.outline, winding, gluOutput);
+            uint taoCount = runTao(tess, shape.outline, vertices, indices);
+            taoTriangles.clear();
+            for (uint i = 0; i < indices.size(); i++)
+                taoTriangles.push_back(vertices[indices[i]].position);
+
+            // Check coverage, and orientation against GLU. Errors from
+            // GLU would show a problem with the reference winding rule.
+            check("glu", shape.outline, winding, gluOutput.triangles);
+            uint errors = check("tao", shape.outline, winding, taoTriangles);
+            uint gluMixed, taoMixed;
+            int gluSide = orientation(gluOutput.triangles, gluMixed);
+            int taoSide = orientation(taoTriangles, taoMixed);
+            bool ok = errors == 0 && taoMixed == 0 &&
+                (gluCount == 0 || taoCount == 0 || gluSide == taoSide);
+
+            // Time both tesselators over about the same number of vertices
+            uint points = 0;
+            for (uint c = 0; c < shape.outline.size(); c++)
+                points += shape.outline[c].size();
+            uint runs = std::max(1U, 200000 / points);
+            QTime timer;
+            timer.start();
+            for (uint r = 0; r < runs; r++)
+                runGLU(glu, shape.outline, winding, gluOutput);
+            double gluTime = timer.elapsed() * 1000.0 / runs;
+            timer.start();
+            for (uint r = 0; r < runs; r++)
+                runTao(tess, shape.outline, vertices, indices);
+            double taoTime = timer.elapsed() * 1000.0 / runs;
+
+            printf("%-20s %-12s %8u %10.1f %8u %10.1f %s\n",
+                   shape.name, windingNames[w], gluCount, gluTime,
+                   taoCount, taoTime, ok ? "ok" : "FAILED");
+            if (!ok)
+                failures++;
+        }
+    }
+
+    gluDeleteTess(glu);
+    printf("%u failures\n", failures);
+    return failures;
+}
@@ -19,7 +19,10 @@ clean_runs.commands = ./clean_runs.sh RUN
 clean_refs.commands = ./clean_runs.sh REF
 clean_all.commands  = ./clean_runs.sh ALL
 
-QMAKE_EXTRA_TARGETS += tests refs clean_runs clean_refs clean_all
+tesselator.commands = \
+    cd tesselator && $(QMAKE) && $(MAKE) && ./tesselator_test
+
+QMAKE_EXTRA_TARGETS += tests refs clean_runs clean_refs clean_all tesselator
 
 OTHER_FILES += \
     runAllTest.sh \
@@ -50,5 +53,13 @@ OTHER_FILES += \
     shapes/shapes_4.png \
     shapes/shapes_5.png \
     shapes/shapes_test.xl \
-    shapes/tortue.jpg
+    shapes/tortue.jpg \
+    culling/culling.ddd \
+    culling/culling_test.xl \
+    deepLayouts/deepLayouts.ddd \
+    deepLayouts/deepLayouts_test.xl \
+    transparency/transparency.ddd \
+    transparency/transparency_test.xl \
+    tesselator/tesselator.pro \
+    tesselator/tesselator_test.cpp
 